@@ -47,8 +47,9 @@ namespace benchmark {
         uint64_t lastCycles;
         uint64_t minCycles;
         uint64_t maxCycles;
+        uint64_t itemsPerIteration;
     public:
-        State(std::string _name, double _maxElapsed) : name(_name), maxElapsed(_maxElapsed), count(0) {
+        State(std::string _name, double _maxElapsed) : name(_name), maxElapsed(_maxElapsed), count(0), itemsPerIteration(1) {
             minTime = std::numeric_limits<double>::max();
             maxTime = std::numeric_limits<double>::min();
             minCycles = std::numeric_limits<uint64_t>::max();
@@ -57,6 +58,8 @@ namespace benchmark {
             countMaskInv = 1./(countMask + 1);
         }
         bool KeepRunning();
+        /** Number of items (e.g. hashes) processed per iteration, for the items per second column */
+        void SetItemsPerIteration(uint64_t n) { itemsPerIteration = n; }
     };
 
     typedef boost::function<void(State&)> BenchFunction;
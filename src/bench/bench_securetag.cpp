@@ -4,6 +4,7 @@
 
 #include "bench.h"
 
+#include "crypto/neoscrypt.h"
 #include "key.h"
 #include "validation.h"
 #include "util.h"
@@ -12,6 +13,7 @@ int
 main(int argc, char** argv)
 {
     ECC_Start();
+    neoscrypt_engine_init();
     SetupEnvironment();
     fPrintToDebugLog = false; // don't want to write to debug.log file
 
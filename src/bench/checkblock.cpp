@@ -7,8 +7,13 @@
 #include "chainparams.h"
 #include "validation.h"
 #include "streams.h"
+#include "util.h"
+#include "utiltime.h"
+#include "random.h"
 #include "consensus/validation.h"
 
+#include <boost/filesystem.hpp>
+
 #include "bench/data/block813851.raw.h"
 
 // These are the two major time-sinks which happen after we have fully received
@@ -50,5 +55,75 @@ static void DeserializeAndCheckBlockTest(benchmark::State& state)
     }
 }
 
+// Reading an indexed block back from disk, either deserialized as done when
+// rescanning and checking masternode payments, or raw as done when serving
+// getdata, REST and ZMQ requests.
+static void ReadIndexedBlock(benchmark::State& state, bool fRaw)
+{
+    CDataStream stream((const char*)raw_bench::block813851,
+            (const char*)&raw_bench::block813851[sizeof(raw_bench::block813851)],
+            SER_NETWORK, PROTOCOL_VERSION);
+    CBlock block;
+    stream >> block;
+
+    SelectParams(CBaseChainParams::MAIN);
+    boost::filesystem::path pathTemp = boost::filesystem::temp_directory_path() / strprintf("bench_securetag_%lu_%i", (unsigned long)GetTime(), (int)(GetRand(100000)));
+    boost::filesystem::create_directories(pathTemp / "blocks");
+    // The directory is removed afterwards, later benchmarks must not use it
+    const bool fPrevDatadir = IsArgSet("-datadir");
+    const std::string strPrevDatadir = GetArg("-datadir", "");
+    ForceSetArg("-datadir", pathTemp.string());
+    ClearDatadirCache();
+
+    CDiskBlockPos pos(0, 0);
+    assert(WriteBlockToDisk(block, pos, Params().MessageStart()));
+
+    // Index entries for the block and its parent, as loaded at startup
+    uint256 hashBlock = block.GetHash();
+    CBlockIndex indexPrev;
+    indexPrev.phashBlock = &block.hashPrevBlock;
+    CBlockIndex index;
+    index.phashBlock = &hashBlock;
+    index.pprev = &indexPrev;
+    index.nVersion = block.nVersion;
+    index.hashMerkleRoot = block.hashMerkleRoot;
+    index.nTime = block.nTime;
+    index.nBits = block.nBits;
+    index.nNonce = block.nNonce;
+    index.nFile = pos.nFile;
+    index.nDataPos = pos.nPos;
+    index.nStatus |= BLOCK_HAVE_DATA;
+
+    const Consensus::Params& params = Params().GetConsensus();
+    while (state.KeepRunning()) {
+        if (fRaw) {
+            std::vector<unsigned char> vchBlock;
+            assert(ReadRawBlockFromDisk(vchBlock, &index, Params().MessageStart()));
+        } else {
+            CBlock blockRead;
+            assert(ReadBlockFromDisk(blockRead, &index, params));
+        }
+    }
+
+    if (fPrevDatadir)
+        ForceSetArg("-datadir", strPrevDatadir);
+    else
+        ForceRemoveArg("-datadir");
+    ClearDatadirCache();
+    boost::filesystem::remove_all(pathTemp);
+}
+
+static void ReadBlockFromDiskTest(benchmark::State& state)
+{
+    ReadIndexedBlock(state, false);
+}
+
+static void ReadRawBlockFromDiskTest(benchmark::State& state)
+{
+    ReadIndexedBlock(state, true);
+}
+
 BENCHMARK(DeserializeBlockTest);
 BENCHMARK(DeserializeAndCheckBlockTest);
+BENCHMARK(ReadBlockFromDiskTest);
+BENCHMARK(ReadRawBlockFromDiskTest);
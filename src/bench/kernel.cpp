@@ -0,0 +1,78 @@
+// Copyright (c) 2018 The SecureTag Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "chainparams.h"
+#include "kernel.h"
+#include "validation.h"
+
+// Checks a stake kernel against a synthetic chain with a block every minute, so
+// that the stake modifier lookup walks the selection interval like it does on
+// the real chain. Unless fCached, the modifier cache is cleared before every
+// check so each one walks the interval; otherwise all but the first check are
+// cache hits. The items per second column is kernel checks per second.
+static void StakeKernelHash(benchmark::State& state, bool fCached)
+{
+    SelectParams(CBaseChainParams::MAIN);
+
+    const unsigned int nTimeBlockFrom = 1561000000;
+    const unsigned int nTimeTx = nTimeBlockFrom + 2 * 24 * 60 * 60;
+    const int nBlocks = 200;
+
+    CBlock blockFrom;
+    blockFrom.nVersion = 4;
+    blockFrom.nTime = nTimeBlockFrom;
+    blockFrom.nBits = 0x1e0ffff0;
+
+    CMutableTransaction txPrev;
+    txPrev.vout.resize(1);
+    txPrev.vout[0].nValue = 1000 * COIN;
+    CTransactionRef ptxPrev = MakeTransactionRef(txPrev);
+    COutPoint prevout(ptxPrev->GetHash(), 0);
+
+    std::vector<CBlockIndex*> vIndex;
+    {
+        LOCK(cs_main);
+        for (int i = 0; i < nBlocks; i++) {
+            uint256 hash = i ? ArithToUint256(arith_uint256(i)) : blockFrom.GetHash();
+            CBlockIndex* pindex = new CBlockIndex();
+            pindex->phashBlock = &mapBlockIndex.insert(std::make_pair(hash, pindex)).first->first;
+            pindex->pprev = i ? vIndex.back() : NULL;
+            pindex->nHeight = i;
+            pindex->nTime = nTimeBlockFrom + 60 * i;
+            pindex->SetStakeModifier(i, true);
+            vIndex.push_back(pindex);
+        }
+        chainActive.SetTip(vIndex.back());
+    }
+
+    ClearKernelStakeModifierCache();
+    while (state.KeepRunning()) {
+        if (!fCached)
+            ClearKernelStakeModifierCache();
+        uint256 hashProofOfStake;
+        CheckStakeKernelHash(blockFrom.nBits, blockFrom, STAKE_KERNEL_TX_PREV_OFFSET, ptxPrev, prevout, nTimeTx, hashProofOfStake);
+    }
+
+    LOCK(cs_main);
+    chainActive.SetTip(NULL);
+    ClearKernelStakeModifierCache();
+    for (CBlockIndex* pindex : vIndex) {
+        mapBlockIndex.erase(pindex->GetBlockHash());
+        delete pindex;
+    }
+}
+
+static void CheckStakeKernelHash_Walk(benchmark::State& state)
+{
+    StakeKernelHash(state, false);
+}
+
+static void CheckStakeKernelHash_Cached(benchmark::State& state)
+{
+    StakeKernelHash(state, true);
+}
+
+BENCHMARK(CheckStakeKernelHash_Walk);
+BENCHMARK(CheckStakeKernelHash_Cached);
@@ -0,0 +1,88 @@
+// Copyright (c) 2018 The SecureTag Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "primitives/block.h"
+#include "util.h"
+#include "validation.h"
+#include "crypto/neoscrypt.h"
+
+#include <boost/thread/thread.hpp>
+
+// The single hash benchmarks run on one core, so their items per second
+// column is the NeoScrypt hash rate per core.
+
+static void NeoScrypt(benchmark::State& state, unsigned int engine)
+{
+    const unsigned int nPrevEngine = neoscrypt_engine();
+    neoscrypt_engine_select(engine);
+
+    unsigned char in[80] = {0};
+    unsigned char out[32];
+    while (state.KeepRunning()) {
+        neoscrypt(in, out, 0);
+        in[76]++;
+    }
+
+    neoscrypt_engine_select(nPrevEngine);
+}
+
+static void NEOSCRYPT_Scalar(benchmark::State& state)
+{
+    NeoScrypt(state, NEOSCRYPT_ENGINE_SCALAR);
+}
+
+static void NEOSCRYPT_Best(benchmark::State& state)
+{
+    NeoScrypt(state, NEOSCRYPT_ENGINE_AVX2);
+}
+
+// Hashes batches of headers the way block import does, spread over nThreads
+// threads: the calling thread and nThreads - 1 header hash threads
+static void HeaderBatch(benchmark::State& state, int nThreads)
+{
+    const int nPrevScriptCheckThreads = nScriptCheckThreads;
+    nScriptCheckThreads = nThreads;
+    boost::thread_group threadGroup;
+    for (int i = 0; i < nScriptCheckThreads - 1; i++)
+        threadGroup.create_thread(&ThreadHeaderHash);
+
+    std::vector<CBlockHeader> headers(64);
+    for (size_t i = 0; i < headers.size(); i++) {
+        headers[i].nVersion = 4;
+        headers[i].nTime = 1540526903 + i;
+        headers[i].nBits = 0x1e0ffff0;
+    }
+    std::vector<uint256> vHashes;
+
+    state.SetItemsPerIteration(headers.size());
+    while (state.KeepRunning()) {
+        // Change every header so that no cached hash is reused
+        for (CBlockHeader& header : headers)
+            header.nNonce++;
+        GetBlockHeaderHashes(headers, vHashes);
+    }
+
+    threadGroup.interrupt_all();
+    threadGroup.join_all();
+    nScriptCheckThreads = nPrevScriptCheckThreads;
+}
+
+// Batch hashing on one core, comparable with the single hash benchmarks
+static void NEOSCRYPT_HeaderBatch_1Core(benchmark::State& state)
+{
+    HeaderBatch(state, 1);
+}
+
+// Batch hashing on all cores like a node started with -par=0, the items per
+// second column is the aggregate hash rate
+static void NEOSCRYPT_HeaderBatch(benchmark::State& state)
+{
+    HeaderBatch(state, std::max(2, GetNumCores()));
+}
+
+BENCHMARK(NEOSCRYPT_Scalar);
+BENCHMARK(NEOSCRYPT_Best);
+BENCHMARK(NEOSCRYPT_HeaderBatch_1Core);
+BENCHMARK(NEOSCRYPT_HeaderBatch);
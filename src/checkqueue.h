@@ -5,6 +5,8 @@
 #ifndef BITCOIN_CHECKQUEUE_H
 #define BITCOIN_CHECKQUEUE_H
 
+#include "sync.h"
+
 #include <algorithm>
 #include <vector>
 
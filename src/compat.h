@@ -44,9 +44,20 @@
 #include <ifaddrs.h>
 #include <limits.h>
 #include <netdb.h>
+#include <poll.h>
 #include <unistd.h>
 #endif
 
+// Socket readiness backends used by the network thread: edge-triggered epoll
+// where available, poll() on other POSIX systems and select() on Windows.
+#if defined(__linux__)
+#include <sys/epoll.h>
+#define USE_EPOLL
+#endif
+#ifndef WIN32
+#define USE_POLL
+#endif
+
 #ifdef WIN32
 #define MSG_DONTWAIT        0
 #else
@@ -95,7 +106,8 @@ size_t strnlen( const char *start, size_t max_len);
 #endif // HAVE_DECL_STRNLEN
 
 bool static inline IsSelectableSocket(SOCKET s) {
-#ifdef WIN32
+#if defined(WIN32) || defined(USE_POLL)
+    // poll() and epoll have no FD_SETSIZE limit
     return true;
 #else
     return (s < FD_SETSIZE);
@@ -34,6 +34,12 @@
 
 #include "neoscrypt.h"
 
+#if !defined(ASM) && defined(__GNUC__) && defined(__x86_64__)
+#define NEOSCRYPT_X86_SIMD
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
 
 #ifdef SHA256
 
@@ -2547,6 +2553,146 @@ static void neoscrypt_blkmix(uint *X, uint *Y, uint r, uint mixmode) {
 }
 
 
+/* Portable SMix */
+static void neoscrypt_smix(uint *X, uint *Y, uint *V, uint N, uint r,
+  uint mixmode) {
+    uint i, j;
+
+    for(i = 0; i < N; i++) {
+        /* blkcpy(V, X) */
+        neoscrypt_blkcpy(&V[i * (32 * r)], &X[0], r * 2 * BLOCK_SIZE);
+        /* blkmix(X, Y) */
+        neoscrypt_blkmix(&X[0], &Y[0], r, mixmode);
+    }
+    for(i = 0; i < N; i++) {
+        /* integerify(X) mod N */
+        j = (32 * r) * (X[16 * (2 * r - 1)] & (N - 1));
+        /* blkxor(X, V) */
+        neoscrypt_blkxor(&X[0], &V[j], r * 2 * BLOCK_SIZE);
+        /* blkmix(X, Y) */
+        neoscrypt_blkmix(&X[0], &Y[0], r, mixmode);
+    }
+}
+
+
+#ifdef NEOSCRYPT_X86_SIMD
+
+#define NEOSCRYPT_SIMD(name) name##_sse2
+#define NEOSCRYPT_SIMD_TARGET "sse2"
+#define NEOSCRYPT_SIMD_PSHUFB 0
+#define NEOSCRYPT_SIMD_YMM 0
+#include "neoscrypt_simd.h"
+#undef NEOSCRYPT_SIMD
+#undef NEOSCRYPT_SIMD_TARGET
+#undef NEOSCRYPT_SIMD_PSHUFB
+#undef NEOSCRYPT_SIMD_YMM
+
+#define NEOSCRYPT_SIMD(name) name##_ssse3
+#define NEOSCRYPT_SIMD_TARGET "ssse3"
+#define NEOSCRYPT_SIMD_PSHUFB 1
+#define NEOSCRYPT_SIMD_YMM 0
+#include "neoscrypt_simd.h"
+#undef NEOSCRYPT_SIMD
+#undef NEOSCRYPT_SIMD_TARGET
+#undef NEOSCRYPT_SIMD_PSHUFB
+#undef NEOSCRYPT_SIMD_YMM
+
+#define NEOSCRYPT_SIMD(name) name##_avx2
+#define NEOSCRYPT_SIMD_TARGET "avx2"
+#define NEOSCRYPT_SIMD_PSHUFB 1
+#define NEOSCRYPT_SIMD_YMM 1
+#include "neoscrypt_simd.h"
+#undef NEOSCRYPT_SIMD
+#undef NEOSCRYPT_SIMD_TARGET
+#undef NEOSCRYPT_SIMD_PSHUFB
+#undef NEOSCRYPT_SIMD_YMM
+
+/* Salsa20 diagonal order of a row ordered block */
+static const uchar neoscrypt_salsa_diag[16] = {
+     0,  5, 10, 15,  4,  9, 14,  3,  8, 13,  2,  7, 12,  1,  6, 11
+};
+
+/* Permutes r * 2 blocks of X into (dir = 0) or out of (dir = 1)
+ * the Salsa20 diagonal order using Y as a temporal space */
+static void neoscrypt_salsa_permute(uint *X, uint *Y, uint r, uint dir) {
+    uint i, k;
+
+    neoscrypt_blkcpy(&Y[0], &X[0], r * 2 * BLOCK_SIZE);
+    for(i = 0; i < 32 * r; i += 16) {
+        for(k = 0; k < 16; k++) {
+            if(dir) X[i + neoscrypt_salsa_diag[k]] = Y[i + k];
+            else    X[i + k] = Y[i + neoscrypt_salsa_diag[k]];
+        }
+    }
+}
+
+#endif /* NEOSCRYPT_X86_SIMD */
+
+
+/* Runtime selected SMix engine, the portable one unless
+ * neoscrypt_engine_select() has been called */
+static uint neoscrypt_engine_id = NEOSCRYPT_ENGINE_SCALAR;
+#ifdef NEOSCRYPT_X86_SIMD
+static void (*neoscrypt_smix_simd)(uint *X, uint *Z, uint *V, uint *W,
+  uint N, uint rounds) = NULL;
+#endif
+
+uint neoscrypt_engine_select(uint engine) {
+    uint best = NEOSCRYPT_ENGINE_SCALAR;
+
+#ifdef NEOSCRYPT_X86_SIMD
+    uint exts = cpu_vec_exts();
+
+    if(exts & 0x00000020) best = NEOSCRYPT_ENGINE_SSE2;
+    if(exts & 0x00000080) best = NEOSCRYPT_ENGINE_SSSE3;
+    if(exts & 0x00010000) best = NEOSCRYPT_ENGINE_AVX2;
+#endif
+
+    engine = MIN(engine, best);
+
+#ifdef NEOSCRYPT_X86_SIMD
+    switch(engine) {
+        case(NEOSCRYPT_ENGINE_SSE2):
+            neoscrypt_smix_simd = neoscrypt_smix_sse2;
+            break;
+        case(NEOSCRYPT_ENGINE_SSSE3):
+            neoscrypt_smix_simd = neoscrypt_smix_ssse3;
+            break;
+        case(NEOSCRYPT_ENGINE_AVX2):
+            neoscrypt_smix_simd = neoscrypt_smix_avx2;
+            break;
+        default:
+            neoscrypt_smix_simd = NULL;
+            break;
+    }
+#endif
+
+    neoscrypt_engine_id = engine;
+
+    return(engine);
+}
+
+uint neoscrypt_engine_init() {
+
+    return(neoscrypt_engine_select(NEOSCRYPT_ENGINE_AVX2));
+}
+
+uint neoscrypt_engine() {
+
+    return(neoscrypt_engine_id);
+}
+
+const char *neoscrypt_engine_name(uint engine) {
+
+    switch(engine) {
+        case(NEOSCRYPT_ENGINE_SSE2):  return("sse2");
+        case(NEOSCRYPT_ENGINE_SSSE3): return("ssse3");
+        case(NEOSCRYPT_ENGINE_AVX2):  return("avx2");
+        default:                      return("scalar");
+    }
+}
+
+
 /* NeoScrypt core engine:
  * p = 1, salt = password;
  * Basic customisation (required):
@@ -2581,8 +2727,8 @@ static void neoscrypt_blkmix(uint *X, uint *Y, uint r, uint mixmode) {
 void neoscrypt(const uchar *password, uchar *output, uint profile) {
     const size_t stack_align = 0x40;
     uint N = 128, r = 2, dblmix = 1, mixmode = 0x14;
-    uint kdf, i, j;
-    uint *X, *Y, *Z, *V;
+    uint kdf;
+    uint *X, *Y, *Z, *V, *W;
 
     if(profile & 0x1) {
         N = 1024;        /* N = (1 << (Nfactor + 1)); */
@@ -2596,7 +2742,8 @@ void neoscrypt(const uchar *password, uchar *output, uint profile) {
         r = (1 << ((profile >> 5) & 0x7));
     }
 
-    uchar stack[(N + 3) * r * 2 * BLOCK_SIZE + stack_align];
+    /* Room for the 2nd V of the SIMD engines when both SMix passes run */
+    uchar stack[(N * (1 + dblmix) + 3) * r * 2 * BLOCK_SIZE + stack_align];
     /* X = r * 2 * BLOCK_SIZE */
     X = (uint *) (((size_t)stack & ~(stack_align - 1)) + stack_align);
     /* Z is a copy of X for ChaCha */
@@ -2639,42 +2786,27 @@ void neoscrypt(const uchar *password, uchar *output, uint profile) {
 
     /* Process ChaCha 1st, Salsa 2nd and XOR them into FastKDF; otherwise Salsa only */
 
-    if(dblmix) {
-        /* blkcpy(Z, X) */
+#ifdef NEOSCRYPT_X86_SIMD
+    if(neoscrypt_smix_simd && dblmix && (r == 2)) {
+        /* Z = SMix(Z) and X = SMix(X) side by side, W is the 2nd V */
+        W = &V[N * (32 * r)];
         neoscrypt_blkcpy(&Z[0], &X[0], r * 2 * BLOCK_SIZE);
+        neoscrypt_salsa_permute(&X[0], &Y[0], r, 0);
+        neoscrypt_smix_simd(&X[0], &Z[0], &V[0], &W[0], N, mixmode & 0xFF);
+        neoscrypt_salsa_permute(&X[0], &Y[0], r, 1);
+    } else
+#endif
+    {
+        if(dblmix) {
+            /* blkcpy(Z, X) */
+            neoscrypt_blkcpy(&Z[0], &X[0], r * 2 * BLOCK_SIZE);
 
-        /* Z = SMix(Z) */
-        for(i = 0; i < N; i++) {
-            /* blkcpy(V, Z) */
-            neoscrypt_blkcpy(&V[i * (32 * r)], &Z[0], r * 2 * BLOCK_SIZE);
-            /* blkmix(Z, Y) */
-            neoscrypt_blkmix(&Z[0], &Y[0], r, (mixmode | 0x0100));
+            /* Z = SMix(Z) */
+            neoscrypt_smix(&Z[0], &Y[0], &V[0], N, r, (mixmode | 0x0100));
         }
 
-        for(i = 0; i < N; i++) {
-            /* integerify(Z) mod N */
-            j = (32 * r) * (Z[16 * (2 * r - 1)] & (N - 1));
-            /* blkxor(Z, V) */
-            neoscrypt_blkxor(&Z[0], &V[j], r * 2 * BLOCK_SIZE);
-            /* blkmix(Z, Y) */
-            neoscrypt_blkmix(&Z[0], &Y[0], r, (mixmode | 0x0100));
-        }
-    }
-
-    /* X = SMix(X) */
-    for(i = 0; i < N; i++) {
-        /* blkcpy(V, X) */
-        neoscrypt_blkcpy(&V[i * (32 * r)], &X[0], r * 2 * BLOCK_SIZE);
-        /* blkmix(X, Y) */
-        neoscrypt_blkmix(&X[0], &Y[0], r, mixmode);
-    }
-    for(i = 0; i < N; i++) {
-        /* integerify(X) mod N */
-        j = (32 * r) * (X[16 * (2 * r - 1)] & (N - 1));
-        /* blkxor(X, V) */
-        neoscrypt_blkxor(&X[0], &V[j], r * 2 * BLOCK_SIZE);
-        /* blkmix(X, Y) */
-        neoscrypt_blkmix(&X[0], &Y[0], r, mixmode);
+        /* X = SMix(X) */
+        neoscrypt_smix(&X[0], &Y[0], &V[0], N, r, mixmode);
     }
 
     if(dblmix)
@@ -3254,10 +3386,62 @@ void neoscrypt_fastkdf_4way(const uchar *password, const uchar *salt,
 #endif /* (ASM) && (MINER_4WAY) */
 
 #ifndef ASM
+/* Same bit layout as the assembly detector with one addition:
+ *  16 : AVX2 */
 uint cpu_vec_exts() {
+#ifdef NEOSCRYPT_X86_SIMD
+    uint eax, ebx, ecx, edx, xcr0_lo, xcr0_hi, max_leaf;
+    /* all AMD64 compatible processors support MMX, MMX+, SSE, SSE2 */
+    uint exts = 0x00000033;
+
+    max_leaf = __get_cpuid_max(0, NULL);
+    if(max_leaf < 1)
+      return(exts);
+
+    __cpuid(1, eax, ebx, ecx, edx);
+    if(ecx & 0x00000001) exts |= 0x00000040;
+    if(ecx & 0x00000200) exts |= 0x00000080;
+    if(ecx & 0x00080000) exts |= 0x00000100;
+    if(ecx & 0x00100000) exts |= 0x00000200;
+
+    /* AVX and AVX2 also need the OS to save the YMM state (OSXSAVE, XCR0) */
+    if((ecx & 0x18000000) != 0x18000000)
+      return(exts);
+    __asm__ __volatile__("xgetbv" : "=a"(xcr0_lo), "=d"(xcr0_hi) : "c"(0));
+    if((xcr0_lo & 0x6) != 0x6)
+      return(exts);
+    exts |= 0x00002000;
+
+    if(max_leaf >= 7) {
+        __cpuid_count(7, 0, eax, ebx, ecx, edx);
+        if(ebx & 0x00000020) exts |= 0x00010000;
+    }
+
+    return(exts);
+#else
 
     /* No assembly, no extensions */
 
     return(0);
+#endif
+}
+#else
+uint neoscrypt_engine_select(uint engine) {
+
+    /* The assembly engine is fixed at build time */
+
+    return(NEOSCRYPT_ENGINE_SCALAR);
+}
+
+uint neoscrypt_engine_init() {
+    return(NEOSCRYPT_ENGINE_SCALAR);
+}
+
+uint neoscrypt_engine() {
+    return(NEOSCRYPT_ENGINE_SCALAR);
+}
+
+const char *neoscrypt_engine_name(uint engine) {
+    return("asm");
 }
 #endif
@@ -1,3 +1,6 @@
+#ifndef BITCOIN_CRYPTO_NEOSCRYPT_H
+#define BITCOIN_CRYPTO_NEOSCRYPT_H
+
 #if (__cplusplus)
 extern "C" {
 #endif
@@ -32,6 +35,19 @@ void neoscrypt_fastkdf_4way(const unsigned char *password,
 
 unsigned int cpu_vec_exts(void);
 
+/* Runtime selected SMix engines, bit-identical to each other */
+#define NEOSCRYPT_ENGINE_SCALAR 0
+#define NEOSCRYPT_ENGINE_SSE2   1
+#define NEOSCRYPT_ENGINE_SSSE3  2
+#define NEOSCRYPT_ENGINE_AVX2   3
+
+/* Selects the best engine supported by the CPU and returns it */
+unsigned int neoscrypt_engine_init(void);
+/* Selects the given engine or the best supported one below it and returns it */
+unsigned int neoscrypt_engine_select(unsigned int engine);
+unsigned int neoscrypt_engine(void);
+const char *neoscrypt_engine_name(unsigned int engine);
+
 #if (__cplusplus)
 }
 #else
@@ -70,3 +86,5 @@ typedef uchar hash_digest[DIGEST_SIZE];
     U32TO8_BE((p) + 4, (uint)((v)      ));
 
 #endif
+
+#endif /* BITCOIN_CRYPTO_NEOSCRYPT_H */
@@ -0,0 +1,215 @@
+/*
+ * Copyright (c) 2009 Colin Percival, 2011 ArtForz
+ * Copyright (c) 2012 Andrew Moon (floodyberry)
+ * Copyright (c) 2014-2016 John Doering <ghostlander@phoenixcoin.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/* NeoScrypt SIMD block mix kernels.
+ *
+ * This file is a template included by neoscrypt.c once per instruction set.
+ * The includer defines:
+ *   NEOSCRYPT_SIMD(name)    : appends the instruction set suffix to name;
+ *   NEOSCRYPT_SIMD_TARGET   : the compiler target string, e.g. "ssse3";
+ *   NEOSCRYPT_SIMD_PSHUFB   : 1 to do the ChaCha 16/8-bit rotations with PSHUFB;
+ *   NEOSCRYPT_SIMD_YMM      : 1 to do the 256-bit block copies and XORs.
+ *
+ * Only NeoScrypt proper (r = 2, ChaCha20 and Salsa20) is handled here; the
+ * caller falls back to the portable code for anything else. A single block of
+ * either cipher leaves most of a vector unit idle, so the two independent
+ * SMix passes are run together and their rounds interleaved. Salsa20 expects
+ * its state permuted into the diagonal order (x0,x5,x10,x15), (x4,x9,x14,x3),
+ * (x8,x13,x2,x7), (x12,x1,x6,x11) for the whole SMix, ChaCha20 works on the
+ * natural rows. */
+
+#define NEOSCRYPT_SIMD_FN static inline __attribute__((always_inline, target(NEOSCRYPT_SIMD_TARGET)))
+
+#define NEOSCRYPT_SIMD_ROTL(x, n) \
+    _mm_or_si128(_mm_slli_epi32((x), (n)), _mm_srli_epi32((x), 32 - (n)))
+
+#if (NEOSCRYPT_SIMD_PSHUFB)
+#define NEOSCRYPT_SIMD_ROTL16(x) \
+    _mm_shuffle_epi8((x), _mm_set_epi8(13, 12, 15, 14, 9, 8, 11, 10, 5, 4, 7, 6, 1, 0, 3, 2))
+#define NEOSCRYPT_SIMD_ROTL8(x) \
+    _mm_shuffle_epi8((x), _mm_set_epi8(14, 13, 12, 15, 10, 9, 8, 11, 6, 5, 4, 7, 2, 1, 0, 3))
+#else
+#define NEOSCRYPT_SIMD_ROTL16(x) \
+    _mm_shufflehi_epi16(_mm_shufflelo_epi16((x), 0xB1), 0xB1)
+#define NEOSCRYPT_SIMD_ROTL8(x) NEOSCRYPT_SIMD_ROTL(x, 8)
+#endif
+
+/* Salsa20 of the diagonal ordered block S and ChaCha20 of the row ordered
+ * block C, rounds must be a multiple of 2 */
+NEOSCRYPT_SIMD_FN void NEOSCRYPT_SIMD(salsa_chacha)(__m128i *S, __m128i *C,
+  uint rounds) {
+    __m128i a = S[0], b = S[1], c = S[2], d = S[3];
+    __m128i e = C[0], f = C[1], g = C[2], h = C[3];
+
+    for(; rounds; rounds -= 2) {
+        b = _mm_xor_si128(b, NEOSCRYPT_SIMD_ROTL(_mm_add_epi32(a, d),  7));
+        e = _mm_add_epi32(e, f); h = NEOSCRYPT_SIMD_ROTL16(_mm_xor_si128(h, e));
+        c = _mm_xor_si128(c, NEOSCRYPT_SIMD_ROTL(_mm_add_epi32(b, a),  9));
+        g = _mm_add_epi32(g, h); f = NEOSCRYPT_SIMD_ROTL(_mm_xor_si128(f, g), 12);
+        d = _mm_xor_si128(d, NEOSCRYPT_SIMD_ROTL(_mm_add_epi32(c, b), 13));
+        e = _mm_add_epi32(e, f); h = NEOSCRYPT_SIMD_ROTL8(_mm_xor_si128(h, e));
+        a = _mm_xor_si128(a, NEOSCRYPT_SIMD_ROTL(_mm_add_epi32(d, c), 18));
+        g = _mm_add_epi32(g, h); f = NEOSCRYPT_SIMD_ROTL(_mm_xor_si128(f, g), 7);
+
+        b = _mm_shuffle_epi32(b, 0x93);
+        f = _mm_shuffle_epi32(f, 0x39);
+        c = _mm_shuffle_epi32(c, 0x4E);
+        g = _mm_shuffle_epi32(g, 0x4E);
+        d = _mm_shuffle_epi32(d, 0x39);
+        h = _mm_shuffle_epi32(h, 0x93);
+
+        d = _mm_xor_si128(d, NEOSCRYPT_SIMD_ROTL(_mm_add_epi32(a, b),  7));
+        e = _mm_add_epi32(e, f); h = NEOSCRYPT_SIMD_ROTL16(_mm_xor_si128(h, e));
+        c = _mm_xor_si128(c, NEOSCRYPT_SIMD_ROTL(_mm_add_epi32(d, a),  9));
+        g = _mm_add_epi32(g, h); f = NEOSCRYPT_SIMD_ROTL(_mm_xor_si128(f, g), 12);
+        b = _mm_xor_si128(b, NEOSCRYPT_SIMD_ROTL(_mm_add_epi32(c, d), 13));
+        e = _mm_add_epi32(e, f); h = NEOSCRYPT_SIMD_ROTL8(_mm_xor_si128(h, e));
+        a = _mm_xor_si128(a, NEOSCRYPT_SIMD_ROTL(_mm_add_epi32(b, c), 18));
+        g = _mm_add_epi32(g, h); f = NEOSCRYPT_SIMD_ROTL(_mm_xor_si128(f, g), 7);
+
+        b = _mm_shuffle_epi32(b, 0x39);
+        f = _mm_shuffle_epi32(f, 0x93);
+        c = _mm_shuffle_epi32(c, 0x4E);
+        g = _mm_shuffle_epi32(g, 0x4E);
+        d = _mm_shuffle_epi32(d, 0x93);
+        h = _mm_shuffle_epi32(h, 0x39);
+    }
+
+    S[0] = _mm_add_epi32(S[0], a);
+    S[1] = _mm_add_epi32(S[1], b);
+    S[2] = _mm_add_epi32(S[2], c);
+    S[3] = _mm_add_epi32(S[3], d);
+    C[0] = _mm_add_epi32(C[0], e);
+    C[1] = _mm_add_epi32(C[1], f);
+    C[2] = _mm_add_epi32(C[2], g);
+    C[3] = _mm_add_epi32(C[3], h);
+}
+
+/* Block mixer for r = 2 of X with Salsa20 and Z with ChaCha20, each of them
+ * 4 blocks of 4 vectors; blocks 1 and 2 are stored swapped as in
+ * neoscrypt_blkmix() */
+NEOSCRYPT_SIMD_FN void NEOSCRYPT_SIMD(blkmix)(__m128i *X, __m128i *Z,
+  uint rounds) {
+    __m128i s[4], c[4], t[4], u[4];
+    uint k;
+
+    for(k = 0; k < 4; k++) {
+        s[k] = _mm_xor_si128(X[k], X[12 + k]);
+        c[k] = _mm_xor_si128(Z[k], Z[12 + k]);
+    }
+    NEOSCRYPT_SIMD(salsa_chacha)(s, c, rounds);
+    for(k = 0; k < 4; k++) {
+        X[k] = s[k];
+        Z[k] = c[k];
+        t[k] = _mm_xor_si128(s[k], X[4 + k]);
+        u[k] = _mm_xor_si128(c[k], Z[4 + k]);
+    }
+    NEOSCRYPT_SIMD(salsa_chacha)(t, u, rounds);
+    for(k = 0; k < 4; k++) {
+        s[k] = _mm_xor_si128(t[k], X[8 + k]);
+        c[k] = _mm_xor_si128(u[k], Z[8 + k]);
+    }
+    NEOSCRYPT_SIMD(salsa_chacha)(s, c, rounds);
+    for(k = 0; k < 4; k++) {
+        X[4 + k] = s[k];
+        Z[4 + k] = c[k];
+        X[8 + k] = t[k];
+        Z[8 + k] = u[k];
+        s[k] = _mm_xor_si128(s[k], X[12 + k]);
+        c[k] = _mm_xor_si128(c[k], Z[12 + k]);
+    }
+    NEOSCRYPT_SIMD(salsa_chacha)(s, c, rounds);
+    for(k = 0; k < 4; k++) {
+        X[12 + k] = s[k];
+        Z[12 + k] = c[k];
+    }
+}
+
+/* 256-byte block copy and XOR for r = 2 */
+NEOSCRYPT_SIMD_FN void NEOSCRYPT_SIMD(blkcpy)(void *dstp, const void *srcp) {
+    uint i;
+#if (NEOSCRYPT_SIMD_YMM)
+    __m256i *dst = (__m256i *) dstp;
+    const __m256i *src = (const __m256i *) srcp;
+
+    for(i = 0; i < 8; i++)
+      _mm256_storeu_si256(&dst[i], _mm256_loadu_si256(&src[i]));
+#else
+    __m128i *dst = (__m128i *) dstp;
+    const __m128i *src = (const __m128i *) srcp;
+
+    for(i = 0; i < 16; i++)
+      dst[i] = src[i];
+#endif
+}
+
+NEOSCRYPT_SIMD_FN void NEOSCRYPT_SIMD(blkxor)(void *dstp, const void *srcp) {
+    uint i;
+#if (NEOSCRYPT_SIMD_YMM)
+    __m256i *dst = (__m256i *) dstp;
+    const __m256i *src = (const __m256i *) srcp;
+
+    for(i = 0; i < 8; i++)
+      _mm256_storeu_si256(&dst[i], _mm256_xor_si256(_mm256_loadu_si256(&dst[i]),
+        _mm256_loadu_si256(&src[i])));
+#else
+    __m128i *dst = (__m128i *) dstp;
+    const __m128i *src = (const __m128i *) srcp;
+
+    for(i = 0; i < 16; i++)
+      dst[i] = _mm_xor_si128(dst[i], src[i]);
+#endif
+}
+
+/* Both SMix passes for r = 2: X = SMix(X) with Salsa20 using V and
+ * Z = SMix(Z) with ChaCha20 using W; X, Z, V and W must be 16-byte aligned
+ * and X already permuted into the diagonal order */
+static __attribute__((target(NEOSCRYPT_SIMD_TARGET)))
+void NEOSCRYPT_SIMD(neoscrypt_smix)(uint *X, uint *Z, uint *V, uint *W,
+  uint N, uint rounds) {
+    uint i, j, k;
+
+    for(i = 0; i < N; i++) {
+        NEOSCRYPT_SIMD(blkcpy)(&V[i * 64], &X[0]);
+        NEOSCRYPT_SIMD(blkcpy)(&W[i * 64], &Z[0]);
+        NEOSCRYPT_SIMD(blkmix)((__m128i *) X, (__m128i *) Z, rounds);
+    }
+    for(i = 0; i < N; i++) {
+        /* integerify() mod N; x0 keeps its place in the diagonal order */
+        j = 64 * (X[48] & (N - 1));
+        k = 64 * (Z[48] & (N - 1));
+        NEOSCRYPT_SIMD(blkxor)(&X[0], &V[j]);
+        NEOSCRYPT_SIMD(blkxor)(&Z[0], &W[k]);
+        NEOSCRYPT_SIMD(blkmix)((__m128i *) X, (__m128i *) Z, rounds);
+    }
+}
+
+#undef NEOSCRYPT_SIMD_FN
+#undef NEOSCRYPT_SIMD_ROTL
+#undef NEOSCRYPT_SIMD_ROTL16
+#undef NEOSCRYPT_SIMD_ROTL8
@@ -20,6 +20,7 @@
 void CDSNotificationInterface::InitializeCurrentBlockTip()
 {
     LOCK(cs_main);
+    fDIP0001ActiveAtTip = chainActive.Height() >= Params().GetConsensus().DIP0001Height;
     UpdatedBlockTip(chainActive.Tip(), NULL, IsInitialBlockDownload());
 }
 
@@ -43,9 +44,6 @@ void CDSNotificationInterface::UpdatedBlockTip(const CBlockIndex *pindexNew, con
     masternodeSync.UpdatedBlockTip(pindexNew, fInitialDownload, connman);
     fundamentalnodeSync.UpdatedBlockTip(pindexNew, fInitialDownload, connman);
 
-    // Update global DIP0001 activation status
-    fDIP0001ActiveAtTip = pindexNew->nHeight >= Params().GetConsensus().DIP0001Height;
-
     if (fInitialDownload)
         return;
 
@@ -68,4 +66,7 @@ void CDSNotificationInterface::SyncTransaction(const CTransaction &tx, const CBl
 {
     instantsend.SyncTransaction(tx, pindex, posInBlock);
     CPrivateSend::SyncTransaction(tx, pindex, posInBlock);
+    mnodeman.SyncTransaction(tx, pindex, posInBlock);
+    mnpayments.SyncTransaction(tx, pindex, posInBlock);
+    fnpayments.SyncTransaction(tx, pindex, posInBlock);
 }
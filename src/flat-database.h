@@ -51,11 +51,13 @@ private:
         uint256 hash = Hash(ssObj.begin(), ssObj.end());
         ssObj << hash;
 
-        // open output file, and associate with CAutoFile
-        FILE *file = fopen(pathDB.string().c_str(), "wb");
+        // write to a temporary file and only replace the old one once it is
+        // complete, so that a crash while writing doesn't lose the old one
+        boost::filesystem::path pathTmp = pathDB.string() + ".new";
+        FILE *file = fopen(pathTmp.string().c_str(), "wb");
         CAutoFile fileout(file, SER_DISK, CLIENT_VERSION);
         if (fileout.IsNull())
-            return error("%s: Failed to open file %s", __func__, pathDB.string());
+            return error("%s: Failed to open file %s", __func__, pathTmp.string());
 
         // Write and commit header, data
         try {
@@ -64,15 +66,19 @@ private:
         catch (std::exception &e) {
             return error("%s: Serialize or I/O error - %s", __func__, e.what());
         }
+        FileCommit(fileout.Get());
         fileout.fclose();
 
+        if (!RenameOver(pathTmp, pathDB))
+            return error("%s: Failed to rename %s to %s", __func__, pathTmp.string(), pathDB.string());
+
         LogPrintf("Written info to %s  %dms\n", strFilename, GetTimeMillis() - nStart);
         LogPrintf("     %s\n", objToSave.ToString());
 
         return true;
     }
 
-    ReadResult Read(T& objToLoad, bool fDryRun = false)
+    ReadResult Read(T& objToLoad, bool fCleanup = true)
     {
         //LOCK(objToLoad.cs);
 
@@ -153,7 +159,7 @@ private:
 
         LogPrintf("Loaded info from %s  %dms\n", strFilename, GetTimeMillis() - nStart);
         LogPrintf("     %s\n", objToLoad.ToString());
-        if(!fDryRun) {
+        if(fCleanup) {
             LogPrintf("%s: Cleaning....\n", __func__);
             objToLoad.CheckAndRemove();
             LogPrintf("     %s\n", objToLoad.ToString());
@@ -171,10 +177,14 @@ public:
         strMagicMessage = strMagicMessageIn;
     }
 
-    bool Load(T& objToLoad)
+    /**
+     * Load the object from the file. If fCleanup is false, the caller is
+     * responsible for calling CheckAndRemove() on it later.
+     */
+    bool Load(T& objToLoad, bool fCleanup = true)
     {
         LogPrintf("Reading info from %s...\n", strFilename);
-        ReadResult readResult = Read(objToLoad);
+        ReadResult readResult = Read(objToLoad, fCleanup);
         if (readResult == FileError)
             LogPrintf("Missing file %s, will try to recreate\n", strFilename);
         else if (readResult != Ok)
@@ -197,27 +207,12 @@ public:
     {
         int64_t nStart = GetTimeMillis();
 
-        LogPrintf("Verifying %s format...\n", strFilename);
-        T tmpObjToLoad;
-        ReadResult readResult = Read(tmpObjToLoad, true);
-
-        // there was an error and it was not an error on file opening => do not proceed
-        if (readResult == FileError)
-            LogPrintf("Missing file %s, will try to recreate\n", strFilename);
-        else if (readResult != Ok)
-        {
-            LogPrintf("Error reading %s: ", strFilename);
-            if(readResult == IncorrectFormat)
-                LogPrintf("%s: Magic is ok but data has invalid format, will try to recreate\n", __func__);
-            else
-            {
-                LogPrintf("%s: File format is unknown or invalid, please fix it manually\n", __func__);
-                return false;
-            }
-        }
-
+        // The file was checked when it was loaded at startup, and it is only
+        // replaced once the new one is completely written, so there is no need
+        // to read it again first
         LogPrintf("Writing info to %s...\n", strFilename);
-        Write(objToSave);
+        if (!Write(objToSave))
+            return false;
         LogPrintf("%s dump finished  %dms\n", strFilename, GetTimeMillis() - nStart);
 
         return true;
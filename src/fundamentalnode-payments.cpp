@@ -13,6 +13,7 @@
 #include "netmessagemaker.h"
 #include "spork.h"
 #include "util.h"
+#include "validationinterface.h"
 
 #include <boost/lexical_cast.hpp>
 
@@ -206,6 +207,9 @@ void CFundamentalnodePayments::Clear()
     LOCK2(cs_mapFundamentalnodeBlocks, cs_mapFundamentalnodePaymentVotes);
     mapFundamentalnodeBlocks.clear();
     mapFundamentalnodePaymentVotes.clear();
+
+    LOCK(cs_mapBlockPaymentOutputs);
+    mapBlockPaymentOutputs.clear();
 }
 
 bool CFundamentalnodePayments::UpdateLastVote(const CFundamentalnodePaymentVote& vote)
@@ -1083,6 +1087,49 @@ void CFundamentalnodePayments::UpdatedBlockTip(const CBlockIndex *pindex, CConnm
     CheckBlockVotes(nFutureBlock - 1);
     ProcessBlock(nFutureBlock, connman);
 }
+
+void CFundamentalnodePayments::SyncTransaction(const CTransaction& tx, const CBlockIndex *pindex, int posInBlock)
+{
+    if(fLiteMode) return;
+
+    // only the transaction paying the fundamentalnode of a connected block is indexed
+    if(!pindex || posInBlock == CMainSignals::SYNC_TRANSACTION_NOT_IN_BLOCK) return;
+    if(posInBlock != (pindex->nHeight > Params().GetConsensus().nLastPoWBlock ? 1 : 0)) return;
+
+    int nLimit = GetStorageLimit();
+
+    LOCK(cs_mapBlockPaymentOutputs);
+    mapBlockPaymentOutputs[pindex->nHeight] = std::make_pair(pindex->GetBlockHash(), tx.vout);
+    mapBlockPaymentOutputs.erase(mapBlockPaymentOutputs.begin(), mapBlockPaymentOutputs.lower_bound(pindex->nHeight - nLimit));
+}
+
+bool CFundamentalnodePayments::GetBlockPaymentOutputs(const CBlockIndex *pindex, std::vector<CTxOut>& voutRet)
+{
+    {
+        LOCK(cs_mapBlockPaymentOutputs);
+        auto it = mapBlockPaymentOutputs.find(pindex->nHeight);
+        if(it != mapBlockPaymentOutputs.end() && it->second.first == pindex->GetBlockHash()) {
+            voutRet = it->second.second;
+            return true;
+        }
+    }
+
+    // The block was connected before we started or on another branch, read it once
+    CBlock block;
+    if(!ReadBlockFromDisk(block, pindex, Params().GetConsensus()))
+        return false;
+
+    size_t nPaymentTx = pindex->nHeight > Params().GetConsensus().nLastPoWBlock ? 1 : 0;
+    if(block.vtx.size() <= nPaymentTx)
+        return false;
+
+    voutRet = block.vtx[nPaymentTx]->vout;
+
+    LOCK(cs_mapBlockPaymentOutputs);
+    mapBlockPaymentOutputs[pindex->nHeight] = std::make_pair(pindex->GetBlockHash(), voutRet);
+    return true;
+}
+
 void AdjustFundamentalnodePayment(CMutableTransaction &tx, const CTxOut &txoutFundamentalnodePayment)
 {
     auto it = std::find(std::begin(tx.vout), std::end(tx.vout), txoutFundamentalnodePayment);
@@ -28,6 +28,7 @@ static const int MIN_FUNDAMENTALNODE_PAYMENT_PROTO_VERSION_2 = 70211;
 
 extern CCriticalSection cs_vecPayeesFN;
 extern CCriticalSection cs_mapFundamentalnodeBlocks;
+extern CCriticalSection cs_mapFundamentalnodePaymentVotes;
 extern CCriticalSection cs_mapFundamentalnodePayeeVotes;
 
 extern CFundamentalnodePayments fnpayments;
@@ -186,6 +187,11 @@ private:
     // Keep track of current block height
     int nCachedBlockHeight;
 
+    // payment transaction outputs of recent blocks by height, so that last paid
+    // blocks can be found without reading the blocks from disk again
+    std::map<int, std::pair<uint256, std::vector<CTxOut> > > mapBlockPaymentOutputs;
+    mutable CCriticalSection cs_mapBlockPaymentOutputs;
+
 public:
     std::map<uint256, CFundamentalnodePaymentVote> mapFundamentalnodePaymentVotes;
     std::map<int, CFundamentalnodeBlockPayees> mapFundamentalnodeBlocks;
@@ -198,6 +204,7 @@ public:
 
     template <typename Stream, typename Operation>
     inline void SerializationOp(Stream& s, Operation ser_action) {
+        LOCK2(cs_mapFundamentalnodeBlocks, cs_mapFundamentalnodePaymentVotes);
         READWRITE(mapFundamentalnodePaymentVotes);
         READWRITE(mapFundamentalnodeBlocks);
     }
@@ -232,6 +239,9 @@ public:
     int GetStorageLimit() const;
 
     void UpdatedBlockTip(const CBlockIndex *pindex, CConnman& connman);
+    void SyncTransaction(const CTransaction& tx, const CBlockIndex *pindex, int posInBlock);
+
+    bool GetBlockPaymentOutputs(const CBlockIndex *pindex, std::vector<CTxOut>& voutRet);
 };
 
 
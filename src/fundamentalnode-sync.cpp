@@ -76,11 +76,15 @@ void CFundamentalnodeSync::SwitchToNextAsset(CConnman& connman)
             LogPrintf("CFundamentalnodeSync::SwitchToNextAsset -- Completed %s in %llds\n", GetAssetName(), GetTime() - nTimeAssetSyncStarted);
             nRequestedFundamentalnodeAssets = FUNDAMENTALNODE_SYNC_MNW;
             LogPrintf("CFundamentalnodeSync::SwitchToNextAsset -- Starting %s\n", GetAssetName());
+            // fundamentalnodes no longer wait for pings
+            fnodeman.ScheduleAllChecks();
             break;
         case(FUNDAMENTALNODE_SYNC_MNW):
             LogPrintf("CFundamentalnodeSync::SwitchToNextAsset -- Completed %s in %llds\n", GetAssetName(), GetTime() - nTimeAssetSyncStarted);
             nRequestedFundamentalnodeAssets = FUNDAMENTALNODE_SYNC_FINISHED;
             uiInterface.NotifyAdditionalDataSyncProgressChanged(1);
+            // sentinel pings start to count
+            fnodeman.ScheduleAllChecks();
             //try to activate our fundamentalnode if possible
             activeFundamentalnode.ManageState(connman);
 
@@ -193,6 +197,7 @@ void CFundamentalnodeSync::ProcessTick(CConnman& connman)
                 //SendGovernanceSyncRequest(pnode, connman);
             } else {
                 nRequestedFundamentalnodeAssets = FUNDAMENTALNODE_SYNC_FINISHED;
+                fnodeman.ScheduleAllChecks();
             }
             nRequestedFundamentalnodeAttempt++;
             connman.ReleaseNodeVector(vNodesCopy);
@@ -9,6 +9,8 @@
 
 #include <univalue.h>
 
+#include <atomic>
+
 class CFundamentalnodeSync;
 
 static const int FUNDAMENTALNODE_SYNC_FAILED          = -1;
@@ -32,17 +34,19 @@ extern CFundamentalnodeSync fundamentalnodeSync;
 class CFundamentalnodeSync
 {
 private:
+    // Atomic, the modules bump them from several message handler threads
+
     // Keep track of current asset
-    int nRequestedFundamentalnodeAssets;
+    std::atomic<int> nRequestedFundamentalnodeAssets;
     // Count peers we've requested the asset from
-    int nRequestedFundamentalnodeAttempt;
+    std::atomic<int> nRequestedFundamentalnodeAttempt;
 
     // Time when current fundamentalnode asset sync started
-    int64_t nTimeAssetSyncStarted;
+    std::atomic<int64_t> nTimeAssetSyncStarted;
     // ... last bumped
-    int64_t nTimeLastBumped;
+    std::atomic<int64_t> nTimeLastBumped;
     // ... or failed
-    int64_t nTimeLastFailure;
+    std::atomic<int64_t> nTimeLastFailure;
 
     void Fail();
 
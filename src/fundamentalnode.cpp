@@ -13,11 +13,14 @@
 #include "fundamentalnodeman.h"
 #include "messagesigner.h"
 #include "script/standard.h"
+#include "timedata.h"
 #include "util.h"
 #ifdef ENABLE_WALLET
 #include "wallet/wallet.h"
 #endif // ENABLE_WALLET
 
+#include <limits>
+
 #include <boost/lexical_cast.hpp>
 
 
@@ -266,6 +269,24 @@ void CFundamentalnode::Check(bool fForce)
     }
 }
 
+int64_t CFundamentalnode::GetNextPingTransitionTime()
+{
+    LOCK(cs);
+    int64_t nNext = std::numeric_limits<int64_t>::max();
+    if(!lastPing) return nNext;
+
+    // the thresholds IsPingedWithin is called with in Check
+    int64_t nNow = GetAdjustedTime();
+    for (int nSeconds : {FUNDAMENTALNODE_MIN_MNP_SECONDS, FUNDAMENTALNODE_SENTINEL_PING_MAX_SECONDS, FUNDAMENTALNODE_EXPIRATION_SECONDS, FUNDAMENTALNODE_NEW_START_REQUIRED_SECONDS}) {
+        int64_t nTime = lastPing.sigTime + nSeconds;
+        if(nTime > nNow) nNext = std::min(nNext, nTime);
+    }
+    if(nNext == std::numeric_limits<int64_t>::max()) return nNext;
+
+    // pings are timed in network adjusted time
+    return nNext - GetTimeOffset();
+}
+
 bool CFundamentalnode::IsValidNetAddr()
 {
     return IsValidNetAddr(addr);
@@ -327,15 +348,13 @@ void CFundamentalnode::UpdateLastPaid(const CBlockIndex *pindex, int nMaxBlocksT
         if(fnpayments.mapFundamentalnodeBlocks.count(BlockReading->nHeight) &&
            fnpayments.mapFundamentalnodeBlocks[BlockReading->nHeight].HasPayeeWithVotes(fnpayee, 2))
         {
-            CBlock block;
-            if(!ReadBlockFromDisk(block, BlockReading, Params().GetConsensus())) // shouldn't really happen
+            std::vector<CTxOut> vout;
+            if(!fnpayments.GetBlockPaymentOutputs(BlockReading, vout)) // shouldn't really happen
                 continue;
 
-            const auto& coinbaseTransaction = (BlockReading->nHeight > Params().GetConsensus().nLastPoWBlock ? block.vtx[1] : block.vtx[0]);
-
             CAmount nFundamentalnodePayment = GetFundamentalnodePayment(BlockReading->nHeight, BlockReading->nMint);
 
-            for(const CTxOut &txout : coinbaseTransaction->vout)
+            for(const CTxOut &txout : vout)
                 if(fnpayee == txout.scriptPubKey && nFundamentalnodePayment == txout.nValue) {
                     nBlockLastPaid = BlockReading->nHeight;
                     nTimeLastPaid = BlockReading->nTime;
@@ -248,6 +248,9 @@ public:
     static CollateralStatus CheckCollateral(const COutPoint& outpoint, const CPubKey& pubkey);
     static CollateralStatus CheckCollateral(const COutPoint& outpoint, const CPubKey& pubkey, int& nHeightRet);
     void Check(bool fForce = false);
+    /// GetTime() at which the age of the last ping changes the state next,
+    /// or max() if no such change is left
+    int64_t GetNextPingTransitionTime();
 
     bool IsBroadcastedWithin(int nSeconds) { return GetAdjustedTime() - sigTime < nSeconds; }
 
@@ -58,6 +58,7 @@ struct CompareByAddr
 CFundamentalnodeMan::CFundamentalnodeMan():
     cs(),
     mapFundamentalnodes(),
+    mapRankCache(RANK_CACHE_SIZE),
     mAskedUsForFundamentalnodeList(),
     mWeAskedForFundamentalnodeList(),
     mWeAskedForFundamentalnodeListEntry(),
@@ -82,6 +83,8 @@ bool CFundamentalnodeMan::Add(CFundamentalnode &fn)
 
     LogPrint("fundamentalnode", "CFundamentalnodeMan::Add -- Adding new Fundamentalnode: addr=%s, %i now\n", fn.addr.ToString(), size() + 1);
     mapFundamentalnodes[fn.outpoint] = fn;
+    ScheduleCheck(fn.outpoint, GetTime());
+    mapRankCache.Clear();
     fFundamentalnodesAdded = true;
     return true;
 }
@@ -155,20 +158,96 @@ bool CFundamentalnodeMan::PoSeBan(const COutPoint &outpoint)
         return false;
     }
     pfn->PoSeBan();
+    ScheduleCheck(outpoint, GetTime());
 
     return true;
 }
 
+void CFundamentalnodeMan::ScheduleCheck(const COutPoint& outpoint, int64_t nTime)
+{
+    AssertLockHeld(cs);
+
+    auto it = mapScheduledChecks.find(outpoint);
+    if (it != mapScheduledChecks.end()) {
+        setScheduledChecks.erase(std::make_pair(it->second, outpoint));
+        it->second = nTime;
+    } else {
+        mapScheduledChecks.emplace(outpoint, nTime);
+    }
+    setScheduledChecks.emplace(nTime, outpoint);
+}
+
+void CFundamentalnodeMan::UnscheduleCheck(const COutPoint& outpoint)
+{
+    AssertLockHeld(cs);
+
+    auto it = mapScheduledChecks.find(outpoint);
+    if (it == mapScheduledChecks.end()) return;
+    setScheduledChecks.erase(std::make_pair(it->second, outpoint));
+    mapScheduledChecks.erase(it);
+}
+
+int64_t CFundamentalnodeMan::GetNextCheckTime(CFundamentalnode& fn)
+{
+    AssertLockHeld(cs);
+
+    int64_t nNow = GetTime();
+    int64_t nTime = fn.GetNextPingTransitionTime();
+    // sentinel pings going quiet changes the state of every FN
+    if (nNow - nLastSentinelPingTime <= FUNDAMENTALNODE_SENTINEL_PING_MAX_SECONDS)
+        nTime = std::min(nTime, nLastSentinelPingTime + FUNDAMENTALNODE_SENTINEL_PING_MAX_SECONDS + 1);
+    return std::max(nTime, nNow + 1);
+}
+
+void CFundamentalnodeMan::ScheduleAllChecks()
+{
+    LOCK(cs);
+    int64_t nNow = GetTime();
+    for (const auto& fnpair : mapFundamentalnodes) {
+        if (fnpair.second.IsOutpointSpent()) continue;
+        // keep the checks that are due already, forced ones included
+        auto it = mapScheduledChecks.find(fnpair.first);
+        if (it != mapScheduledChecks.end() && it->second <= nNow) continue;
+        ScheduleCheck(fnpair.first, nNow);
+    }
+}
+
 void CFundamentalnodeMan::Check()
 {
+    int64_t nNow = GetTime();
+    {
+        // don't wait for cs_main when no FN is due
+        LOCK(cs);
+        if (setScheduledChecks.empty() || setScheduledChecks.begin()->first > nNow) return;
+    }
+
     LOCK2(cs_main, cs);
 
     LogPrint("fundamentalnode", "CFundamentalnodeMan::Check -- nLastSentinelPingTime=%d, IsSentinelPingActive()=%d\n", nLastSentinelPingTime, IsSentinelPingActive());
 
-    for (auto& fnpair : mapFundamentalnodes) {
+    while (!setScheduledChecks.empty() && setScheduledChecks.begin()->first <= nNow) {
+        const std::pair<int64_t, COutPoint> check = *setScheduledChecks.begin();
+        auto it = mapFundamentalnodes.find(check.second);
+        if (it == mapFundamentalnodes.end()) {
+            UnscheduleCheck(check.second);
+            continue;
+        }
+
         // NOTE: internally it checks only every FUNDAMENTALNODE_CHECK_SECONDS seconds
-        // since the last time, so expect some MNs to skip this
-        fnpair.second.Check();
+        // since the last time, so FNs checked on a ping skip this
+        it->second.Check();
+        if (it->second.IsOutpointSpent()) {
+            UnscheduleCheck(check.second);
+            continue;
+        }
+        if (it->second.nTimeLastChecked < nNow) {
+            // skipped, try again once the FN may be checked
+            ScheduleCheck(check.second, std::max(it->second.nTimeLastChecked + FUNDAMENTALNODE_CHECK_SECONDS, nNow + 1));
+            continue;
+        }
+        // nothing but time changes the state until then, new pings, broadcasts,
+        // PoSe bans and sync changes reschedule the FN themselves
+        ScheduleCheck(check.second, GetNextCheckTime(it->second));
     }
 }
 
@@ -203,7 +282,9 @@ void CFundamentalnodeMan::CheckAndRemove(CConnman& connman)
 
                 // and finally remove it from the list
                 it->second.FlagGovernanceItemsAsDirty();
+                UnscheduleCheck(it->first);
                 mapFundamentalnodes.erase(it++);
+                mapRankCache.Clear();
                 fFundamentalnodesRemoved = true;
             } else {
                 bool fAsk = (nAskForFnbRecovery > 0) &&
@@ -360,6 +441,9 @@ void CFundamentalnodeMan::Clear()
 {
     LOCK(cs);
     mapFundamentalnodes.clear();
+    setScheduledChecks.clear();
+    mapScheduledChecks.clear();
+    mapRankCache.Clear();
     mAskedUsForFundamentalnodeList.clear();
     mWeAskedForFundamentalnodeList.clear();
     mWeAskedForFundamentalnodeListEntry.clear();
@@ -653,6 +737,35 @@ bool CFundamentalnodeMan::GetFundamentalnodeScores(const uint256& nBlockHash, CF
     return !vecFundamentalnodeScoresRet.empty();
 }
 
+bool CFundamentalnodeMan::GetRankedFundamentalnodes(const uint256& nBlockHash, std::vector<COutPoint>& vecOutpointsRet, int nMinProtocol)
+{
+    AssertLockHeld(cs);
+
+    vecOutpointsRet.clear();
+
+    // the cached ranks are only valid while the list stays synced
+    if (!fundamentalnodeSync.IsFundamentalnodeListSynced())
+        return false;
+
+    const std::pair<uint256, int> key = std::make_pair(nBlockHash, nMinProtocol);
+    if (mapRankCache.Get(key, vecOutpointsRet))
+        return !vecOutpointsRet.empty();
+
+    score_pair_vec_t vecFundamentalnodeScores;
+    GetFundamentalnodeScores(nBlockHash, vecFundamentalnodeScores, nMinProtocol);
+
+    vecOutpointsRet.reserve(vecFundamentalnodeScores.size());
+    for (const auto& scorePair : vecFundamentalnodeScores) {
+        vecOutpointsRet.push_back(scorePair.second->outpoint);
+    }
+
+    // an empty result is not cached, entries may still be on their way
+    if (!vecOutpointsRet.empty())
+        mapRankCache.Insert(key, vecOutpointsRet);
+
+    return !vecOutpointsRet.empty();
+}
+
 bool CFundamentalnodeMan::GetFundamentalnodeRank(const COutPoint& outpoint, int& nRankRet, int nBlockHeight, int nMinProtocol)
 {
     nRankRet = -1;
@@ -669,14 +782,14 @@ bool CFundamentalnodeMan::GetFundamentalnodeRank(const COutPoint& outpoint, int&
 
     LOCK(cs);
 
-    score_pair_vec_t vecFundamentalnodeScores;
-    if (!GetFundamentalnodeScores(nBlockHash, vecFundamentalnodeScores, nMinProtocol))
+    std::vector<COutPoint> vecOutpoints;
+    if (!GetRankedFundamentalnodes(nBlockHash, vecOutpoints, nMinProtocol))
         return false;
 
     int nRank = 0;
-    for (const auto& scorePair : vecFundamentalnodeScores) {
+    for (const auto& outpointRanked : vecOutpoints) {
         nRank++;
-        if(scorePair.second->outpoint == outpoint) {
+        if(outpointRanked == outpoint) {
             nRankRet = nRank;
             return true;
         }
@@ -701,14 +814,14 @@ bool CFundamentalnodeMan::GetFundamentalnodeRanks(CFundamentalnodeMan::rank_pair
 
     LOCK(cs);
 
-    score_pair_vec_t vecFundamentalnodeScores;
-    if (!GetFundamentalnodeScores(nBlockHash, vecFundamentalnodeScores, nMinProtocol))
+    std::vector<COutPoint> vecOutpoints;
+    if (!GetRankedFundamentalnodes(nBlockHash, vecOutpoints, nMinProtocol))
         return false;
 
     int nRank = 0;
-    for (const auto& scorePair : vecFundamentalnodeScores) {
+    for (const auto& outpoint : vecOutpoints) {
         nRank++;
-        vecFundamentalnodeRanksRet.push_back(std::make_pair(nRank, *scorePair.second));
+        vecFundamentalnodeRanksRet.push_back(std::make_pair(nRank, mapFundamentalnodes.at(outpoint)));
     }
 
     return true;
@@ -858,7 +971,10 @@ void CFundamentalnodeMan::ProcessMessage(CNode* pfrom, const std::string& strCom
         if(pfn && pfn->IsNewStartRequired()) return;
 
         int nDos = 0;
-        if(fnp.CheckAndUpdate(pfn, false, nDos, connman)) return;
+        bool fRelayed = fnp.CheckAndUpdate(pfn, false, nDos, connman);
+        // a new ping moves the expiry of the FN
+        if(pfn) ScheduleCheck(pfn->outpoint, GetNextCheckTime(*pfn));
+        if(fRelayed) return;
 
         if(nDos > 0) {
             // if anything significant failed, mark that node
@@ -1556,10 +1672,13 @@ bool CFundamentalnodeMan::CheckFnbAndUpdateFundamentalnodeList(CNode* pfrom, CFu
         CFundamentalnode* pfn = Find(fnb.outpoint);
         if(pfn) {
             CFundamentalnodeBroadcast fnbOld = mapSeenFundamentalnodeBroadcast[CFundamentalnodeBroadcast(*pfn).GetHash()].second;
+            // the update may change the protocol version of this fundamentalnode
+            mapRankCache.Clear();
             if(!fnb.Update(pfn, nDos, connman)) {
                 LogPrint("fundamentalnode", "CFundamentalnodeMan::CheckFnbAndUpdateFundamentalnodeList -- Update() failed, fundamentalnode=%s\n", fnb.outpoint.ToStringShort());
                 return false;
             }
+            ScheduleCheck(pfn->outpoint, GetNextCheckTime(*pfn));
             if(hash != fnbOld.GetHash()) {
                 mapSeenFundamentalnodeBroadcast.erase(fnbOld.GetHash());
             }
@@ -1618,7 +1737,10 @@ void CFundamentalnodeMan::UpdateLastPaid(const CBlockIndex* pindex)
 void CFundamentalnodeMan::UpdateLastSentinelPingTime()
 {
     LOCK(cs);
+    // sentinel pings becoming active may expire FNs
+    bool fWasActive = IsSentinelPingActive();
     nLastSentinelPingTime = GetTime();
+    if (!fWasActive) ScheduleAllChecks();
 }
 
 bool CFundamentalnodeMan::IsSentinelPingActive()
@@ -1676,6 +1798,7 @@ void CFundamentalnodeMan::SetFundamentalnodeLastPing(const COutPoint& outpoint,
     if(fnp.fSentinelIsCurrent) {
         UpdateLastSentinelPingTime();
     }
+    ScheduleCheck(outpoint, GetNextCheckTime(*pfn));
     mapSeenFundamentalnodePing.insert(std::make_pair(fnp.GetHash(), fnp));
 
     CFundamentalnodeBroadcast fnb(*pfn);
@@ -1692,6 +1815,19 @@ void CFundamentalnodeMan::UpdatedBlockTip(const CBlockIndex *pindex)
 
     CheckSameAddr();
 
+    {
+        // PoSe bans start with blocks rather than time; they never end while
+        // Check leaves the height at 0 with the collateral lookup disabled
+        LOCK(cs);
+        int64_t nNow = GetTime();
+        for (auto& fnpair : mapFundamentalnodes) {
+            if (!fnpair.second.IsOutpointSpent() && !fnpair.second.IsPoSeBanned() &&
+                fnpair.second.nPoSeBanScore >= FUNDAMENTALNODE_POSE_BAN_MAX_SCORE) {
+                ScheduleCheck(fnpair.first, nNow);
+            }
+        }
+    }
+
     if(fFundamentalnodeMode) {
         // normal wallet does not need to update this every block, doing update on rpc call should be enough
         UpdateLastPaid(pindex);
@@ -5,6 +5,7 @@
 #ifndef FUNDAMENTALNODEMAN_H
 #define FUNDAMENTALNODEMAN_H
 
+#include "cachemap.h"
 #include "fundamentalnode.h"
 #include "sync.h"
 
@@ -39,6 +40,8 @@ private:
     static const int MNB_RECOVERY_WAIT_SECONDS      = 60;
     static const int MNB_RECOVERY_RETRY_SECONDS     = 3 * 60 * 60;
 
+    static const int RANK_CACHE_SIZE            = 20;
+
 
     // critical section to protect the inner data structures
     mutable CCriticalSection cs;
@@ -48,6 +51,12 @@ private:
 
     // map to hold all MNs
     std::map<COutPoint, CFundamentalnode> mapFundamentalnodes;
+    // time of the next check of every FN, ordered so that Check() only visits the FNs that are due
+    std::set<std::pair<int64_t, COutPoint> > setScheduledChecks;
+    std::map<COutPoint, int64_t> mapScheduledChecks;
+    // fundamentalnode outpoints sorted by score for recently ranked (block hash, min protocol) pairs,
+    // cleared whenever the list changes
+    CacheMap<std::pair<uint256, int>, std::vector<COutPoint> > mapRankCache;
     // who's asked for the Fundamentalnode list and the last time
     std::map<CService, int64_t> mAskedUsForFundamentalnodeList;
     // who we asked for the Fundamentalnode list and the last time
@@ -81,12 +90,18 @@ private:
     CFundamentalnode* Find(const COutPoint& outpoint);
 
     bool GetFundamentalnodeScores(const uint256& nBlockHash, score_pair_vec_t& vecFundamentalnodeScoresRet, int nMinProtocol = 0);
+    bool GetRankedFundamentalnodes(const uint256& nBlockHash, std::vector<COutPoint>& vecOutpointsRet, int nMinProtocol);
 
     void SyncSingle(CNode* pnode, const COutPoint& outpoint, CConnman& connman);
     void SyncAll(CNode* pnode, CConnman& connman);
 
     void PushDsegFNInvs(CNode* pnode, const CFundamentalnode& fn);
 
+    void ScheduleCheck(const COutPoint& outpoint, int64_t nTime);
+    void UnscheduleCheck(const COutPoint& outpoint);
+    /// The earliest time the state of the FN may change without new data
+    int64_t GetNextCheckTime(CFundamentalnode& fn);
+
 public:
     // Keep track of all broadcasts I've seen
     std::map<uint256, std::pair<int64_t, CFundamentalnodeBroadcast> > mapSeenFundamentalnodeBroadcast;
@@ -113,6 +128,14 @@ public:
         }
 
         READWRITE(mapFundamentalnodes);
+        if(ser_action.ForRead()) {
+            mapRankCache.Clear();
+            setScheduledChecks.clear();
+            mapScheduledChecks.clear();
+            for (const auto& fnpair : mapFundamentalnodes) {
+                ScheduleCheck(fnpair.first, 0);
+            }
+        }
         READWRITE(mAskedUsForFundamentalnodeList);
         READWRITE(mWeAskedForFundamentalnodeList);
         READWRITE(mWeAskedForFundamentalnodeListEntry);
@@ -138,10 +161,12 @@ public:
     void AskForFnb(CNode *pnode, const uint256 &hash);
 
     bool PoSeBan(const COutPoint &outpoint);
+    /// Check every FN soon, for changes that affect them all (sync, sentinel)
+    void ScheduleAllChecks();
     bool AllowMixing(const COutPoint &outpoint);
     bool DisallowMixing(const COutPoint &outpoint);
 
-    /// Check all Fundamentalnodes
+    /// Check the Fundamentalnodes that are due
     void Check();
 
     /// Check all Fundamentalnodes and remove inactive
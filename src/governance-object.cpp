@@ -12,6 +12,7 @@
 #include "masternode-sync.h"
 #include "masternodeman.h"
 #include "messagesigner.h"
+#include "spork.h"
 #include "util.h"
 
 #include <univalue.h>
@@ -37,11 +38,14 @@ CGovernanceObject::CGovernanceObject():
     fExpired(false),
     fUnparsable(false),
     mapCurrentMNVotes(),
+    mapVoteCounts(),
     cmmapOrphanVotes(),
-    fileVotes()
+    fileVotes(),
+    hash()
 {
     // PARSE JSON DATA STORAGE (VCHDATA)
     LoadData();
+    UpdateHash();
 }
 
 CGovernanceObject::CGovernanceObject(const uint256& nHashParentIn, int nRevisionIn, int64_t nTimeIn, const uint256& nCollateralHashIn, const std::string& strDataHexIn):
@@ -65,11 +69,14 @@ CGovernanceObject::CGovernanceObject(const uint256& nHashParentIn, int nRevision
     fExpired(false),
     fUnparsable(false),
     mapCurrentMNVotes(),
+    mapVoteCounts(),
     cmmapOrphanVotes(),
-    fileVotes()
+    fileVotes(),
+    hash()
 {
     // PARSE JSON DATA STORAGE (VCHDATA)
     LoadData();
+    UpdateHash();
 }
 
 CGovernanceObject::CGovernanceObject(const CGovernanceObject& other):
@@ -93,8 +100,10 @@ CGovernanceObject::CGovernanceObject(const CGovernanceObject& other):
     fExpired(other.fExpired),
     fUnparsable(other.fUnparsable),
     mapCurrentMNVotes(other.mapCurrentMNVotes),
+    mapVoteCounts(other.mapVoteCounts),
     cmmapOrphanVotes(other.cmmapOrphanVotes),
-    fileVotes(other.fileVotes)
+    fileVotes(other.fileVotes),
+    hash(other.hash)
 {}
 
 bool CGovernanceObject::ProcessVote(CNode* pfrom,
@@ -147,8 +156,11 @@ bool CGovernanceObject::ProcessVote(CNode* pfrom,
         exception = CGovernanceException(ostr.str(), GOVERNANCE_EXCEPTION_PERMANENT_ERROR, 20);
         return false;
     }
-    vote_instance_m_it it2 = voteRecordRef.mapInstances.emplace(vote_instance_m_t::value_type(int(eSignal), vote_instance_t())).first;
-    vote_instance_t& voteInstanceRef = it2->second;
+    std::pair<vote_instance_m_it, bool> ret2 = voteRecordRef.mapInstances.emplace(vote_instance_m_t::value_type(int(eSignal), vote_instance_t()));
+    vote_instance_t& voteInstanceRef = ret2.first->second;
+    if(ret2.second) {
+        ++mapVoteCounts[std::make_pair(int(eSignal), int(voteInstanceRef.eOutcome))];
+    }
 
     // Reject obsolete votes
     if(vote.GetTimestamp() < voteInstanceRef.nCreationTime) {
@@ -199,7 +211,9 @@ bool CGovernanceObject::ProcessVote(CNode* pfrom,
         return false;
     }
 
+    --mapVoteCounts[std::make_pair(int(eSignal), int(voteInstanceRef.eOutcome))];
     voteInstanceRef = vote_instance_t(vote.GetOutcome(), nVoteTimeUpdate, vote.GetTimestamp());
+    ++mapVoteCounts[std::make_pair(int(eSignal), int(voteInstanceRef.eOutcome))];
     fileVotes.AddVote(vote);
     fDirtyCache = true;
     return true;
@@ -213,6 +227,9 @@ void CGovernanceObject::ClearMasternodeVotes()
     while(it != mapCurrentMNVotes.end()) {
         if(!mnodeman.Has(it->first)) {
             fileVotes.RemoveVotesFromMasternode(it->first);
+            for (const auto& instancepair : it->second.mapInstances) {
+                --mapVoteCounts[std::make_pair(instancepair.first, int(instancepair.second.eOutcome))];
+            }
             mapCurrentMNVotes.erase(it++);
         }
         else {
@@ -234,7 +251,24 @@ std::string CGovernanceObject::GetSignatureMessage() const
     return strMessage;
 }
 
+void CGovernanceObject::RebuildVoteCounts()
+{
+    LOCK(cs);
+
+    mapVoteCounts.clear();
+    for (const auto& votepair : mapCurrentMNVotes) {
+        for (const auto& instancepair : votepair.second.mapInstances) {
+            ++mapVoteCounts[std::make_pair(instancepair.first, int(instancepair.second.eOutcome))];
+        }
+    }
+}
+
 uint256 CGovernanceObject::GetHash() const
+{
+    return hash;
+}
+
+void CGovernanceObject::UpdateHash()
 {
     // Note: doesn't match serialization
 
@@ -249,9 +283,9 @@ uint256 CGovernanceObject::GetHash() const
     ss << vchSig;
     // fee_tx is left out on purpose
 
-    DBG( printf("CGovernanceObject::GetHash %i %li %s\n", nRevision, nTime, GetDataAsHexString().c_str()); );
+    DBG( printf("CGovernanceObject::UpdateHash %i %li %s\n", nRevision, nTime, GetDataAsHexString().c_str()); );
 
-    return ss.GetHash();
+    hash = ss.GetHash();
 }
 
 uint256 CGovernanceObject::GetSignatureHash() const
@@ -262,6 +296,7 @@ uint256 CGovernanceObject::GetSignatureHash() const
 void CGovernanceObject::SetMasternodeOutpoint(const COutPoint& outpoint)
 {
     masternodeOutpoint = outpoint;
+    UpdateHash();
 }
 
 bool CGovernanceObject::Sign(const CKey& keyMasternode, const CPubKey& pubKeyMasternode)
@@ -269,20 +304,24 @@ bool CGovernanceObject::Sign(const CKey& keyMasternode, const CPubKey& pubKeyMas
     std::string strError;
 
     if (sporkManager.IsSporkActive(SPORK_6_NEW_SIGS)) {
-        uint256 hash = GetSignatureHash();
+        uint256 hashSig = GetSignatureHash();
 
-        if (!CHashSigner::SignHash(hash, keyMasternode, vchSig)) {
+        bool fSigned = CHashSigner::SignHash(hashSig, keyMasternode, vchSig);
+        UpdateHash();
+        if (!fSigned) {
             LogPrintf("CGovernanceObject::Sign -- SignHash() failed\n");
             return false;
         }
 
-        if (!CHashSigner::VerifyHash(hash, pubKeyMasternode, vchSig, strError)) {
+        if (!CHashSigner::VerifyHash(hashSig, pubKeyMasternode, vchSig, strError)) {
             LogPrintf("CGovernanceObject::Sign -- VerifyHash() failed, error: %s\n", strError);
             return false;
         }
     } else {
         std::string strMessage = GetSignatureMessage();
-        if (!CMessageSigner::SignMessage(strMessage, vchSig, keyMasternode)) {
+        bool fSigned = CMessageSigner::SignMessage(strMessage, vchSig, keyMasternode);
+        UpdateHash();
+        if (!fSigned) {
             LogPrintf("CGovernanceObject::Sign -- SignMessage() failed\n");
             return false;
         }
@@ -636,15 +675,8 @@ int CGovernanceObject::CountMatchingVotes(vote_signal_enum_t eVoteSignalIn, vote
 {
     LOCK(cs);
 
-    int nCount = 0;
-    for (const auto& votepair : mapCurrentMNVotes) {
-        const vote_rec_t& recVote = votepair.second;
-        vote_instance_m_cit it2 = recVote.mapInstances.find(eVoteSignalIn);
-        if(it2 != recVote.mapInstances.end() && it2->second.eOutcome == eVoteOutcomeIn) {
-            ++nCount;
-        }
-    }
-    return nCount;
+    std::map<std::pair<int, int>, int>::const_iterator it = mapVoteCounts.find(std::make_pair(int(eVoteSignalIn), int(eVoteOutcomeIn)));
+    return it == mapVoteCounts.end() ? 0 : it->second;
 }
 
 /**
@@ -756,12 +788,31 @@ void CGovernanceObject::swap(CGovernanceObject& first, CGovernanceObject& second
     swap(first.fCachedEndorsed, second.fCachedEndorsed);
     swap(first.fDirtyCache, second.fDirtyCache);
     swap(first.fExpired, second.fExpired);
+
+    // the hashed fields are not all swapped, so recalculate the hashes
+    first.UpdateHash();
+    second.UpdateHash();
 }
 
 void CGovernanceObject::CheckOrphanVotes(CConnman& connman)
 {
     int64_t nNow = GetAdjustedTime();
     const vote_cmm_t::list_t& listVotes = cmmapOrphanVotes.GetItemList();
+
+    // Check the signatures of all orphan votes at once, processing them below
+    // finds the valid ones in the message signature cache
+    if(sporkManager.IsSporkActive(SPORK_6_NEW_SIGS)) {
+        std::vector<CHashSignatureCheck> vChecks;
+        for (const auto& item : listVotes) {
+            const CGovernanceVote& vote = item.value.first;
+            masternode_info_t infoMn;
+            if(mnodeman.GetMasternodeInfo(vote.GetMasternodeOutpoint(), infoMn)) {
+                vChecks.push_back(CHashSignatureCheck(vote.GetSignatureHash(), infoMn.pubKeyMasternode.GetID(), vote.GetSignature()));
+            }
+        }
+        CHashSigner::VerifyHashes(vChecks);
+    }
+
     vote_cmm_t::list_cit it = listVotes.begin();
     while(it != listVotes.end()) {
         bool fRemove = false;
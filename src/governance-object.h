@@ -112,6 +112,7 @@ class CGovernanceObject
     friend class CGovernanceManager;
     friend class CGovernanceTriggerManager;
     friend class CSuperblock;
+    friend struct GovernanceVoteTestingSetup;
 
 public: // Types
     typedef std::map<COutPoint, vote_rec_t> vote_m_t;
@@ -182,11 +183,18 @@ private:
 
     vote_m_t mapCurrentMNVotes;
 
+    /// Memory only. Number of vote instances in mapCurrentMNVotes per (signal, outcome)
+    std::map<std::pair<int, int>, int> mapVoteCounts;
+
     /// Limited map of votes orphaned by MN
     vote_cmm_t cmmapOrphanVotes;
 
     CGovernanceObjectVoteFile fileVotes;
 
+    /** Memory only. */
+    uint256 hash;
+    void UpdateHash();
+
 public:
     CGovernanceObject();
 
@@ -342,6 +350,8 @@ public:
         if (!(s.GetType() & SER_GETHASH)) {
             READWRITE(vchSig);
         }
+        if (ser_action.ForRead())
+            UpdateHash();
         if(s.GetType() & SER_DISK) {
             // Only include these for the disk file format
             LogPrint("gobject", "CGovernanceObject::SerializationOp Reading/writing votes from/to disk\n");
@@ -349,6 +359,8 @@ public:
             READWRITE(fExpired);
             READWRITE(mapCurrentMNVotes);
             READWRITE(fileVotes);
+            if (ser_action.ForRead())
+                RebuildVoteCounts();
             LogPrint("gobject", "CGovernanceObject::SerializationOp hash = %s, vote count = %d\n", GetHash().ToString(), fileVotes.GetVoteCount());
         }
 
@@ -374,6 +386,8 @@ private:
     /// Called when MN's which have voted on this object have been removed
     void ClearMasternodeVotes();
 
+    void RebuildVoteCounts();
+
     void CheckOrphanVotes(CConnman& connman);
 
 };
@@ -91,6 +91,7 @@ public:
     void SetTime(int64_t nTimeIn) { nTime = nTimeIn; UpdateHash(); }
 
     void SetSignature(const std::vector<unsigned char>& vchSigIn) { vchSig = vchSigIn; }
+    const std::vector<unsigned char>& GetSignature() const { return vchSig; }
 
     bool Sign(const CKey& keyMasternode, const CPubKey& pubKeyMasternode);
     bool CheckSignature(const CPubKey& pubKeyMasternode) const;
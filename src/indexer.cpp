@@ -0,0 +1,427 @@
+// Copyright (c) 2018 The SecureTag Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "indexer.h"
+
+#include "chainparams.h"
+#include "hash.h"
+#include "primitives/block.h"
+#include "txdb.h"
+#include "undo.h"
+#include "util.h"
+#include "validation.h"
+
+#include <memory>
+#include <vector>
+
+/** Number of blocks between progress messages while catching up */
+static const int INDEXER_LOG_INTERVAL = 10000;
+
+CBaseIndexer::CBaseIndexer(const std::string& strNameIn) :
+    strName(strNameIn),
+    pindexBest(NULL),
+    nBestHeight(-1),
+    fSynced(false),
+    fFailed(false),
+    fTipChanged(false)
+{
+}
+
+void CBaseIndexer::UpgradeLegacyIndex(const std::string& strName)
+{
+    LOCK(cs_main);
+
+    bool fLegacy = false;
+    uint256 hashBest;
+    if (!pblocktree->ReadFlag(strName, fLegacy) || !fLegacy || pblocktree->ReadIndexBestBlock(strName, hashBest))
+        return;
+
+    CBlockIndex* pindexTip = chainActive.Tip();
+    LogPrintf("%s: %s was written up to block %s\n", __func__, strName, pindexTip ? pindexTip->GetBlockHash().ToString() : "none");
+    pblocktree->WriteIndexBestBlock(strName, pindexTip ? pindexTip->GetBlockHash() : uint256());
+    pblocktree->WriteFlag(strName, false);
+}
+
+bool CBaseIndexer::Init()
+{
+    LOCK(cs_main);
+
+    uint256 hashBest;
+    if (!pblocktree->ReadIndexBestBlock(strName, hashBest) || hashBest.IsNull()) {
+        LogPrintf("%s: building %s from the start\n", __func__, strName);
+        pindexBest = NULL;
+        return true;
+    }
+
+    BlockMap::iterator mi = mapBlockIndex.find(hashBest);
+    if (mi == mapBlockIndex.end())
+        return error("%s: last block of %s %s not found", __func__, strName, hashBest.ToString());
+    pindexBest = mi->second;
+    nBestHeight = pindexBest->nHeight;
+    LogPrintf("%s: %s continues after block %s (height %d)\n", __func__, strName, hashBest.ToString(), pindexBest->nHeight);
+    return true;
+}
+
+void CBaseIndexer::Fail(const std::string& strError)
+{
+    {
+        boost::unique_lock<boost::mutex> lock(mutexBest);
+        fFailed = true;
+    }
+    condBestChanged.notify_all();
+    error("%s: %s, stopping", strName, strError);
+}
+
+bool CBaseIndexer::IsReady(std::string& strError) const
+{
+    if (fFailed) {
+        strError = strprintf("%s failed at height %d, see debug.log", strName, (int)nBestHeight);
+        return false;
+    }
+    if (!fSynced) {
+        strError = strprintf("%s is still syncing (height %d)", strName, (int)nBestHeight);
+        return false;
+    }
+    return true;
+}
+
+bool CBaseIndexer::BlockUntilSyncedToCurrentChain(int64_t nTimeout, std::string& strError)
+{
+    if (!IsReady(strError))
+        return false;
+
+    const CBlockIndex* pindexTip;
+    {
+        LOCK(cs_main);
+        pindexTip = chainActive.Tip();
+    }
+    if (!pindexTip)
+        return true;
+
+    // The tip may have moved on since, having indexed a later block of the
+    // active chain is enough. A block that was disconnected since is not.
+    boost::unique_lock<boost::mutex> lock(mutexBest);
+    auto includesTip = [&]() {
+        if (!pindexBest || pindexBest->GetAncestor(pindexTip->nHeight) != pindexTip)
+            return false;
+        LOCK(cs_main);
+        return chainActive.Contains(pindexBest);
+    };
+    boost::system_time deadline = boost::get_system_time() + boost::posix_time::milliseconds(nTimeout);
+    while (!fFailed && !includesTip()) {
+        if (!condBestChanged.timed_wait(lock, deadline))
+            break;
+    }
+    if (fFailed) {
+        strError = strprintf("%s failed at height %d, see debug.log", strName, (int)nBestHeight);
+        return false;
+    }
+    if (!includesTip()) {
+        strError = strprintf("%s has not reached the tip yet (height %d of %d)", strName, (int)nBestHeight, pindexTip->nHeight);
+        return false;
+    }
+    return true;
+}
+
+void CBaseIndexer::UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload)
+{
+    {
+        boost::unique_lock<boost::mutex> lock(mutexTipChanged);
+        fTipChanged = true;
+    }
+    condTipChanged.notify_one();
+}
+
+void CBaseIndexer::ThreadSync()
+{
+    RenameThread(("securetag-" + strName).c_str());
+
+    if (!Prepare()) {
+        Fail("failed to prepare");
+        return;
+    }
+
+    const Consensus::Params& consensusParams = Params().GetConsensus();
+
+    while (true) {
+        boost::this_thread::interruption_point();
+
+        // Rewind blocks that were disconnected first, then index the next block of the active chain
+        const CBlockIndex* pindex;
+        bool fRewind;
+        CDiskBlockPos posUndo;
+        {
+            LOCK(cs_main);
+            fRewind = pindexBest && !chainActive.Contains(pindexBest);
+            pindex = fRewind ? pindexBest : (pindexBest ? chainActive.Next(pindexBest) : chainActive.Genesis());
+            if (pindex)
+                posUndo = pindex->GetUndoPos();
+        }
+
+        if (!pindex) {
+            if (!fSynced) {
+                LogPrintf("%s: %s is synced at height %d\n", __func__, strName, (int)nBestHeight);
+                fSynced = true;
+            }
+            boost::unique_lock<boost::mutex> lock(mutexTipChanged);
+            while (!fTipChanged)
+                condTipChanged.wait(lock);
+            fTipChanged = false;
+            continue;
+        }
+
+        // The outputs of the genesis block can't be spent and were never indexed
+        const bool fGenesis = !pindex->pprev;
+
+        CBlock block;
+        CBlockUndo blockundo;
+        if (NeedsBlockData() && !fGenesis) {
+            if (!ReadBlockFromDisk(block, pindex, consensusParams)) {
+                Fail(strprintf("can't read block %s", pindex->GetBlockHash().ToString()));
+                return;
+            }
+            if (!UndoReadFromDisk(blockundo, posUndo, pindex->pprev->GetBlockHash())) {
+                Fail(strprintf("can't read undo data of block %s", pindex->GetBlockHash().ToString()));
+                return;
+            }
+            if (blockundo.vtxundo.size() + 1 != block.vtx.size()) {
+                Fail(strprintf("found inconsistent block and undo data for block %s", pindex->GetBlockHash().ToString()));
+                return;
+            }
+        }
+
+        const CBlockIndex* pindexNewBest;
+        if (fRewind) {
+            if (!fGenesis && !RewindBlock(block, blockundo, pindex)) {
+                Fail(strprintf("failed to rewind block %s", pindex->GetBlockHash().ToString()));
+                return;
+            }
+            pindexNewBest = pindex->pprev;
+        } else {
+            if (!fGenesis && !WriteBlock(block, blockundo, pindex)) {
+                Fail(strprintf("failed to write block %s", pindex->GetBlockHash().ToString()));
+                return;
+            }
+            pindexNewBest = pindex;
+        }
+
+        // The index writes can be repeated safely, so progress is only stored after them
+        if (!pblocktree->WriteIndexBestBlock(strName, pindexNewBest ? pindexNewBest->GetBlockHash() : uint256())) {
+            Fail("failed to store its progress");
+            return;
+        }
+        {
+            boost::unique_lock<boost::mutex> lock(mutexBest);
+            pindexBest = pindexNewBest;
+            nBestHeight = pindexBest ? pindexBest->nHeight : -1;
+        }
+        condBestChanged.notify_all();
+
+        if (!fSynced && nBestHeight % INDEXER_LOG_INTERVAL == 0)
+            LogPrintf("%s: %s is at height %d\n", __func__, strName, (int)nBestHeight);
+    }
+}
+
+/** Get the address type and hash of an output script, 0 if it has none */
+static int GetAddressType(const CScript& script, uint160& hashBytes)
+{
+    if (script.IsPayToScriptHash()) {
+        hashBytes = uint160(std::vector<unsigned char>(script.begin()+2, script.begin()+22));
+        return 2;
+    } else if (script.IsPayToPublicKeyHash()) {
+        hashBytes = uint160(std::vector<unsigned char>(script.begin()+3, script.begin()+23));
+        return 1;
+    } else if (script.IsPayToPublicKey()) {
+        hashBytes = Hash160(script.begin()+1, script.end()-1);
+        return 1;
+    }
+    hashBytes.SetNull();
+    return 0;
+}
+
+/**
+ * Collect the address index entries of a block. When rewinding, the entries
+ * are collected in reverse order, the unspent outputs created by the block are
+ * removed and the ones it spent are restored.
+ */
+static void GetAddressIndexEntries(const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex, bool fRewind,
+                                   std::vector<std::pair<CAddressIndexKey, CAmount> >& addressIndex,
+                                   std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >& addressUnspentIndex)
+{
+    for (size_t n = 0; n < block.vtx.size(); n++) {
+        const size_t i = fRewind ? block.vtx.size() - 1 - n : n;
+        const CTransaction& tx = *block.vtx[i];
+        const uint256& txhash = tx.GetHash();
+
+        if (fRewind) {
+            for (unsigned int k = tx.vout.size(); k-- > 0;) {
+                const CTxOut& out = tx.vout[k];
+                uint160 hashBytes;
+                int nType = GetAddressType(out.scriptPubKey, hashBytes);
+                if (nType == 0)
+                    continue;
+
+                addressIndex.push_back(std::make_pair(CAddressIndexKey(nType, hashBytes, pindex->nHeight, i, txhash, k, false), out.nValue));
+                addressUnspentIndex.push_back(std::make_pair(CAddressUnspentKey(nType, hashBytes, txhash, k), CAddressUnspentValue()));
+            }
+        }
+
+        if (i > 0) {
+            const CTxUndo& txundo = blockundo.vtxundo[i-1];
+            for (size_t j = 0; j < tx.vin.size() && j < txundo.vprevout.size(); j++) {
+                const COutPoint& prevout = tx.vin[j].prevout;
+                const Coin& coin = txundo.vprevout[j];
+                uint160 hashBytes;
+                int nType = GetAddressType(coin.out.scriptPubKey, hashBytes);
+                if (nType == 0)
+                    continue;
+
+                addressIndex.push_back(std::make_pair(CAddressIndexKey(nType, hashBytes, pindex->nHeight, i, txhash, j, true), coin.out.nValue * -1));
+                addressUnspentIndex.push_back(std::make_pair(CAddressUnspentKey(nType, hashBytes, prevout.hash, prevout.n),
+                                                             fRewind ? CAddressUnspentValue(coin.out.nValue, coin.out.scriptPubKey, coin.nHeight) : CAddressUnspentValue()));
+            }
+        }
+
+        if (!fRewind) {
+            for (unsigned int k = 0; k < tx.vout.size(); k++) {
+                const CTxOut& out = tx.vout[k];
+                uint160 hashBytes;
+                int nType = GetAddressType(out.scriptPubKey, hashBytes);
+                if (nType == 0)
+                    continue;
+
+                addressIndex.push_back(std::make_pair(CAddressIndexKey(nType, hashBytes, pindex->nHeight, i, txhash, k, false), out.nValue));
+                addressUnspentIndex.push_back(std::make_pair(CAddressUnspentKey(nType, hashBytes, txhash, k), CAddressUnspentValue(out.nValue, out.scriptPubKey, pindex->nHeight)));
+            }
+        }
+    }
+}
+
+bool CAddressIndexer::Prepare()
+{
+    // Indexes written before the balances were kept need them summed up once
+    bool fBuilt = false;
+    if (pblocktree->ReadFlag("addressbalanceindex", fBuilt) && fBuilt)
+        return true;
+
+    LogPrintf("%s: building address balances, this may take a while\n", __func__);
+    if (!pblocktree->BuildAddressBalanceIndex())
+        return false;
+    LogPrintf("%s: address balances done\n", __func__);
+    return true;
+}
+
+bool CAddressIndexer::WriteBlock(const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex)
+{
+    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
+    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > addressUnspentIndex;
+    GetAddressIndexEntries(block, blockundo, pindex, false, addressIndex, addressUnspentIndex);
+
+    return pblocktree->WriteAddressIndex(addressIndex) && pblocktree->UpdateAddressUnspentIndex(addressUnspentIndex);
+}
+
+bool CAddressIndexer::RewindBlock(const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex)
+{
+    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
+    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > addressUnspentIndex;
+    GetAddressIndexEntries(block, blockundo, pindex, true, addressIndex, addressUnspentIndex);
+
+    return pblocktree->EraseAddressIndex(addressIndex) && pblocktree->UpdateAddressUnspentIndex(addressUnspentIndex);
+}
+
+/** Collect the spent index entries of a block, null values remove them */
+static void GetSpentIndexEntries(const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex, bool fRewind,
+                                 std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> >& spentIndex)
+{
+    for (size_t i = 1; i < block.vtx.size(); i++) {
+        const CTransaction& tx = *block.vtx[i];
+        const CTxUndo& txundo = blockundo.vtxundo[i-1];
+        for (size_t j = 0; j < tx.vin.size() && j < txundo.vprevout.size(); j++) {
+            const COutPoint& prevout = tx.vin[j].prevout;
+            if (fRewind) {
+                spentIndex.push_back(std::make_pair(CSpentIndexKey(prevout.hash, prevout.n), CSpentIndexValue()));
+            } else {
+                const CTxOut& out = txundo.vprevout[j].out;
+                uint160 hashBytes;
+                int nType = GetAddressType(out.scriptPubKey, hashBytes);
+                spentIndex.push_back(std::make_pair(CSpentIndexKey(prevout.hash, prevout.n), CSpentIndexValue(tx.GetHash(), j, pindex->nHeight, out.nValue, nType, hashBytes)));
+            }
+        }
+    }
+}
+
+bool CSpentIndexer::WriteBlock(const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex)
+{
+    std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> > spentIndex;
+    GetSpentIndexEntries(block, blockundo, pindex, false, spentIndex);
+    return pblocktree->UpdateSpentIndex(spentIndex);
+}
+
+bool CSpentIndexer::RewindBlock(const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex)
+{
+    std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> > spentIndex;
+    GetSpentIndexEntries(block, blockundo, pindex, true, spentIndex);
+    return pblocktree->UpdateSpentIndex(spentIndex);
+}
+
+bool CTimestampIndexer::WriteBlock(const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex)
+{
+    return pblocktree->WriteTimestampIndex(CTimestampIndexKey(pindex->nTime, pindex->GetBlockHash()));
+}
+
+bool CTimestampIndexer::RewindBlock(const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex)
+{
+    return pblocktree->EraseTimestampIndex(CTimestampIndexKey(pindex->nTime, pindex->GetBlockHash()));
+}
+
+static std::vector<std::unique_ptr<CBaseIndexer> > vIndexers;
+
+bool StartIndexers(boost::thread_group& threadGroup)
+{
+    CBaseIndexer::UpgradeLegacyIndex("addressindex");
+    CBaseIndexer::UpgradeLegacyIndex("spentindex");
+    CBaseIndexer::UpgradeLegacyIndex("timestampindex");
+
+    if (fAddressIndex)
+        vIndexers.emplace_back(new CAddressIndexer());
+    if (fSpentIndex)
+        vIndexers.emplace_back(new CSpentIndexer());
+    if (fTimestampIndex)
+        vIndexers.emplace_back(new CTimestampIndexer());
+
+    for (const auto& pindexer : vIndexers) {
+        if (!pindexer->Init())
+            return false;
+        RegisterValidationInterface(pindexer.get());
+        threadGroup.create_thread(boost::bind(&CBaseIndexer::ThreadSync, pindexer.get()));
+    }
+    return true;
+}
+
+void StopIndexers()
+{
+    for (const auto& pindexer : vIndexers)
+        UnregisterValidationInterface(pindexer.get());
+    vIndexers.clear();
+}
+
+bool IsIndexReady(const std::string& strName, std::string& strError)
+{
+    for (const auto& pindexer : vIndexers) {
+        if (pindexer->GetName() == strName)
+            return pindexer->IsReady(strError);
+    }
+    strError = strprintf("%s is not enabled", strName);
+    return false;
+}
+
+bool BlockUntilIndexSynced(const std::string& strName, std::string& strError)
+{
+    for (const auto& pindexer : vIndexers) {
+        if (pindexer->GetName() == strName)
+            return pindexer->BlockUntilSyncedToCurrentChain(INDEX_SYNC_TIMEOUT, strError);
+    }
+    strError = strprintf("%s is not enabled", strName);
+    return false;
+}
@@ -0,0 +1,151 @@
+// Copyright (c) 2018 The SecureTag Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef INDEXER_H
+#define INDEXER_H
+
+#include "validationinterface.h"
+
+#include <atomic>
+#include <string>
+
+#include <boost/thread.hpp>
+
+class CBlock;
+class CBlockIndex;
+class CBlockUndo;
+
+/**
+ * Base class for the optional indexes (-addressindex, -spentindex and
+ * -timestampindex). They are not written while connecting blocks but built
+ * from the block and undo files by a background thread, which catches up with
+ * the active chain and then follows it. The last indexed block is stored in
+ * the block tree database after every block, so an index resumes where it was
+ * left and can be enabled at any time without -reindex.
+ */
+class CBaseIndexer : public CValidationInterface
+{
+private:
+    /** Name of the index, also the key of its progress in the database */
+    const std::string strName;
+
+    /** Last block that was indexed, written by the indexer thread under mutexBest */
+    const CBlockIndex* pindexBest;
+    boost::mutex mutexBest;
+    boost::condition_variable condBestChanged;
+
+    /** Height of pindexBest, -1 if none, readable from other threads */
+    std::atomic<int> nBestHeight;
+    /** Whether the index caught up with the active chain */
+    std::atomic<bool> fSynced;
+    /** Whether the indexer thread stopped on an error */
+    std::atomic<bool> fFailed;
+
+    boost::mutex mutexTipChanged;
+    boost::condition_variable condTipChanged;
+    bool fTipChanged;
+
+protected:
+    /** Called by the indexer thread before it starts following the chain */
+    virtual bool Prepare() { return true; }
+
+    /** Whether WriteBlock/RewindBlock need the block and undo data */
+    virtual bool NeedsBlockData() const { return true; }
+
+    /** Add the entries of a block that was connected to the index */
+    virtual bool WriteBlock(const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex) = 0;
+
+    /** Remove the entries of a block that is no longer in the active chain */
+    virtual bool RewindBlock(const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex) = 0;
+
+    /** Log an error and mark the index failed, the thread stops after it */
+    void Fail(const std::string& strError);
+
+    // CValidationInterface
+    void UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload) override;
+
+public:
+    CBaseIndexer(const std::string& strNameIn);
+    virtual ~CBaseIndexer() {}
+
+    /** Load the progress of the index */
+    bool Init();
+
+    /** Keep the index in sync with the active chain until interrupted */
+    void ThreadSync();
+
+    const std::string& GetName() const { return strName; }
+
+    /** Height of the last block that was indexed, -1 if none */
+    int GetBestHeight() const { return nBestHeight; }
+
+    /** Whether the index can be queried, otherwise why it can't */
+    bool IsReady(std::string& strError) const;
+
+    /**
+     * Wait up to nTimeout milliseconds until the index includes the current
+     * tip, so it answers like an index written while connecting blocks.
+     * Fails at once if the index is still catching up or failed.
+     */
+    bool BlockUntilSyncedToCurrentChain(int64_t nTimeout, std::string& strError);
+
+    /**
+     * Indexes used to be written while connecting blocks and only marked with a
+     * flag, make such an index continue from the current tip.
+     */
+    static void UpgradeLegacyIndex(const std::string& strName);
+};
+
+class CAddressIndexer : public CBaseIndexer
+{
+protected:
+    bool Prepare() override;
+    bool WriteBlock(const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex) override;
+    bool RewindBlock(const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex) override;
+
+public:
+    CAddressIndexer() : CBaseIndexer("addressindex") {}
+};
+
+class CSpentIndexer : public CBaseIndexer
+{
+protected:
+    bool WriteBlock(const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex) override;
+    bool RewindBlock(const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex) override;
+
+public:
+    CSpentIndexer() : CBaseIndexer("spentindex") {}
+};
+
+class CTimestampIndexer : public CBaseIndexer
+{
+protected:
+    bool NeedsBlockData() const override { return false; }
+    bool WriteBlock(const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex) override;
+    bool RewindBlock(const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex) override;
+
+public:
+    CTimestampIndexer() : CBaseIndexer("timestampindex") {}
+};
+
+/** Milliseconds an RPC waits for an index to include the current tip */
+static const int64_t INDEX_SYNC_TIMEOUT = 30 * 1000;
+
+/** Start the indexers of the enabled indexes */
+bool StartIndexers(boost::thread_group& threadGroup);
+/** Delete the indexers, their threads must have been stopped */
+void StopIndexers();
+/**
+ * Whether the index with the given name caught up with the active chain and
+ * can be queried, otherwise strError tells whether it is still syncing or
+ * failed.
+ */
+bool IsIndexReady(const std::string& strName, std::string& strError);
+/**
+ * Like IsIndexReady, but also wait for the index to include the current tip,
+ * see CBaseIndexer::BlockUntilSyncedToCurrentChain.
+ */
+bool BlockUntilIndexSynced(const std::string& strName, std::string& strError);
+
+#endif // INDEXER_H
@@ -18,8 +18,10 @@
 #include "checkpoints.h"
 #include "compat/sanity.h"
 #include "consensus/validation.h"
+#include "crypto/neoscrypt.h"
 #include "httpserver.h"
 #include "httprpc.h"
+#include "indexer.h"
 #include "key.h"
 #include "validation.h"
 #include "miner.h"
@@ -101,6 +103,7 @@ static const bool DEFAULT_PROXYRANDOMIZE = true;
 static const bool DEFAULT_REST_ENABLE = false;
 static const bool DEFAULT_DISABLE_SAFEMODE = false;
 static const bool DEFAULT_STOPAFTERBLOCKIMPORT = false;
+static const int64_t DUMP_DATA_CACHES_INTERVAL = 15 * 60;
 
 
 std::unique_ptr<CConnman> g_connman;
@@ -218,6 +221,43 @@ void Interrupt(boost::thread_group& threadGroup)
     threadGroup.interrupt_all();
 }
 
+/** Store the SecureTag data caches into their serialized dat files */
+static void DumpDataCaches()
+{
+    CFlatDB<CMasternodeMan> flatdb1("mncache.dat", "magicMasternodeCache");
+    flatdb1.Dump(mnodeman);
+    CFlatDB<CFundamentalnodeMan> flatdb2("fncache.dat", "magicFundamentalnodeCache");
+    flatdb2.Dump(fnodeman);
+    CFlatDB<CMasternodePayments> flatdb3("mnpayments.dat", "magicMasternodePaymentsCache");
+    flatdb3.Dump(mnpayments);
+    CFlatDB<CFundamentalnodePayments> flatdb4("fnpayments.dat", "magicFundamentalnodePaymentsCache");
+    flatdb4.Dump(fnpayments);
+    CFlatDB<CGovernanceManager> flatdb5("governance.dat", "magicGovernanceCache");
+    flatdb5.Dump(governance);
+    CFlatDB<CNetFulfilledRequestManager> flatdb6("netfulfilled.dat", "magicFulfilledCache");
+    flatdb6.Dump(netfulfilledman);
+}
+
+/** Store the data caches regularly. This runs on its own thread, as the
+ *  serialization takes a while and would hold up the scheduler thread, which
+ *  delivers the background validation notifications. */
+static void ThreadDumpDataCaches()
+{
+    while (true) {
+        MilliSleep(DUMP_DATA_CACHES_INTERVAL * 1000);
+        DumpDataCaches();
+    }
+}
+
+/** Load a data cache from its dat file, without cleaning it up yet */
+template<typename T>
+static void ThreadLoadDataCache(const std::string& strDBName, const std::string& strMagicMessage, T& objToLoad, bool& fLoaded)
+{
+    RenameThread("securetag-loadcache");
+    CFlatDB<T> flatdb(strDBName, strMagicMessage);
+    fLoaded = flatdb.Load(objToLoad, false);
+}
+
 /** Preparing steps before shutting down or restarting the wallet */
 void PrepareShutdown()
 {
@@ -242,24 +282,18 @@ void PrepareShutdown()
         pwalletMain->Flush(false);
 #endif
     MapPort(false);
+    // Deliver the queued background notifications while the connection manager they use is still there
     UnregisterValidationInterface(peerLogic.get());
+    if (pdsNotificationInterface)
+        UnregisterValidationInterface(pdsNotificationInterface);
+    FlushBackgroundCallbacks();
     peerLogic.reset();
     g_connman.reset();
+    StopIndexers();
 
     // STORE DATA CACHES INTO SERIALIZED DAT FILES
     if (!fLiteMode) {
-        CFlatDB<CMasternodeMan> flatdb1("mncache.dat", "magicMasternodeCache");
-        flatdb1.Dump(mnodeman);
-        CFlatDB<CFundamentalnodeMan> flatdb2("fncache.dat", "magicFundamentalnodeCache");
-        flatdb2.Dump(fnodeman);
-        CFlatDB<CMasternodePayments> flatdb3("mnpayments.dat", "magicMasternodePaymentsCache");
-        flatdb3.Dump(mnpayments);
-        CFlatDB<CFundamentalnodePayments> flatdb4("fnpayments.dat", "magicFundamentalnodePaymentsCache");
-        flatdb4.Dump(fnpayments);
-        CFlatDB<CGovernanceManager> flatdb5("governance.dat", "magicGovernanceCache");
-        flatdb5.Dump(governance);
-        CFlatDB<CNetFulfilledRequestManager> flatdb6("netfulfilled.dat", "magicFulfilledCache");
-        flatdb6.Dump(netfulfilledman);
+        DumpDataCaches();
     }
 
     UnregisterNodeSignals(GetNodeSignals());
@@ -299,13 +333,13 @@ void PrepareShutdown()
 #if ENABLE_ZMQ
     if (pzmqNotificationInterface) {
         UnregisterValidationInterface(pzmqNotificationInterface);
+        FlushBackgroundCallbacks();
         delete pzmqNotificationInterface;
         pzmqNotificationInterface = NULL;
     }
 #endif
 
     if (pdsNotificationInterface) {
-        UnregisterValidationInterface(pdsNotificationInterface);
         delete pdsNotificationInterface;
         pdsNotificationInterface = NULL;
     }
@@ -317,7 +351,9 @@ void PrepareShutdown()
         LogPrintf("%s: Unable to remove pidfile: %s\n", __func__, e.what());
     }
 #endif
+    FlushBackgroundCallbacks();
     UnregisterAllValidationInterfaces();
+    UnregisterBackgroundSignalScheduler();
 }
 
 /**
@@ -458,6 +494,7 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-maxreceivebuffer=<n>", strprintf(_("Maximum per-connection receive buffer, <n>*1000 bytes (default: %u)"), DEFAULT_MAXRECEIVEBUFFER));
     strUsage += HelpMessageOpt("-maxsendbuffer=<n>", strprintf(_("Maximum per-connection send buffer, <n>*1000 bytes (default: %u)"), DEFAULT_MAXSENDBUFFER));
     strUsage += HelpMessageOpt("-maxtimeadjustment", strprintf(_("Maximum allowed median peer time offset adjustment. Local perspective of time may be influenced by peers forward or backward by this amount. (default: %u seconds)"), DEFAULT_MAX_TIME_ADJUSTMENT));
+    strUsage += HelpMessageOpt("-msghandthreads=<n>", strprintf(_("Number of threads processing peer messages (1-%d, default: %d)"), MAX_MSGHAND_THREADS, DEFAULT_MSGHAND_THREADS));
     strUsage += HelpMessageOpt("-onion=<ip:port>", strprintf(_("Use separate SOCKS5 proxy to reach peers via Tor hidden services (default: %s)"), "-proxy"));
     strUsage += HelpMessageOpt("-onlynet=<net>", _("Only connect to nodes in network <net> (ipv4, ipv6 or onion)"));
     strUsage += HelpMessageOpt("-permitbaremultisig", strprintf(_("Relay non-P2SH multisig (default: %u)"), DEFAULT_PERMIT_BAREMULTISIG));
@@ -938,18 +975,6 @@ void InitParameterInteraction()
         LogPrintf("%s: parameter interaction: can't use -hdseed and -mnemonic/-mnemonicpassphrase together, will prefer -seed\n", __func__);
     }
 #endif // ENABLE_WALLET
-
-    // Make sure additional indexes are recalculated correctly in VerifyDB
-    // (we must reconnect blocks whenever we disconnect them for these indexes to work)
-    bool fAdditionalIndexes =
-        GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX) ||
-        GetBoolArg("-spentindex", DEFAULT_SPENTINDEX) ||
-        GetBoolArg("-timestampindex", DEFAULT_TIMESTAMPINDEX);
-
-    if (fAdditionalIndexes && GetArg("-checklevel", DEFAULT_CHECKLEVEL) < 4) {
-        ForceSetArg("-checklevel", "4");
-        LogPrintf("%s: parameter interaction: additional indexes -> setting -checklevel=4\n", __func__);
-    }
 }
 
 static std::string ResolveErrMsg(const char * const optname, const std::string& strBind)
@@ -1062,6 +1087,9 @@ bool AppInitParameterInteraction()
     if (GetArg("-prune", 0)) {
         if (GetBoolArg("-txindex", DEFAULT_TXINDEX))
             return InitError(_("Prune mode is incompatible with -txindex."));
+        // the indexers build from the block and undo files, which pruning deletes
+        if (GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX) || GetBoolArg("-spentindex", DEFAULT_SPENTINDEX) || GetBoolArg("-timestampindex", DEFAULT_TIMESTAMPINDEX))
+            return InitError(_("Prune mode is incompatible with -addressindex, -spentindex and -timestampindex."));
     }
 
     if (IsArgSet("-devnet")) {
@@ -1078,14 +1106,17 @@ bool AppInitParameterInteraction()
     fAllowPrivateNet = GetBoolArg("-allowprivatenet", DEFAULT_ALLOWPRIVATENET);
 
     // Make sure enough file descriptors are available
-    int nBind = std::max(
-                (mapMultiArgs.count("-bind") ? mapMultiArgs.at("-bind").size() : 0) +
-                (mapMultiArgs.count("-whitebind") ? mapMultiArgs.at("-whitebind").size() : 0), size_t(1));
     nUserMaxConnections = GetArg("-maxconnections", DEFAULT_MAX_PEER_CONNECTIONS);
     nMaxConnections = std::max(nUserMaxConnections, 0);
 
     // Trim requested connection counts, to fit into system limitations
+#ifndef USE_POLL
+    // Only select() is bounded by FD_SETSIZE
+    int nBind = std::max(
+                (mapMultiArgs.count("-bind") ? mapMultiArgs.at("-bind").size() : 0) +
+                (mapMultiArgs.count("-whitebind") ? mapMultiArgs.at("-whitebind").size() : 0), size_t(1));
     nMaxConnections = std::max(std::min(nMaxConnections, (int)(FD_SETSIZE - nBind - MIN_CORE_FILEDESCRIPTORS - MAX_ADDNODE_CONNECTIONS)), 0);
+#endif
     nFD = RaiseFileDescriptorLimit(nMaxConnections + MIN_CORE_FILEDESCRIPTORS + MAX_ADDNODE_CONNECTIONS);
     if (nFD < MIN_CORE_FILEDESCRIPTORS)
         return InitError(_("Not enough file descriptors available."));
@@ -1328,6 +1359,9 @@ bool AppInitSanityChecks()
     ECC_Start();
     globalVerifyHandle.reset(new ECCVerifyHandle());
 
+    // Pick the fastest NeoScrypt engine this CPU supports
+    LogPrintf("Using NeoScrypt engine: %s\n", neoscrypt_engine_name(neoscrypt_engine_init()));
+
     // Sanity check
     if (!InitSanityCheck())
         return InitError(strprintf(_("Initialization sanity check failed. %s is shutting down."), _(PACKAGE_NAME)));
@@ -1368,11 +1402,16 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
     LogPrintf("Using at most %i automatic connections (%i file descriptors available)\n", nMaxConnections, nFD);
 
     InitSignatureCache();
+    InitMessageSignatureCache();
 
-    LogPrintf("Using %u threads for script verification\n", nScriptCheckThreads);
+    LogPrintf("Using %u threads for script verification, header hashing and message signature checks\n", nScriptCheckThreads);
     if (nScriptCheckThreads) {
         for (int i=0; i<nScriptCheckThreads-1; i++)
             threadGroup.create_thread(&ThreadScriptCheck);
+        for (int i=0; i<nScriptCheckThreads-1; i++)
+            threadGroup.create_thread(&ThreadHeaderHash);
+        for (int i=0; i<nScriptCheckThreads-1; i++)
+            threadGroup.create_thread(&ThreadHashSignatureCheck);
     }
 
     if (!sporkManager.SetSporkAddress(GetArg("-sporkaddr", Params().SporkAddress())))
@@ -1388,6 +1427,9 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
     CScheduler::Function serviceLoop = boost::bind(&CScheduler::serviceQueue, &scheduler);
     threadGroup.create_thread(boost::bind(&TraceThread<CScheduler::Function>, "scheduler", serviceLoop));
 
+    // Deliver the notifications of background validation listeners on it
+    RegisterBackgroundSignalScheduler(scheduler);
+
     /* Start the RPC server already.  It will be started in "warmup" mode
      * and not really process calls already (but it will signify connections
      * that the server is there and will be ready later).  Warmup mode will
@@ -1422,7 +1464,8 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
     CConnman& connman = *g_connman;
 
     peerLogic.reset(new PeerLogicValidation(&connman));
-    RegisterValidationInterface(peerLogic.get());
+    // announcing blocks and evicting orphans doesn't need to hold up validation
+    RegisterValidationInterface(peerLogic.get(), true);
     RegisterNodeSignals(GetNodeSignals());
 
     // sanitize comments per BIP-0014, format user agent and check total size
@@ -1562,12 +1605,15 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
     pzmqNotificationInterface = CZMQNotificationInterface::Create();
 
     if (pzmqNotificationInterface) {
-        RegisterValidationInterface(pzmqNotificationInterface);
+        // publishing doesn't need to hold up validation
+        RegisterValidationInterface(pzmqNotificationInterface, true);
     }
 #endif
 
+    // the masternode, payments, governance, InstantSend and PrivateSend managers
+    // follow the tip and transactions with their own locking, so they can lag behind
     pdsNotificationInterface = new CDSNotificationInterface(connman);
-    RegisterValidationInterface(pdsNotificationInterface);
+    RegisterValidationInterface(pdsNotificationInterface, true);
 
     uint64_t nMaxOutboundLimit = 0; //unlimited unless -maxuploadtarget is set
     uint64_t nMaxOutboundTimeframe = MAX_UPLOAD_TIMEFRAME;
@@ -1807,6 +1853,13 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
             vImportFiles.push_back(strFile);
     }
 
+    // Build the optional indexes in the background, continuing where they were left
+    fAddressIndex = GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX);
+    fSpentIndex = GetBoolArg("-spentindex", DEFAULT_SPENTINDEX);
+    fTimestampIndex = GetBoolArg("-timestampindex", DEFAULT_TIMESTAMPINDEX);
+    if (!StartIndexers(threadGroup))
+        return InitError(_("Failed to start the address, spent or timestamp index. You need to rebuild the database using -reindex."));
+
     threadGroup.create_thread(boost::bind(&ThreadImport, vImportFiles));
 
     // Wait for genesis block to be processed
@@ -1945,55 +1998,66 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
 
     if (!fLiteMode) {
         boost::filesystem::path pathDB = GetDataDir();
-        std::string strDBName;
 
-        strDBName = "mncache.dat";
-        uiInterface.InitMessage(_("Loading masternode cache..."));
-        CFlatDB<CMasternodeMan> flatdb1(strDBName, "magicMasternodeCache");
-        if(!flatdb1.Load(mnodeman)) {
-            return InitError(_("Failed to load masternode cache from") + "\n" + (pathDB / strDBName).string());
+        // the caches don't depend on each other, so read them all at once and
+        // leave the cleanup until the chain tip is known (see Step 11c)
+        uiInterface.InitMessage(_("Loading masternode, payment and governance caches..."));
+        bool fMasternodeCacheLoaded = false, fFundamentalnodeCacheLoaded = false;
+        bool fMasternodePaymentsLoaded = false, fFundamentalnodePaymentsLoaded = false;
+        bool fGovernanceLoaded = false, fFulfilledLoaded = false;
+        boost::thread_group loaderGroup;
+        loaderGroup.create_thread(boost::bind(&ThreadLoadDataCache<CMasternodeMan>, "mncache.dat", "magicMasternodeCache",
+                                              boost::ref(mnodeman), boost::ref(fMasternodeCacheLoaded)));
+        loaderGroup.create_thread(boost::bind(&ThreadLoadDataCache<CFundamentalnodeMan>, "fncache.dat", "magicFundamentalnodeCache",
+                                              boost::ref(fnodeman), boost::ref(fFundamentalnodeCacheLoaded)));
+        loaderGroup.create_thread(boost::bind(&ThreadLoadDataCache<CMasternodePayments>, "mnpayments.dat", "magicMasternodePaymentsCache",
+                                              boost::ref(mnpayments), boost::ref(fMasternodePaymentsLoaded)));
+        loaderGroup.create_thread(boost::bind(&ThreadLoadDataCache<CFundamentalnodePayments>, "fnpayments.dat", "magicFundamentalnodePaymentsCache",
+                                              boost::ref(fnpayments), boost::ref(fFundamentalnodePaymentsLoaded)));
+        loaderGroup.create_thread(boost::bind(&ThreadLoadDataCache<CGovernanceManager>, "governance.dat", "magicGovernanceCache",
+                                              boost::ref(governance), boost::ref(fGovernanceLoaded)));
+        loaderGroup.create_thread(boost::bind(&ThreadLoadDataCache<CNetFulfilledRequestManager>, "netfulfilled.dat", "magicFulfilledCache",
+                                              boost::ref(netfulfilledman), boost::ref(fFulfilledLoaded)));
+        loaderGroup.join_all();
+
+        if(!fMasternodeCacheLoaded) {
+            return InitError(_("Failed to load masternode cache from") + "\n" + (pathDB / "mncache.dat").string());
         }
 
-        strDBName = "fncache.dat";
-        CFlatDB<CFundamentalnodeMan> flatdb2(strDBName, "magicFundamentalnodeCache");
-        if(!flatdb2.Load(fnodeman)) {
-            return InitError(_("Failed to load fundamentalnode cache from") + "\n" + (pathDB / strDBName).string());
+        if(!fFundamentalnodeCacheLoaded) {
+            return InitError(_("Failed to load fundamentalnode cache from") + "\n" + (pathDB / "fncache.dat").string());
         }
 
         if(mnodeman.size()) {
-            strDBName = "mnpayments.dat";
-            uiInterface.InitMessage(_("Loading masternode payment cache..."));
-            CFlatDB<CMasternodePayments> flatdb3(strDBName, "magicMasternodePaymentsCache");
-            if(!flatdb3.Load(mnpayments)) {
-                return InitError(_("Failed to load masternode payments cache from") + "\n" + (pathDB / strDBName).string());
+            if(!fMasternodePaymentsLoaded) {
+                return InitError(_("Failed to load masternode payments cache from") + "\n" + (pathDB / "mnpayments.dat").string());
             }
 
             if (fnodeman.size()) {
-                strDBName = "fnpayments.dat";
-                uiInterface.InitMessage(_("Loading fundamentalnode payment cache..."));
-                CFlatDB<CFundamentalnodePayments> flatdb4(strDBName, "magicFundamentalnodePaymentsCache");
-                if(!flatdb4.Load(fnpayments)) {
-                    return InitError(_("Failed to load fundamentalnode payments cache from") + "\n" + (pathDB / strDBName).string());
+                if(!fFundamentalnodePaymentsLoaded) {
+                    return InitError(_("Failed to load fundamentalnode payments cache from") + "\n" + (pathDB / "fnpayments.dat").string());
                 }
+            } else {
+                fnpayments.Clear();
             }
 
-            strDBName = "governance.dat";
-            uiInterface.InitMessage(_("Loading governance cache..."));
-            CFlatDB<CGovernanceManager> flatdb5(strDBName, "magicGovernanceCache");
-            if(!flatdb5.Load(governance)) {
-                return InitError(_("Failed to load governance cache from") + "\n" + (pathDB / strDBName).string());
+            if(!fGovernanceLoaded) {
+                return InitError(_("Failed to load governance cache from") + "\n" + (pathDB / "governance.dat").string());
             }
             governance.InitOnLoad();
         } else {
             uiInterface.InitMessage(_("Masternode/Fundamentalnode cache is empty, skipping payments and governance cache..."));
+            mnpayments.Clear();
+            fnpayments.Clear();
+            governance.Clear();
         }
 
-        strDBName = "netfulfilled.dat";
-        uiInterface.InitMessage(_("Loading fulfilled requests cache..."));
-        CFlatDB<CNetFulfilledRequestManager> flatdb6(strDBName, "magicFulfilledCache");
-        if(!flatdb6.Load(netfulfilledman)) {
-            return InitError(_("Failed to load fulfilled requests cache from") + "\n" + (pathDB / strDBName).string());
+        if(!fFulfilledLoaded) {
+            return InitError(_("Failed to load fulfilled requests cache from") + "\n" + (pathDB / "netfulfilled.dat").string());
         }
+
+        // store the caches regularly too, so that a crash doesn't lose everything since startup
+        threadGroup.create_thread(boost::bind(&TraceThread<void (*)()>, "dumpcache", &ThreadDumpDataCaches));
     }
 
 
@@ -2004,6 +2068,14 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
     // GetMainSignals().UpdatedBlockTip(chainActive.Tip());
     pdsNotificationInterface->InitializeCurrentBlockTip();
 
+    // now that the tip is known, clean up the caches loaded in Step 11b
+    if (!fLiteMode) {
+        mnpayments.CheckAndRemove();
+        fnpayments.CheckAndRemove();
+        governance.CheckAndRemove();
+        netfulfilledman.CheckAndRemove();
+    }
+
     // ********************************************************* Step 11d: start securetag-ps-<smth> threads
 
     threadGroup.create_thread(boost::bind(&ThreadCheckPrivateSend, boost::ref(*g_connman)));
@@ -2039,6 +2111,7 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
     connOptions.uiInterface = &uiInterface;
     connOptions.nSendBufferMaxSize = 1000*GetArg("-maxsendbuffer", DEFAULT_MAXSENDBUFFER);
     connOptions.nReceiveFloodSize = 1000*GetArg("-maxreceivebuffer", DEFAULT_MAXRECEIVEBUFFER);
+    connOptions.nMessageHandlerThreads = GetArg("-msghandthreads", DEFAULT_MSGHAND_THREADS);
 
     connOptions.nMaxOutboundTimeframe = nMaxOutboundTimeframe;
     connOptions.nMaxOutboundLimit = nMaxOutboundLimit;
@@ -2056,8 +2129,11 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
         pwalletMain->postInitProcess(threadGroup);
     if (IsArgSet("-staking"))
     {
-        if (GetBoolArg("-staking", DEFAULT_STAKING))
+        if (GetBoolArg("-staking", DEFAULT_STAKING)) {
+            for (int i=0; i<nScriptCheckThreads-1; i++)
+                threadGroup.create_thread(&ThreadStakeKernelCheck);
             threadGroup.create_thread(std::bind(&ThreadStakeMinter, boost::ref(chainparams), boost::ref(connman), pwalletMain));
+        }
     }
 #endif
 
@@ -477,6 +477,20 @@ void CInstantSend::ProcessOrphanTxLockVotes()
     AssertLockHeld(cs_main);
     AssertLockHeld(cs_instantsend);
 
+    // Check the signatures of all orphan votes at once, processing them below
+    // finds the valid ones in the message signature cache
+    if(sporkManager.IsSporkActive(SPORK_6_NEW_SIGS)) {
+        std::vector<CHashSignatureCheck> vChecks;
+        for (const auto& votepair : mapTxLockVotesOrphan) {
+            masternode_info_t infoMn;
+            if(mnodeman.GetMasternodeInfo(votepair.second.GetMasternodeOutpoint(), infoMn)) {
+                vChecks.push_back(CHashSignatureCheck(votepair.second.GetSignatureHash(), infoMn.pubKeyMasternode.GetID(),
+                                                      votepair.second.GetMasternodeSignature()));
+            }
+        }
+        CHashSigner::VerifyHashes(vChecks);
+    }
+
     std::map<uint256, CTxLockVote>::iterator it = mapTxLockVotesOrphan.begin();
     while(it != mapTxLockVotesOrphan.end()) {
         if(ProcessOrphanTxLockVote(it->second)) {
@@ -228,13 +228,67 @@ bool ComputeNextStakeModifier(const CBlockIndex* pindexCurrent, uint64_t& nStake
     return true;
 }
 
+// For every height, the last block whose kernel stake modifier was looked up
+// at that height, the block that provided the modifier and the height and time
+// of the last block that generated one along the way. The modifier block is
+// found by walking the active chain forward from the kernel's block, and the
+// result only depends on the blocks in between, so it stays valid for as long
+// as the modifier block is part of the active chain.
+struct CKernelModifierEntry
+{
+    const CBlockIndex* pindexFrom;
+    const CBlockIndex* pindexModifier;
+    int nModifierHeight;
+    int64_t nModifierTime;
+};
+static CCriticalSection cs_kernelmodifiers;
+static std::vector<CKernelModifierEntry> vKernelModifiers;
+
+void ClearKernelStakeModifierCache()
+{
+    LOCK(cs_kernelmodifiers);
+    std::vector<CKernelModifierEntry>().swap(vKernelModifiers);
+}
+
+static bool GetCachedKernelModifier(const CBlockIndex* pindexFrom, CKernelModifierEntry& entryRet)
+{
+    LOCK(cs_kernelmodifiers);
+    if (pindexFrom->nHeight < 0 || pindexFrom->nHeight >= (int)vKernelModifiers.size())
+        return false;
+    const CKernelModifierEntry& entry = vKernelModifiers[pindexFrom->nHeight];
+    if (entry.pindexFrom != pindexFrom || !chainActive.Contains(entry.pindexModifier))
+        return false;
+    entryRet = entry;
+    return true;
+}
+
+static void CacheKernelModifier(const CKernelModifierEntry& entry)
+{
+    LOCK(cs_kernelmodifiers);
+    const int nHeight = entry.pindexFrom->nHeight;
+    if (nHeight < 0)
+        return;
+    if (nHeight >= (int)vKernelModifiers.size())
+        vKernelModifiers.resize(std::max(chainActive.Height(), nHeight) + 1, CKernelModifierEntry{NULL, NULL, 0, 0});
+    vKernelModifiers[nHeight] = entry;
+}
+
 static bool GetKernlStakeModifierV03(uint256 hashBlockFrom, unsigned int nTimeTx, uint64_t& nStakeModifier, int& nStakeModifierHeight, int64_t& nStakeModifierTime, bool fPrintProofOfStake)
 {
     nStakeModifier = 0;
-    if (!mapBlockIndex.count(hashBlockFrom))
+    BlockMap::iterator mi = mapBlockIndex.find(hashBlockFrom);
+    if (mi == mapBlockIndex.end())
         return error("GetKernelStakeModifier() : block not indexed");
 
-    const CBlockIndex* pindexFrom = mapBlockIndex[hashBlockFrom];
+    const CBlockIndex* pindexFrom = mi->second;
+    CKernelModifierEntry cached;
+    if (GetCachedKernelModifier(pindexFrom, cached)) {
+        nStakeModifierHeight = cached.nModifierHeight;
+        nStakeModifierTime = cached.nModifierTime;
+        nStakeModifier = cached.pindexModifier->nStakeModifier;
+        return true;
+    }
+
     nStakeModifierHeight = pindexFrom->nHeight;
     nStakeModifierTime = pindexFrom->GetBlockTime();
     int64_t nStakeModifierSelectionInterval = GetStakeModifierSelectionInterval();
@@ -267,6 +321,7 @@ static bool GetKernlStakeModifierV03(uint256 hashBlockFrom, unsigned int nTimeTx
         }
     }
     nStakeModifier = pindex->nStakeModifier;
+    CacheKernelModifier(CKernelModifierEntry{pindexFrom, pindex, nStakeModifierHeight, nStakeModifierTime});
     return true;
 }
 
@@ -302,22 +357,20 @@ static bool GetKernelStakeModifier(uint256 hashBlockFrom, unsigned int nTimeTx,
 //   a proof-of-work situation.
 //
 
-bool CheckStakeKernelHash(unsigned int nBits, const CBlock& blockFrom, unsigned int nTxPrevOffset, const CTransactionRef& txPrev, const COutPoint& prevout, unsigned int nTimeTx, uint256& hashProofOfStake)
+static bool CheckStakeKernelHash(unsigned int nBits, const uint256& hashBlockFrom, unsigned int nTimeBlockFrom, unsigned int nTxPrevOffset, CAmount nValueIn, const COutPoint& prevout, unsigned int nTimeTx, uint256& hashProofOfStake)
 {
 
-    auto txPrevTime = blockFrom.GetBlockTime();
+    int64_t txPrevTime = nTimeBlockFrom; // serialized as 64 bit below
     if (nTimeTx < txPrevTime)  // Transaction timestamp violation
         return error("CheckStakeKernelHash() : nTime violation");
 
     auto nStakeMinAge = nTimeTx > Params().GetConsensus().nStakeMinAgeSwitchTime ? Params().GetConsensus().nStakeMinAge_2 : Params().GetConsensus().nStakeMinAge;
     auto nStakeMaxAge = Params().GetConsensus().nStakeMaxAge;
-    unsigned int nTimeBlockFrom = blockFrom.GetBlockTime();
     if (nTimeBlockFrom + nStakeMinAge > nTimeTx) // Min age requirement
         return error("CheckStakeKernelHash() : min age violation");
 
     arith_uint256 bnTargetPerCoinDay;
     bnTargetPerCoinDay.SetCompact(nBits);
-    CAmount nValueIn = txPrev->vout[prevout.n].nValue;
     // v0.3 protocol kernel hash weight starts from 0 at the 30-day min age
     // this change increases active coins participating the hash and helps
     // to secure the network when proof-of-stake difficulty is low
@@ -331,7 +384,7 @@ bool CheckStakeKernelHash(unsigned int nBits, const CBlock& blockFrom, unsigned
     int64_t nStakeModifierTime = 0;
 
     if (IsProtocolV03(nTimeTx)){
-        if (!GetKernelStakeModifier(blockFrom.GetHash(), nTimeTx, nStakeModifier, nStakeModifierHeight, nStakeModifierTime, false))
+        if (!GetKernelStakeModifier(hashBlockFrom, nTimeTx, nStakeModifier, nStakeModifierHeight, nStakeModifierTime, false))
             return false;
         ss << nStakeModifier;
     }
@@ -349,6 +402,16 @@ bool CheckStakeKernelHash(unsigned int nBits, const CBlock& blockFrom, unsigned
     return true;
 }
 
+bool CheckStakeKernelHash(unsigned int nBits, const CBlock& blockFrom, unsigned int nTxPrevOffset, const CTransactionRef& txPrev, const COutPoint& prevout, unsigned int nTimeTx, uint256& hashProofOfStake)
+{
+    return CheckStakeKernelHash(nBits, blockFrom.GetHash(), blockFrom.GetBlockTime(), nTxPrevOffset, txPrev->vout[prevout.n].nValue, prevout, nTimeTx, hashProofOfStake);
+}
+
+bool CheckStakeKernelHash(unsigned int nBits, const CBlockIndex* pindexFrom, unsigned int nTxPrevOffset, const CTxOut& txoutPrev, const COutPoint& prevout, unsigned int nTimeTx, uint256& hashProofOfStake)
+{
+    return CheckStakeKernelHash(nBits, pindexFrom->GetBlockHash(), pindexFrom->GetBlockTime(), nTxPrevOffset, txoutPrev.nValue, prevout, nTimeTx, hashProofOfStake);
+}
+
 bool CheckKernelScript(CScript scriptVin, CScript scriptVout)
 {
     auto extractKeyID = [](CScript scriptPubKey) {
@@ -370,38 +433,74 @@ bool CheckKernelScript(CScript scriptVin, CScript scriptVout)
     };
     return extractKeyID(scriptVin) == extractKeyID(scriptVout);
 }
-bool CheckProofOfStake(const CBlock &block, uint256& hashProofOfStake)
+// Check the coinstake's kernel against the staked output, found in the
+// block of pindexFrom
+static bool CheckProofOfStake(const CBlock &block, const CTxOut& prevTxOut, const CBlockIndex* pindexFrom, uint256& hashProofOfStake)
 {
     const CTransactionRef tx = block.vtx[1];
-    if (!tx->IsCoinStake())
-        return error("CheckProofOfStake() : called on non-coinstake %s", tx->GetHash().ToString().c_str());
-    // Kernel (input 0) must match the stake hash target per coin age (nBits)
     const CTxIn& txin = tx->vin[0];
-    // First try finding the previous transaction in database
-    uint256 hashBlock;
-    CTransactionRef txPrev;
-    const auto &cons = Params().GetConsensus();
-    if (!GetTransaction(txin.prevout.hash, txPrev, cons, hashBlock, true))
-        return ("CheckProofOfStake() : INFO: read txPrev failed");
-    CTxOut prevTxOut = txPrev->vout[txin.prevout.n];
-    CBlockIndex* pindex = NULL;
-    BlockMap::iterator it = mapBlockIndex.find(hashBlock);
-    if (it != mapBlockIndex.end())
-        pindex = it->second;
-    else
-        return error("CheckProofOfStake() : read block failed");
-    // Read block header
-    CBlock blockprev;
-    if (!ReadBlockFromDisk(blockprev, pindex->GetBlockPos(), cons))
-        return error("CheckProofOfStake(): INFO: failed to find block");
     if(!CheckKernelScript(prevTxOut.scriptPubKey, tx->vout[1].scriptPubKey))
         return error("CheckProofOfStake() : INFO: check kernel script failed on coinstake %s, hashProof=%s \n", tx->GetHash().ToString().c_str(), hashProofOfStake.ToString().c_str());
     unsigned int nTime = block.nTime;
-    if (!CheckStakeKernelHash(block.nBits, blockprev, sizeof(CBlock), txPrev, txin.prevout, nTime, hashProofOfStake))
+    if (!CheckStakeKernelHash(block.nBits, pindexFrom, STAKE_KERNEL_TX_PREV_OFFSET, prevTxOut, txin.prevout, nTime, hashProofOfStake))
         return error("CheckProofOfStake() : INFO: check kernel failed on coinstake %s, hashProof=%s \n", tx->GetHash().ToString().c_str(), hashProofOfStake.ToString().c_str()); // may occur during initial download or if behind on block chain sync
 
     return true;
 }
+
+bool CheckProofOfStake(const CBlock &block, uint256& hashProofOfStake, bool& fDeferred)
+{
+    fDeferred = false;
+    const CTransactionRef tx = block.vtx[1];
+    if (!tx->IsCoinStake())
+        return error("CheckProofOfStake() : called on non-coinstake %s", tx->GetHash().ToString().c_str());
+    // Kernel (input 0) must match the stake hash target per coin age (nBits)
+    const CTxIn& txin = tx->vin[0];
+    const auto &cons = Params().GetConsensus();
+    // The kernel only needs the staked output and the index entry of the block
+    // that contains it. Take them from the UTXO set when the output is still
+    // unspent, and only fall back to the transaction index (e.g. when the block
+    // is checked again after it was connected) without reading any block.
+    CTxOut prevTxOut;
+    const CBlockIndex* pindex = NULL;
+    {
+        LOCK(cs_main);
+        Coin coin;
+        if (pcoinsTip && pcoinsTip->GetCoin(txin.prevout, coin) && (int)coin.nHeight <= chainActive.Height()) {
+            prevTxOut = coin.out;
+            pindex = chainActive[coin.nHeight];
+        } else {
+            // First try finding the previous transaction in database
+            uint256 hashBlock;
+            CTransactionRef txPrev;
+            if (!GetTransaction(txin.prevout.hash, txPrev, cons, hashBlock, true)) {
+                // txPrev may be in a block that is not connected yet, e.g. during
+                // initial download. ConnectBlock checks the kernel then.
+                LogPrint("kernel", "CheckProofOfStake() : txPrev of coinstake %s not found, deferred\n", tx->GetHash().ToString());
+                fDeferred = true;
+                return true;
+            }
+            prevTxOut = txPrev->vout[txin.prevout.n];
+            BlockMap::iterator it = mapBlockIndex.find(hashBlock);
+            if (it != mapBlockIndex.end())
+                pindex = it->second;
+            else
+                return error("CheckProofOfStake() : read block failed");
+        }
+    }
+    return CheckProofOfStake(block, prevTxOut, pindex, hashProofOfStake);
+}
+
+bool CheckProofOfStake(const CBlock &block, const CBlockIndex* pindexPrev, const CCoinsViewCache& view, uint256& hashProofOfStake)
+{
+    const CTransactionRef tx = block.vtx[1];
+    if (!tx->IsCoinStake())
+        return error("CheckProofOfStake() : called on non-coinstake %s", tx->GetHash().ToString().c_str());
+    const Coin& coin = view.AccessCoin(tx->vin[0].prevout);
+    if (coin.IsSpent() || (int)coin.nHeight > pindexPrev->nHeight)
+        return error("CheckProofOfStake() : txPrev of coinstake %s is missing or spent", tx->GetHash().ToString().c_str());
+    return CheckProofOfStake(block, coin.out, pindexPrev->GetAncestor(coin.nHeight), hashProofOfStake);
+}
 // Get stake modifier checksum
 unsigned int GetStakeModifierChecksum(const CBlockIndex* pindex)
 {
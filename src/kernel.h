@@ -21,16 +21,29 @@ extern unsigned int getIntervalVersion(bool fTestNet);
 // MODIFIER_INTERVAL_RATIO:
 // ratio of group interval length between the last group and the first group
 static const int MODIFIER_INTERVAL_RATIO = 3;
+// Offset of txPrev in its block as hashed into the stake kernel. It has always
+// been sizeof(CBlock) of 64 bit builds and is part of consensus, so it is fixed.
+static const unsigned int STAKE_KERNEL_TX_PREV_OFFSET = 256;
 // Compute the hash modifier for proof-of-stake
 bool ComputeNextStakeModifier(const CBlockIndex* pindexPrev, uint64_t& nStakeModifier, bool& fGeneratedStakeModifier);
+// Forget the cached kernel stake modifier lookups, e.g. when unloading the block index
+void ClearKernelStakeModifierCache();
 // Check whether stake kernel meets hash target
 // Sets hashProofOfStake on success return
 bool CheckStakeKernelHash(unsigned int nBits, const CBlock& blockFrom, unsigned int nTxPrevOffset,
                           const CTransactionRef& txPrev, const COutPoint& prevout, unsigned int nTimeTx,
                           uint256& hashProofOfStake);
+// Same as above, for a staked output in the block of the given index entry
+bool CheckStakeKernelHash(unsigned int nBits, const CBlockIndex* pindexFrom, unsigned int nTxPrevOffset,
+                          const CTxOut& txoutPrev, const COutPoint& prevout, unsigned int nTimeTx,
+                          uint256& hashProofOfStake);
 // Check kernel hash target and coinstake signature
-// Sets hashProofOfStake on success return
-bool CheckProofOfStake(const CBlock &block, uint256& hashProofOfStake);
+// Sets hashProofOfStake on success return. If txPrev is not known yet, e.g.
+// during initial download, sets fDeferred and returns true instead.
+bool CheckProofOfStake(const CBlock &block, uint256& hashProofOfStake, bool& fDeferred);
+// Same as above, taking txPrev from the coins view of the chain ending at
+// pindexPrev, where it must exist
+bool CheckProofOfStake(const CBlock &block, const CBlockIndex* pindexPrev, const CCoinsViewCache& view, uint256& hashProofOfStake);
 // Check whether the coinstake timestamp meets protocol
 bool CheckCoinStakeTimestamp(int64_t nTimeBlock, int64_t nTimeTx);
 // Get stake modifier checksum
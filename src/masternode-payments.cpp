@@ -18,6 +18,7 @@
 #include "netmessagemaker.h"
 #include "spork.h"
 #include "util.h"
+#include "validationinterface.h"
 
 #include <boost/lexical_cast.hpp>
 
@@ -239,6 +240,9 @@ void CMasternodePayments::Clear()
     LOCK2(cs_mapMasternodeBlocks, cs_mapMasternodePaymentVotes);
     mapMasternodeBlocks.clear();
     mapMasternodePaymentVotes.clear();
+
+    LOCK(cs_mapBlockPaymentOutputs);
+    mapBlockPaymentOutputs.clear();
 }
 
 bool CMasternodePayments::UpdateLastVote(const CMasternodePaymentVote& vote)
@@ -1144,6 +1148,49 @@ void CMasternodePayments::UpdatedBlockTip(const CBlockIndex *pindex, CConnman& c
     CheckBlockVotes(nFutureBlock - 1);
     ProcessBlock(nFutureBlock, connman);
 }
+
+void CMasternodePayments::SyncTransaction(const CTransaction& tx, const CBlockIndex *pindex, int posInBlock)
+{
+    if(fLiteMode) return;
+
+    // only the transaction paying the masternode of a connected block is indexed
+    if(!pindex || posInBlock == CMainSignals::SYNC_TRANSACTION_NOT_IN_BLOCK) return;
+    if(posInBlock != (pindex->nHeight > Params().GetConsensus().nLastPoWBlock ? 1 : 0)) return;
+
+    int nLimit = GetStorageLimit();
+
+    LOCK(cs_mapBlockPaymentOutputs);
+    mapBlockPaymentOutputs[pindex->nHeight] = std::make_pair(pindex->GetBlockHash(), tx.vout);
+    mapBlockPaymentOutputs.erase(mapBlockPaymentOutputs.begin(), mapBlockPaymentOutputs.lower_bound(pindex->nHeight - nLimit));
+}
+
+bool CMasternodePayments::GetBlockPaymentOutputs(const CBlockIndex *pindex, std::vector<CTxOut>& voutRet)
+{
+    {
+        LOCK(cs_mapBlockPaymentOutputs);
+        auto it = mapBlockPaymentOutputs.find(pindex->nHeight);
+        if(it != mapBlockPaymentOutputs.end() && it->second.first == pindex->GetBlockHash()) {
+            voutRet = it->second.second;
+            return true;
+        }
+    }
+
+    // The block was connected before we started or on another branch, read it once
+    CBlock block;
+    if(!ReadBlockFromDisk(block, pindex, Params().GetConsensus()))
+        return false;
+
+    size_t nPaymentTx = pindex->nHeight > Params().GetConsensus().nLastPoWBlock ? 1 : 0;
+    if(block.vtx.size() <= nPaymentTx)
+        return false;
+
+    voutRet = block.vtx[nPaymentTx]->vout;
+
+    LOCK(cs_mapBlockPaymentOutputs);
+    mapBlockPaymentOutputs[pindex->nHeight] = std::make_pair(pindex->GetBlockHash(), voutRet);
+    return true;
+}
+
 void AdjustMasternodePayment(CMutableTransaction &tx, const CTxOut &txoutMasternodePayment)
 {
     auto it = std::find(std::begin(tx.vout), std::end(tx.vout), txoutMasternodePayment);
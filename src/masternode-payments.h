@@ -29,6 +29,7 @@ static const int MIN_MASTERNODE_PAYMENT_PROTO_VERSION_2 = 70211;
 
 extern CCriticalSection cs_vecPayees;
 extern CCriticalSection cs_mapMasternodeBlocks;
+extern CCriticalSection cs_mapMasternodePaymentVotes;
 extern CCriticalSection cs_mapMasternodePayeeVotes;
 
 extern CMasternodePayments mnpayments;
@@ -188,6 +189,11 @@ private:
     // Keep track of current block height
     int nCachedBlockHeight;
 
+    // payment transaction outputs of recent blocks by height, so that last paid
+    // blocks can be found without reading the blocks from disk again
+    std::map<int, std::pair<uint256, std::vector<CTxOut> > > mapBlockPaymentOutputs;
+    mutable CCriticalSection cs_mapBlockPaymentOutputs;
+
 public:
     std::map<uint256, CMasternodePaymentVote> mapMasternodePaymentVotes;
     std::map<int, CMasternodeBlockPayees> mapMasternodeBlocks;
@@ -200,6 +206,7 @@ public:
 
     template <typename Stream, typename Operation>
     inline void SerializationOp(Stream& s, Operation ser_action) {
+        LOCK2(cs_mapMasternodeBlocks, cs_mapMasternodePaymentVotes);
         READWRITE(mapMasternodePaymentVotes);
         READWRITE(mapMasternodeBlocks);
     }
@@ -235,6 +242,9 @@ public:
     int GetStorageLimit() const;
 
     void UpdatedBlockTip(const CBlockIndex *pindex, CConnman& connman);
+    void SyncTransaction(const CTransaction& tx, const CBlockIndex *pindex, int posInBlock);
+
+    bool GetBlockPaymentOutputs(const CBlockIndex *pindex, std::vector<CTxOut>& voutRet);
 };
 
 
@@ -76,6 +76,8 @@ void CMasternodeSync::SwitchToNextAsset(CConnman& connman)
             LogPrintf("CMasternodeSync::SwitchToNextAsset -- Completed %s in %llds\n", GetAssetName(), GetTime() - nTimeAssetSyncStarted);
             nRequestedMasternodeAssets = MASTERNODE_SYNC_MNW;
             LogPrintf("CMasternodeSync::SwitchToNextAsset -- Starting %s\n", GetAssetName());
+            // masternodes no longer wait for pings
+            mnodeman.ScheduleAllChecks();
             break;
         case(MASTERNODE_SYNC_MNW):
             LogPrintf("CMasternodeSync::SwitchToNextAsset -- Completed %s in %llds\n", GetAssetName(), GetTime() - nTimeAssetSyncStarted);
@@ -86,6 +88,8 @@ void CMasternodeSync::SwitchToNextAsset(CConnman& connman)
             LogPrintf("CMasternodeSync::SwitchToNextAsset -- Completed %s in %llds\n", GetAssetName(), GetTime() - nTimeAssetSyncStarted);
             nRequestedMasternodeAssets = MASTERNODE_SYNC_FINISHED;
             uiInterface.NotifyAdditionalDataSyncProgressChanged(1);
+            // sentinel pings start to count
+            mnodeman.ScheduleAllChecks();
             //try to activate our masternode if possible
             activeMasternode.ManageState(connman);
 
@@ -198,6 +202,7 @@ void CMasternodeSync::ProcessTick(CConnman& connman)
                 SendGovernanceSyncRequest(pnode, connman);
             } else {
                 nRequestedMasternodeAssets = MASTERNODE_SYNC_FINISHED;
+                mnodeman.ScheduleAllChecks();
             }
             nRequestedMasternodeAttempt++;
             connman.ReleaseNodeVector(vNodesCopy);
@@ -9,6 +9,8 @@
 
 #include <univalue.h>
 
+#include <atomic>
+
 class CMasternodeSync;
 
 static const int MASTERNODE_SYNC_FAILED          = -1;
@@ -35,17 +37,19 @@ extern CMasternodeSync masternodeSync;
 class CMasternodeSync
 {
 private:
+    // Atomic, the modules bump them from several message handler threads
+
     // Keep track of current asset
-    int nRequestedMasternodeAssets;
+    std::atomic<int> nRequestedMasternodeAssets;
     // Count peers we've requested the asset from
-    int nRequestedMasternodeAttempt;
+    std::atomic<int> nRequestedMasternodeAttempt;
 
     // Time when current masternode asset sync started
-    int64_t nTimeAssetSyncStarted;
+    std::atomic<int64_t> nTimeAssetSyncStarted;
     // ... last bumped
-    int64_t nTimeLastBumped;
+    std::atomic<int64_t> nTimeLastBumped;
     // ... or failed
-    int64_t nTimeLastFailure;
+    std::atomic<int64_t> nTimeLastFailure;
 
     void Fail();
 
@@ -13,11 +13,14 @@
 #include "masternodeman.h"
 #include "messagesigner.h"
 #include "script/standard.h"
+#include "timedata.h"
 #include "util.h"
 #ifdef ENABLE_WALLET
 #include "wallet/wallet.h"
 #endif // ENABLE_WALLET
 
+#include <limits>
+
 #include <boost/lexical_cast.hpp>
 
 
@@ -152,8 +155,10 @@ void CMasternode::Check(bool fForce)
 
     int nHeight = 0;
     if(!fUnitTest) {
+        // spends of the collateral are reported by CMasternodeMan::SyncTransaction,
+        // the UTXO set is only looked up on forced checks
         Coin coin;
-        if(!GetUTXOCoin(outpoint, coin)) {
+        if(fForce && !GetUTXOCoin(outpoint, coin)) {
             nActiveState = MASTERNODE_OUTPOINT_SPENT;
             LogPrint("masternode", "CMasternode::Check -- Failed to find Masternode UTXO, masternode=%s\n", outpoint.ToStringShort());
             return;
@@ -273,6 +278,42 @@ void CMasternode::Check(bool fForce)
     }
 }
 
+void CMasternode::SetCollateralSpent()
+{
+    LOCK(cs);
+    if(IsOutpointSpent()) return;
+
+    nActiveState = MASTERNODE_OUTPOINT_SPENT;
+    LogPrint("masternode", "CMasternode::SetCollateralSpent -- Masternode collateral spent, masternode=%s\n", outpoint.ToStringShort());
+}
+
+void CMasternode::SetCollateralUnspent()
+{
+    LOCK(cs);
+    if(!IsOutpointSpent()) return;
+
+    nActiveState = MASTERNODE_PRE_ENABLED;
+    LogPrint("masternode", "CMasternode::SetCollateralUnspent -- Masternode collateral spend disconnected, masternode=%s\n", outpoint.ToStringShort());
+}
+
+int64_t CMasternode::GetNextPingTransitionTime()
+{
+    LOCK(cs);
+    int64_t nNext = std::numeric_limits<int64_t>::max();
+    if(!lastPing) return nNext;
+
+    // the thresholds IsPingedWithin is called with in Check
+    int64_t nNow = GetAdjustedTime();
+    for (int nSeconds : {MASTERNODE_MIN_MNP_SECONDS, MASTERNODE_SENTINEL_PING_MAX_SECONDS, MASTERNODE_EXPIRATION_SECONDS, MASTERNODE_NEW_START_REQUIRED_SECONDS}) {
+        int64_t nTime = lastPing.sigTime + nSeconds;
+        if(nTime > nNow) nNext = std::min(nNext, nTime);
+    }
+    if(nNext == std::numeric_limits<int64_t>::max()) return nNext;
+
+    // pings are timed in network adjusted time
+    return nNext - GetTimeOffset();
+}
+
 bool CMasternode::IsValidNetAddr()
 {
     return IsValidNetAddr(addr);
@@ -334,15 +375,13 @@ void CMasternode::UpdateLastPaid(const CBlockIndex *pindex, int nMaxBlocksToScan
         if(mnpayments.mapMasternodeBlocks.count(BlockReading->nHeight) &&
            mnpayments.mapMasternodeBlocks[BlockReading->nHeight].HasPayeeWithVotes(mnpayee, 2))
         {
-            CBlock block;
-            if(!ReadBlockFromDisk(block, BlockReading, Params().GetConsensus())) // shouldn't really happen
+            std::vector<CTxOut> vout;
+            if(!mnpayments.GetBlockPaymentOutputs(BlockReading, vout)) // shouldn't really happen
                 continue;
 
-            const auto& coinbaseTransaction = (BlockReading->nHeight > Params().GetConsensus().nLastPoWBlock ? block.vtx[1] : block.vtx[0]);
-
             CAmount nMasternodePayment = GetMasternodePayment(BlockReading->nHeight, BlockReading->nMint);
 
-            for(const CTxOut &txout : coinbaseTransaction->vout)
+            for(const CTxOut &txout : vout)
                 if(mnpayee == txout.scriptPubKey && nMasternodePayment == txout.nValue) {
                     nBlockLastPaid = BlockReading->nHeight;
                     nTimeLastPaid = BlockReading->nTime;
@@ -246,6 +246,14 @@ public:
     static CollateralStatus CheckCollateral(const COutPoint& outpoint, const CPubKey& pubkey);
     static CollateralStatus CheckCollateral(const COutPoint& outpoint, const CPubKey& pubkey, int& nHeightRet);
     void Check(bool fForce = false);
+    /// The collateral was spent in a connected block
+    void SetCollateralSpent();
+    /// The block spending the collateral was disconnected, the next forced
+    /// Check works the state out again
+    void SetCollateralUnspent();
+    /// GetTime() at which the age of the last ping changes the state next,
+    /// or max() if no such change is left
+    int64_t GetNextPingTransitionTime();
 
     bool IsBroadcastedWithin(int nSeconds) { return GetAdjustedTime() - sigTime < nSeconds; }
 
@@ -19,6 +19,7 @@
 #include "script/standard.h"
 #include "ui_interface.h"
 #include "util.h"
+#include "validationinterface.h"
 #include "warnings.h"
 
 /** Masternode manager */
@@ -58,6 +59,7 @@ struct CompareByAddr
 CMasternodeMan::CMasternodeMan():
     cs(),
     mapMasternodes(),
+    mapRankCache(RANK_CACHE_SIZE),
     mAskedUsForMasternodeList(),
     mWeAskedForMasternodeList(),
     mWeAskedForMasternodeListEntry(),
@@ -82,6 +84,8 @@ bool CMasternodeMan::Add(CMasternode &mn)
 
     LogPrint("masternode", "CMasternodeMan::Add -- Adding new Masternode: addr=%s, %i now\n", mn.addr.ToString(), size() + 1);
     mapMasternodes[mn.outpoint] = mn;
+    ScheduleCheck(mn.outpoint, GetTime());
+    mapRankCache.Clear();
     fMasternodesAdded = true;
     return true;
 }
@@ -155,20 +159,96 @@ bool CMasternodeMan::PoSeBan(const COutPoint &outpoint)
         return false;
     }
     pmn->PoSeBan();
+    ScheduleCheck(outpoint, GetTime());
 
     return true;
 }
 
+void CMasternodeMan::ScheduleCheck(const COutPoint& outpoint, int64_t nTime)
+{
+    AssertLockHeld(cs);
+
+    auto it = mapScheduledChecks.find(outpoint);
+    if (it != mapScheduledChecks.end()) {
+        setScheduledChecks.erase(std::make_pair(it->second, outpoint));
+        it->second = nTime;
+    } else {
+        mapScheduledChecks.emplace(outpoint, nTime);
+    }
+    setScheduledChecks.emplace(nTime, outpoint);
+}
+
+void CMasternodeMan::UnscheduleCheck(const COutPoint& outpoint)
+{
+    AssertLockHeld(cs);
+
+    auto it = mapScheduledChecks.find(outpoint);
+    if (it == mapScheduledChecks.end()) return;
+    setScheduledChecks.erase(std::make_pair(it->second, outpoint));
+    mapScheduledChecks.erase(it);
+}
+
+int64_t CMasternodeMan::GetNextCheckTime(CMasternode& mn)
+{
+    AssertLockHeld(cs);
+
+    int64_t nNow = GetTime();
+    int64_t nTime = mn.GetNextPingTransitionTime();
+    // sentinel pings going quiet changes the state of every MN
+    if (nNow - nLastSentinelPingTime <= MASTERNODE_SENTINEL_PING_MAX_SECONDS)
+        nTime = std::min(nTime, nLastSentinelPingTime + MASTERNODE_SENTINEL_PING_MAX_SECONDS + 1);
+    return std::max(nTime, nNow + 1);
+}
+
+void CMasternodeMan::ScheduleAllChecks()
+{
+    LOCK(cs);
+    int64_t nNow = GetTime();
+    for (const auto& mnpair : mapMasternodes) {
+        if (mnpair.second.IsOutpointSpent()) continue;
+        // keep the checks that are due already, forced ones included
+        auto it = mapScheduledChecks.find(mnpair.first);
+        if (it != mapScheduledChecks.end() && it->second <= nNow) continue;
+        ScheduleCheck(mnpair.first, nNow);
+    }
+}
+
 void CMasternodeMan::Check()
 {
+    int64_t nNow = GetTime();
+    {
+        // don't wait for cs_main when no MN is due
+        LOCK(cs);
+        if (setScheduledChecks.empty() || setScheduledChecks.begin()->first > nNow) return;
+    }
+
     LOCK2(cs_main, cs);
 
     LogPrint("masternode", "CMasternodeMan::Check -- nLastSentinelPingTime=%d, IsSentinelPingActive()=%d\n", nLastSentinelPingTime, IsSentinelPingActive());
 
-    for (auto& mnpair : mapMasternodes) {
+    while (!setScheduledChecks.empty() && setScheduledChecks.begin()->first <= nNow) {
+        const std::pair<int64_t, COutPoint> check = *setScheduledChecks.begin();
+        auto it = mapMasternodes.find(check.second);
+        if (it == mapMasternodes.end()) {
+            UnscheduleCheck(check.second);
+            continue;
+        }
+
         // NOTE: internally it checks only every MASTERNODE_CHECK_SECONDS seconds
-        // since the last time, so expect some MNs to skip this
-        mnpair.second.Check();
+        // since the last time, so MNs checked on a ping skip this
+        it->second.Check(check.first == 0);
+        if (it->second.IsOutpointSpent()) {
+            UnscheduleCheck(check.second);
+            continue;
+        }
+        if (it->second.nTimeLastChecked < nNow) {
+            // skipped, try again once the MN may be checked
+            ScheduleCheck(check.second, std::max(it->second.nTimeLastChecked + MASTERNODE_CHECK_SECONDS, nNow + 1));
+            continue;
+        }
+        // nothing but time changes the state until then, new pings, broadcasts,
+        // PoSe bans and sync changes reschedule the MN themselves
+        ScheduleCheck(check.second, GetNextCheckTime(it->second));
     }
 }
 
@@ -203,7 +283,9 @@ void CMasternodeMan::CheckAndRemove(CConnman& connman)
 
                 // and finally remove it from the list
                 it->second.FlagGovernanceItemsAsDirty();
+                UnscheduleCheck(it->first);
                 mapMasternodes.erase(it++);
+                mapRankCache.Clear();
                 fMasternodesRemoved = true;
             } else {
                 bool fAsk = (nAskForMnbRecovery > 0) &&
@@ -360,6 +442,9 @@ void CMasternodeMan::Clear()
 {
     LOCK(cs);
     mapMasternodes.clear();
+    setScheduledChecks.clear();
+    mapScheduledChecks.clear();
+    mapRankCache.Clear();
     mAskedUsForMasternodeList.clear();
     mWeAskedForMasternodeList.clear();
     mWeAskedForMasternodeListEntry.clear();
@@ -653,6 +738,35 @@ bool CMasternodeMan::GetMasternodeScores(const uint256& nBlockHash, CMasternodeM
     return !vecMasternodeScoresRet.empty();
 }
 
+bool CMasternodeMan::GetRankedMasternodes(const uint256& nBlockHash, std::vector<COutPoint>& vecOutpointsRet, int nMinProtocol)
+{
+    AssertLockHeld(cs);
+
+    vecOutpointsRet.clear();
+
+    // the cached ranks are only valid while the list stays synced
+    if (!masternodeSync.IsMasternodeListSynced())
+        return false;
+
+    const std::pair<uint256, int> key = std::make_pair(nBlockHash, nMinProtocol);
+    if (mapRankCache.Get(key, vecOutpointsRet))
+        return !vecOutpointsRet.empty();
+
+    score_pair_vec_t vecMasternodeScores;
+    GetMasternodeScores(nBlockHash, vecMasternodeScores, nMinProtocol);
+
+    vecOutpointsRet.reserve(vecMasternodeScores.size());
+    for (const auto& scorePair : vecMasternodeScores) {
+        vecOutpointsRet.push_back(scorePair.second->outpoint);
+    }
+
+    // an empty result is not cached, entries may still be on their way
+    if (!vecOutpointsRet.empty())
+        mapRankCache.Insert(key, vecOutpointsRet);
+
+    return !vecOutpointsRet.empty();
+}
+
 bool CMasternodeMan::GetMasternodeRank(const COutPoint& outpoint, int& nRankRet, int nBlockHeight, int nMinProtocol)
 {
     nRankRet = -1;
@@ -669,14 +783,14 @@ bool CMasternodeMan::GetMasternodeRank(const COutPoint& outpoint, int& nRankRet,
 
     LOCK(cs);
 
-    score_pair_vec_t vecMasternodeScores;
-    if (!GetMasternodeScores(nBlockHash, vecMasternodeScores, nMinProtocol))
+    std::vector<COutPoint> vecOutpoints;
+    if (!GetRankedMasternodes(nBlockHash, vecOutpoints, nMinProtocol))
         return false;
 
     int nRank = 0;
-    for (const auto& scorePair : vecMasternodeScores) {
+    for (const auto& outpointRanked : vecOutpoints) {
         nRank++;
-        if(scorePair.second->outpoint == outpoint) {
+        if(outpointRanked == outpoint) {
             nRankRet = nRank;
             return true;
         }
@@ -701,14 +815,14 @@ bool CMasternodeMan::GetMasternodeRanks(CMasternodeMan::rank_pair_vec_t& vecMast
 
     LOCK(cs);
 
-    score_pair_vec_t vecMasternodeScores;
-    if (!GetMasternodeScores(nBlockHash, vecMasternodeScores, nMinProtocol))
+    std::vector<COutPoint> vecOutpoints;
+    if (!GetRankedMasternodes(nBlockHash, vecOutpoints, nMinProtocol))
         return false;
 
     int nRank = 0;
-    for (const auto& scorePair : vecMasternodeScores) {
+    for (const auto& outpoint : vecOutpoints) {
         nRank++;
-        vecMasternodeRanksRet.push_back(std::make_pair(nRank, *scorePair.second));
+        vecMasternodeRanksRet.push_back(std::make_pair(nRank, mapMasternodes.at(outpoint)));
     }
 
     return true;
@@ -719,9 +833,16 @@ void CMasternodeMan::ProcessMasternodeConnections(CConnman& connman)
     //we don't care about this for regtest
     if(Params().NetworkIDString() == CBaseChainParams::REGTEST) return;
 
-    connman.ForEachNode(CConnman::AllNodes, [](CNode* pnode) {
 #ifdef ENABLE_WALLET
-        if(pnode->fMasternode && !privateSendClient.IsMixingMasternode(pnode)) {
+    // Look the mixing masternode up before taking cs_vNodes, the PrivateSend
+    // client holds its own lock while relaying to nodes
+    masternode_info_t infoMixingMasternode;
+    bool fMixing = privateSendClient.GetMixingMasternodeInfo(infoMixingMasternode);
+#endif // ENABLE_WALLET
+
+    connman.ForEachNode(CConnman::AllNodes, [&](CNode* pnode) {
+#ifdef ENABLE_WALLET
+        if(pnode->fMasternode && !(fMixing && pnode->addr == infoMixingMasternode.addr)) {
 #else
         if(pnode->fMasternode) {
 #endif // ENABLE_WALLET
@@ -860,7 +981,10 @@ void CMasternodeMan::ProcessMessage(CNode* pfrom, const std::string& strCommand,
         if(pmn && pmn->IsNewStartRequired()) return;
 
         int nDos = 0;
-        if(mnp.CheckAndUpdate(pmn, false, nDos, connman)) return;
+        bool fRelayed = mnp.CheckAndUpdate(pmn, false, nDos, connman);
+        // a new ping moves the expiry of the MN
+        if(pmn) ScheduleCheck(pmn->outpoint, GetNextCheckTime(*pmn));
+        if(fRelayed) return;
 
         if(nDos > 0) {
             // if anything significant failed, mark that node
@@ -1533,7 +1657,7 @@ bool CMasternodeMan::CheckMnbAndUpdateMasternodeList(CNode* pfrom, CMasternodeBr
                     if(mnb.lastPing.sigTime > mapSeenMasternodeBroadcast[hash].second.lastPing.sigTime) {
                         // simulate Check
                         CMasternode mnTemp = CMasternode(mnb);
-                        mnTemp.Check();
+                        mnTemp.Check(true);
                         LogPrint("masternode", "CMasternodeMan::CheckMnbAndUpdateMasternodeList -- mnb=%s seen request, addr=%s, better lastPing: %d min ago, projected mn state: %s\n", hash.ToString(), pfrom->addr.ToString(), (GetAdjustedTime() - mnb.lastPing.sigTime)/60, mnTemp.GetStateString());
                         if(mnTemp.IsValidStateForAutoStart(mnTemp.nActiveState)) {
                             // this node thinks it's a good one
@@ -1558,10 +1682,13 @@ bool CMasternodeMan::CheckMnbAndUpdateMasternodeList(CNode* pfrom, CMasternodeBr
         CMasternode* pmn = Find(mnb.outpoint);
         if(pmn) {
             CMasternodeBroadcast mnbOld = mapSeenMasternodeBroadcast[CMasternodeBroadcast(*pmn).GetHash()].second;
+            // the update may change the protocol version of this masternode
+            mapRankCache.Clear();
             if(!mnb.Update(pmn, nDos, connman)) {
                 LogPrint("masternode", "CMasternodeMan::CheckMnbAndUpdateMasternodeList -- Update() failed, masternode=%s\n", mnb.outpoint.ToStringShort());
                 return false;
             }
+            ScheduleCheck(pmn->outpoint, GetNextCheckTime(*pmn));
             if(hash != mnbOld.GetHash()) {
                 mapSeenMasternodeBroadcast.erase(mnbOld.GetHash());
             }
@@ -1620,7 +1747,10 @@ void CMasternodeMan::UpdateLastPaid(const CBlockIndex* pindex)
 void CMasternodeMan::UpdateLastSentinelPingTime()
 {
     LOCK(cs);
+    // sentinel pings becoming active may expire MNs
+    bool fWasActive = IsSentinelPingActive();
     nLastSentinelPingTime = GetTime();
+    if (!fWasActive) ScheduleAllChecks();
 }
 
 bool CMasternodeMan::IsSentinelPingActive()
@@ -1678,6 +1808,7 @@ void CMasternodeMan::SetMasternodeLastPing(const COutPoint& outpoint, const CMas
     if(mnp.fSentinelIsCurrent) {
         UpdateLastSentinelPingTime();
     }
+    ScheduleCheck(outpoint, GetNextCheckTime(*pmn));
     mapSeenMasternodePing.insert(std::make_pair(mnp.GetHash(), mnp));
 
     CMasternodeBroadcast mnb(*pmn);
@@ -1694,12 +1825,49 @@ void CMasternodeMan::UpdatedBlockTip(const CBlockIndex *pindex)
 
     CheckSameAddr();
 
+    {
+        // PoSe bans start and end with blocks rather than time
+        LOCK(cs);
+        int64_t nNow = GetTime();
+        for (auto& mnpair : mapMasternodes) {
+            if (mnpair.second.IsOutpointSpent()) continue;
+            bool fBanned = mnpair.second.IsPoSeBanned();
+            if ((fBanned && nCachedBlockHeight >= mnpair.second.nPoSeBanHeight) ||
+                (!fBanned && mnpair.second.nPoSeBanScore >= MASTERNODE_POSE_BAN_MAX_SCORE)) {
+                ScheduleCheck(mnpair.first, nNow);
+            }
+        }
+    }
+
     if(fMasternodeMode) {
         // normal wallet does not need to update this every block, doing update on rpc call should be enough
         UpdateLastPaid(pindex);
     }
 }
 
+void CMasternodeMan::SyncTransaction(const CTransaction& tx, const CBlockIndex *pindex, int posInBlock)
+{
+    if(fLiteMode) return;
+
+    // only spends in connected blocks remove collaterals from the UTXO set,
+    // mempool transactions come without a block
+    if(!pindex) return;
+
+    LOCK(cs);
+    for (const auto& txin : tx.vin) {
+        auto it = mapMasternodes.find(txin.prevout);
+        if (it == mapMasternodes.end()) continue;
+        if (posInBlock != CMainSignals::SYNC_TRANSACTION_NOT_IN_BLOCK) {
+            it->second.SetCollateralSpent();
+        } else if (it->second.IsOutpointSpent()) {
+            // the spending block was disconnected, look the collateral up again;
+            // an MN that CheckAndRemove dropped already comes back with its next mnb
+            it->second.SetCollateralUnspent();
+            ScheduleCheck(it->first, 0);
+        }
+    }
+}
+
 void CMasternodeMan::WarnMasternodeDaemonUpdates()
 {
     LOCK(cs);
@@ -5,6 +5,7 @@
 #ifndef MASTERNODEMAN_H
 #define MASTERNODEMAN_H
 
+#include "cachemap.h"
 #include "masternode.h"
 #include "sync.h"
 
@@ -39,6 +40,8 @@ private:
     static const int MNB_RECOVERY_WAIT_SECONDS      = 60;
     static const int MNB_RECOVERY_RETRY_SECONDS     = 3 * 60 * 60;
 
+    static const int RANK_CACHE_SIZE            = 20;
+
 
     // critical section to protect the inner data structures
     mutable CCriticalSection cs;
@@ -48,6 +51,14 @@ private:
 
     // map to hold all MNs
     std::map<COutPoint, CMasternode> mapMasternodes;
+    // time of the next check of every MN, ordered so that Check() only visits the MNs
+    // that are due; MNs loaded from disk or whose collateral spend was disconnected are
+    // due at 0 and get their collateral checked too
+    std::set<std::pair<int64_t, COutPoint> > setScheduledChecks;
+    std::map<COutPoint, int64_t> mapScheduledChecks;
+    // masternode outpoints sorted by score for recently ranked (block hash, min protocol) pairs,
+    // cleared whenever the list changes
+    CacheMap<std::pair<uint256, int>, std::vector<COutPoint> > mapRankCache;
     // who's asked for the Masternode list and the last time
     std::map<CService, int64_t> mAskedUsForMasternodeList;
     // who we asked for the Masternode list and the last time
@@ -81,12 +92,18 @@ private:
     CMasternode* Find(const COutPoint& outpoint);
 
     bool GetMasternodeScores(const uint256& nBlockHash, score_pair_vec_t& vecMasternodeScoresRet, int nMinProtocol = 0);
+    bool GetRankedMasternodes(const uint256& nBlockHash, std::vector<COutPoint>& vecOutpointsRet, int nMinProtocol);
 
     void SyncSingle(CNode* pnode, const COutPoint& outpoint, CConnman& connman);
     void SyncAll(CNode* pnode, CConnman& connman);
 
     void PushDsegInvs(CNode* pnode, const CMasternode& mn);
 
+    void ScheduleCheck(const COutPoint& outpoint, int64_t nTime);
+    void UnscheduleCheck(const COutPoint& outpoint);
+    /// The earliest time the state of the MN may change without new data
+    int64_t GetNextCheckTime(CMasternode& mn);
+
 public:
     // Keep track of all broadcasts I've seen
     std::map<uint256, std::pair<int64_t, CMasternodeBroadcast> > mapSeenMasternodeBroadcast;
@@ -113,6 +130,14 @@ public:
         }
 
         READWRITE(mapMasternodes);
+        if(ser_action.ForRead()) {
+            mapRankCache.Clear();
+            setScheduledChecks.clear();
+            mapScheduledChecks.clear();
+            for (const auto& mnpair : mapMasternodes) {
+                ScheduleCheck(mnpair.first, 0);
+            }
+        }
         READWRITE(mAskedUsForMasternodeList);
         READWRITE(mWeAskedForMasternodeList);
         READWRITE(mWeAskedForMasternodeListEntry);
@@ -138,10 +163,12 @@ public:
     void AskForMnb(CNode *pnode, const uint256 &hash);
 
     bool PoSeBan(const COutPoint &outpoint);
+    /// Check every MN soon, for changes that affect them all (sync, sentinel)
+    void ScheduleAllChecks();
     bool AllowMixing(const COutPoint &outpoint);
     bool DisallowMixing(const COutPoint &outpoint);
 
-    /// Check all Masternodes
+    /// Check the Masternodes that are due
     void Check();
 
     /// Check all Masternodes and remove inactive
@@ -235,6 +262,7 @@ public:
     void SetMasternodeLastPing(const COutPoint& outpoint, const CMasternodePing& mnp);
 
     void UpdatedBlockTip(const CBlockIndex *pindex);
+    void SyncTransaction(const CTransaction& tx, const CBlockIndex *pindex, int posInBlock);
 
     void WarnMasternodeDaemonUpdates();
 
@@ -3,12 +3,97 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "base58.h"
+#include "checkqueue.h"
 #include "hash.h"
+#include "random.h"
 #include "validation.h" // For strMessageMagic
 #include "messagesigner.h"
 #include "tinyformat.h"
+#include "util.h"
 #include "utilstrencodings.h"
 
+#include "cuckoocache.h"
+#include <boost/thread.hpp>
+
+namespace {
+
+/** Same as SignatureCacheHasher, entries are nonced hashes already */
+class MessageSignatureCacheHasher
+{
+public:
+    template <uint8_t hash_select>
+    uint32_t operator()(const uint256& key) const
+    {
+        static_assert(hash_select <8, "MessageSignatureCacheHasher only has 8 hashes available.");
+        uint32_t u;
+        std::memcpy(&u, key.begin()+4*hash_select, 4);
+        return u;
+    }
+};
+
+/**
+ * Valid message signature cache, so that masternode, governance and
+ * InstantSend messages relayed to us by several peers, or checked again
+ * after being verified in a batch, don't need the public key recovered again
+ */
+class CMessageSignatureCache
+{
+private:
+    //! Entries are SHA256(nonce || hash || key id || signature):
+    uint256 nonce;
+    typedef CuckooCache::cache<uint256, MessageSignatureCacheHasher> map_type;
+    map_type setValid;
+    boost::shared_mutex cs_sigcache;
+
+public:
+    uint32_t setup_bytes(size_t n)
+    {
+        GetRandBytes(nonce.begin(), 32);
+        return setValid.setup_bytes(n);
+    }
+
+    void ComputeEntry(uint256& entry, const uint256& hash, const CKeyID& keyID, const std::vector<unsigned char>& vchSig)
+    {
+        CSHA256().Write(nonce.begin(), 32).Write(hash.begin(), 32).Write(keyID.begin(), keyID.size()).Write(vchSig.data(), vchSig.size()).Finalize(entry.begin());
+    }
+
+    bool Get(const uint256& entry)
+    {
+        boost::shared_lock<boost::shared_mutex> lock(cs_sigcache);
+        return setValid.contains(entry, false);
+    }
+
+    void Set(uint256& entry)
+    {
+        boost::unique_lock<boost::shared_mutex> lock(cs_sigcache);
+        setValid.insert(entry);
+    }
+};
+
+CMessageSignatureCache messageSignatureCache;
+
+CCheckQueue<CHashSignatureCheck> hashsignaturequeue(32);
+// Only one thread at a time may act as the master of hashsignaturequeue
+CCriticalSection cs_hashsignaturequeue;
+
+} // anon namespace
+
+// To be called once in AppInitMain/TestingSetup, next to InitSignatureCache()
+void InitMessageSignatureCache()
+{
+    size_t nMaxCacheSize = (size_t)MAX_MESSAGE_SIG_CACHE_SIZE << 20;
+    size_t nElems = messageSignatureCache.setup_bytes(nMaxCacheSize);
+    LogPrintf("Using %zu MiB out of %zu requested for message signature cache, able to store %zu elements\n",
+            (nElems*sizeof(uint256)) >>20, nMaxCacheSize>>20, nElems);
+}
+
+bool IsMessageSignatureCached(const uint256& hash, const CKeyID& keyID, const std::vector<unsigned char>& vchSig)
+{
+    uint256 entry;
+    messageSignatureCache.ComputeEntry(entry, hash, keyID, vchSig);
+    return messageSignatureCache.Get(entry);
+}
+
 bool CMessageSigner::GetKeysFromSecret(const std::string& strSecret, CKey& keyRet, CPubKey& pubkeyRet)
 {
     CBitcoinSecret vchSecret;
@@ -56,6 +141,11 @@ bool CHashSigner::VerifyHash(const uint256& hash, const CPubKey& pubkey, const s
 
 bool CHashSigner::VerifyHash(const uint256& hash, const CKeyID& keyID, const std::vector<unsigned char>& vchSig, std::string& strErrorRet)
 {
+    uint256 entry;
+    messageSignatureCache.ComputeEntry(entry, hash, keyID, vchSig);
+    if(messageSignatureCache.Get(entry))
+        return true;
+
     CPubKey pubkeyFromSig;
     if(!pubkeyFromSig.RecoverCompact(hash, vchSig)) {
         strErrorRet = "Error recovering public key.";
@@ -69,5 +159,30 @@ bool CHashSigner::VerifyHash(const uint256& hash, const CKeyID& keyID, const std
         return false;
     }
 
+    messageSignatureCache.Set(entry);
+    return true;
+}
+
+void CHashSigner::VerifyHashes(std::vector<CHashSignatureCheck>& vChecks)
+{
+    if(nScriptCheckThreads == 0 || vChecks.size() < 2)
+        return;
+
+    LOCK(cs_hashsignaturequeue);
+    CCheckQueueControl<CHashSignatureCheck> control(&hashsignaturequeue);
+    control.Add(vChecks);
+    control.Wait();
+}
+
+bool CHashSignatureCheck::operator()()
+{
+    std::string strError;
+    CHashSigner::VerifyHash(hash, keyID, vchSig, strError);
     return true;
 }
+
+void ThreadHashSignatureCheck()
+{
+    RenameThread("securetag-msgsig");
+    hashsignaturequeue.Thread();
+}
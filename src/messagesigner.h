@@ -22,6 +22,34 @@ public:
     static bool VerifyMessage(const CKeyID& keyID, const std::vector<unsigned char>& vchSig, const std::string& strMessage, std::string& strErrorRet);
 };
 
+/** Maximum size of the cache of valid message signatures, in MiB */
+static const unsigned int MAX_MESSAGE_SIG_CACHE_SIZE = 8;
+
+/** Closure checking one hash signature on the message signature check threads.
+ *  Valid signatures end up in the message signature cache, so the result is
+ *  not reported: the message is checked again, from the cache, when processed.
+ */
+class CHashSignatureCheck
+{
+private:
+    uint256 hash;
+    CKeyID keyID;
+    std::vector<unsigned char> vchSig;
+
+public:
+    CHashSignatureCheck() {}
+    CHashSignatureCheck(const uint256& hashIn, const CKeyID& keyIDIn, const std::vector<unsigned char>& vchSigIn) :
+        hash(hashIn), keyID(keyIDIn), vchSig(vchSigIn) {}
+
+    bool operator()();
+
+    void swap(CHashSignatureCheck& check) {
+        std::swap(hash, check.hash);
+        std::swap(keyID, check.keyID);
+        vchSig.swap(check.vchSig);
+    }
+};
+
 /** Helper class for signing hashes and checking their signatures
  */
 class CHashSigner
@@ -33,6 +61,15 @@ public:
     static bool VerifyHash(const uint256& hash, const CPubKey& pubkey, const std::vector<unsigned char>& vchSig, std::string& strErrorRet);
     /// Verify the hash signature, returns true if succcessful
     static bool VerifyHash(const uint256& hash, const CKeyID& keyID, const std::vector<unsigned char>& vchSig, std::string& strErrorRet);
+    /// Verify a batch of hash signatures in parallel ahead of processing the messages they belong to
+    static void VerifyHashes(std::vector<CHashSignatureCheck>& vChecks);
 };
 
+/** Set up the message signature cache, must be called before any signature is verified */
+void InitMessageSignatureCache();
+/** Whether the signature of the hash by keyID is in the valid message signature cache */
+bool IsMessageSignatureCached(const uint256& hash, const CKeyID& keyID, const std::vector<unsigned char>& vchSig);
+/** Run a message signature check thread */
+void ThreadHashSignatureCheck();
+
 #endif
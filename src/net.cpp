@@ -47,6 +47,13 @@
 
 #include <math.h>
 
+/** How long the socket handler waits for socket events when there is nothing to do */
+static const int SELECT_TIMEOUT_MILLISECONDS = 50;
+#ifdef USE_EPOLL
+/** Maximum number of events taken from epoll per iteration of the socket handler */
+static const int MAX_SOCKET_EVENTS = 1024;
+#endif
+
 // Dump addresses to peers.dat and banlist.dat every 15 minutes (900s)
 #define DUMP_ADDRESSES_INTERVAL 900
 
@@ -86,6 +93,8 @@ std::map<CNetAddr, LocalServiceInfo> mapLocalHost;
 static bool vfLimited[NET_MAX] = {};
 std::string strSubVersion;
 
+// AskFor is called by several message handler threads
+CCriticalSection cs_mapAlreadyAskedFor;
 limitedmap<uint256, int64_t> mapAlreadyAskedFor(MAX_INV_SZ);
 
 // Signals for message handling
@@ -707,7 +716,7 @@ bool CNode::ReceiveMsgBytes(const char *pch, unsigned int nBytes, bool& complete
         // get current incomplete message, or create a new one
         if (vRecvMsg.empty() ||
             vRecvMsg.back().complete())
-            vRecvMsg.push_back(CNetMessage(Params().MessageStart(), SER_NETWORK, INIT_PROTO_VERSION));
+            recvMsgPool.Take(vRecvMsg);
 
         CNetMessage& msg = vRecvMsg.back();
 
@@ -830,6 +839,53 @@ const uint256& CNetMessage::GetMessageHash() const
     return data_hash;
 }
 
+void CNetMessage::Reset(const CMessageHeader::MessageStartChars& pchMessageStartIn)
+{
+    hasher.Reset();
+    data_hash.SetNull();
+    in_data = false;
+    hdrbuf.clear();
+    hdrbuf.resize(24);
+    hdr = CMessageHeader(pchMessageStartIn);
+    nHdrPos = 0;
+    if (vRecv.capacity() > MAX_POOLED_RECV_BUFFER)
+        vRecv = CDataStream(SER_NETWORK, INIT_PROTO_VERSION);
+    else
+        vRecv.clear();
+    nDataPos = 0;
+    nTime = 0;
+    SetVersion(INIT_PROTO_VERSION);
+}
+
+void CNetMessagePool::Take(std::list<CNetMessage>& msgs)
+{
+    {
+        LOCK(cs);
+        if (!vFree.empty()) {
+            msgs.splice(msgs.end(), vFree, vFree.begin());
+            return;
+        }
+    }
+    msgs.push_back(CNetMessage(Params().MessageStart(), SER_NETWORK, INIT_PROTO_VERSION));
+}
+
+void CNetMessagePool::Give(std::list<CNetMessage>& msgs)
+{
+    for (CNetMessage& msg : msgs)
+        msg.Reset(Params().MessageStart());
+
+    LOCK(cs);
+    vFree.splice(vFree.end(), msgs);
+    while (vFree.size() > MAX_POOLED_RECV_MSGS)
+        vFree.pop_back();
+}
+
+size_t CNetMessagePool::size()
+{
+    LOCK(cs);
+    return vFree.size();
+}
+
 
 
 
@@ -845,7 +901,7 @@ size_t CConnman::SocketSendData(CNode *pnode) const
     size_t nSentSize = 0;
 
     while (it != pnode->vSendMsg.end()) {
-        const auto &data = *it;
+        const auto &data = **it;
         assert(data.size() > pnode->nSendOffset);
         int nBytes = 0;
         {
@@ -1120,15 +1176,428 @@ void CConnman::AcceptConnection(const ListenSocket& hListenSocket) {
 
     LogPrint("net", "connection from %s accepted\n", addr.ToString());
 
+    AddNodeToVector(pnode);
+}
+
+void CConnman::AddNodeToVector(CNode* pnode)
+{
+#ifdef USE_EPOLL
+    if (epollfd != -1) {
+        // Edge-triggered: the socket handler keeps the readiness in the node
+        // until recv()/send() would block
+        struct epoll_event event;
+        event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+        event.data.ptr = pnode;
+        if (epoll_ctl(epollfd, EPOLL_CTL_ADD, pnode->hSocket, &event) != 0) {
+            LogPrintf("epoll_ctl failed for peer=%d: %s\n", pnode->id, NetworkErrorString(WSAGetLastError()));
+            pnode->fDisconnect = true;
+        }
+    }
+#endif
+    LOCK(cs_vNodes);
+    vNodes.push_back(pnode);
+}
+
+#ifdef USE_EPOLL
+void CConnman::SocketEventsEpoll(std::set<SOCKET>& setListenReady, std::set<CNode*>& setRecvReady, std::set<CNode*>& setSendReady, bool fWait)
+{
+    struct epoll_event events[MAX_SOCKET_EVENTS];
+    int nEvents = epoll_wait(epollfd, events, MAX_SOCKET_EVENTS, fWait ? SELECT_TIMEOUT_MILLISECONDS : 0);
+    if (interruptNet)
+        return;
+
+    if (nEvents < 0) {
+        int nErr = WSAGetLastError();
+        if (nErr != WSAEINTR) {
+            LogPrintf("socket epoll error %s\n", NetworkErrorString(nErr));
+            interruptNet.sleep_for(std::chrono::milliseconds(SELECT_TIMEOUT_MILLISECONDS));
+        }
+        return;
+    }
+
+    for (int i = 0; i < nEvents; i++) {
+        CNode* pnode = static_cast<CNode*>(events[i].data.ptr);
+        if (pnode == NULL) {
+            // One of the listening sockets, accepting on the others just returns nothing
+            BOOST_FOREACH(const ListenSocket& hListenSocket, vhListenSocket)
+                setListenReady.insert(hListenSocket.socket);
+            continue;
+        }
+        // Errors and hang-ups are picked up by the next recv()
+        if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLERR | EPOLLHUP))
+            setRecvReady.insert(pnode);
+        if (events[i].events & EPOLLOUT)
+            setSendReady.insert(pnode);
+    }
+}
+#endif
+
+#ifdef USE_POLL
+void CConnman::SocketEventsPoll(std::set<SOCKET>& setListenReady, std::set<CNode*>& setRecvReady, std::set<CNode*>& setSendReady, bool fWait)
+{
+    std::vector<struct pollfd> vpollfd;
+    std::vector<CNode*> vpollNodes;
+
+    BOOST_FOREACH(const ListenSocket& hListenSocket, vhListenSocket) {
+        struct pollfd pfd;
+        pfd.fd = hListenSocket.socket;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        vpollfd.push_back(pfd);
+        vpollNodes.push_back(NULL);
+    }
+
     {
         LOCK(cs_vNodes);
-        vNodes.push_back(pnode);
+        BOOST_FOREACH(CNode* pnode, vNodes)
+        {
+            // Same interest as with select(), see SocketEventsSelect()
+            bool select_recv = !pnode->fPauseRecv;
+            bool select_send;
+            {
+                LOCK(pnode->cs_vSend);
+                select_send = !pnode->vSendMsg.empty();
+            }
+
+            LOCK(pnode->cs_hSocket);
+            if (pnode->hSocket == INVALID_SOCKET)
+                continue;
+
+            struct pollfd pfd;
+            pfd.fd = pnode->hSocket;
+            pfd.events = select_send ? POLLOUT : (select_recv ? POLLIN : 0);
+            pfd.revents = 0;
+            vpollfd.push_back(pfd);
+            vpollNodes.push_back(pnode);
+        }
+    }
+
+    int nResult = poll(vpollfd.data(), vpollfd.size(), fWait ? SELECT_TIMEOUT_MILLISECONDS : 0);
+    if (interruptNet)
+        return;
+
+    if (nResult < 0) {
+        int nErr = WSAGetLastError();
+        if (nErr != WSAEINTR) {
+            LogPrintf("socket poll error %s\n", NetworkErrorString(nErr));
+            interruptNet.sleep_for(std::chrono::milliseconds(SELECT_TIMEOUT_MILLISECONDS));
+        }
+        return;
+    }
+
+    for (size_t i = 0; i < vpollfd.size(); i++) {
+        if (vpollfd[i].revents == 0)
+            continue;
+        if (vpollNodes[i] == NULL) {
+            setListenReady.insert(vpollfd[i].fd);
+            continue;
+        }
+        if (vpollfd[i].revents & (POLLIN | POLLERR | POLLHUP))
+            setRecvReady.insert(vpollNodes[i]);
+        if (vpollfd[i].revents & POLLOUT)
+            setSendReady.insert(vpollNodes[i]);
+    }
+}
+#else
+void CConnman::SocketEventsSelect(std::set<SOCKET>& setListenReady, std::set<CNode*>& setRecvReady, std::set<CNode*>& setSendReady, bool fWait)
+{
+    struct timeval timeout;
+    timeout.tv_sec  = 0;
+    timeout.tv_usec = fWait ? SELECT_TIMEOUT_MILLISECONDS * 1000 : 0;
+
+    fd_set fdsetRecv;
+    fd_set fdsetSend;
+    fd_set fdsetError;
+    FD_ZERO(&fdsetRecv);
+    FD_ZERO(&fdsetSend);
+    FD_ZERO(&fdsetError);
+    SOCKET hSocketMax = 0;
+    bool have_fds = false;
+    std::map<SOCKET, CNode*> mapSocketNodes;
+
+    BOOST_FOREACH(const ListenSocket& hListenSocket, vhListenSocket) {
+        FD_SET(hListenSocket.socket, &fdsetRecv);
+        hSocketMax = std::max(hSocketMax, hListenSocket.socket);
+        have_fds = true;
+    }
+
+    {
+        LOCK(cs_vNodes);
+        BOOST_FOREACH(CNode* pnode, vNodes)
+        {
+            // Implement the following logic:
+            // * If there is data to send, select() for sending data. As this only
+            //   happens when optimistic write failed, we choose to first drain the
+            //   write buffer in this case before receiving more. This avoids
+            //   needlessly queueing received data, if the remote peer is not themselves
+            //   receiving data. This means properly utilizing TCP flow control signalling.
+            // * Otherwise, if there is space left in the receive buffer, select() for
+            //   receiving data.
+            // * Hand off all complete messages to the processor, to be handled without
+            //   blocking here.
+
+            bool select_recv = !pnode->fPauseRecv;
+            bool select_send;
+            {
+                LOCK(pnode->cs_vSend);
+                select_send = !pnode->vSendMsg.empty();
+            }
+
+            LOCK(pnode->cs_hSocket);
+            if (pnode->hSocket == INVALID_SOCKET)
+                continue;
+
+            FD_SET(pnode->hSocket, &fdsetError);
+            hSocketMax = std::max(hSocketMax, pnode->hSocket);
+            have_fds = true;
+            mapSocketNodes[pnode->hSocket] = pnode;
+
+            if (select_send) {
+                FD_SET(pnode->hSocket, &fdsetSend);
+                continue;
+            }
+            if (select_recv) {
+                FD_SET(pnode->hSocket, &fdsetRecv);
+            }
+        }
+    }
+
+    int nSelect = select(have_fds ? hSocketMax + 1 : 0,
+                         &fdsetRecv, &fdsetSend, &fdsetError, &timeout);
+    if (interruptNet)
+        return;
+
+    if (nSelect == SOCKET_ERROR)
+    {
+        if (have_fds)
+        {
+            int nErr = WSAGetLastError();
+            LogPrintf("socket select error %s\n", NetworkErrorString(nErr));
+        }
+        interruptNet.sleep_for(std::chrono::milliseconds(SELECT_TIMEOUT_MILLISECONDS));
+        return;
+    }
+
+    BOOST_FOREACH(const ListenSocket& hListenSocket, vhListenSocket)
+        if (FD_ISSET(hListenSocket.socket, &fdsetRecv))
+            setListenReady.insert(hListenSocket.socket);
+
+    for (std::map<SOCKET, CNode*>::iterator it = mapSocketNodes.begin(); it != mapSocketNodes.end(); ++it) {
+        if (FD_ISSET(it->first, &fdsetRecv) || FD_ISSET(it->first, &fdsetError))
+            setRecvReady.insert(it->second);
+        if (FD_ISSET(it->first, &fdsetSend))
+            setSendReady.insert(it->second);
+    }
+}
+#endif
+
+void CConnman::SocketEvents(std::set<SOCKET>& setListenReady, std::set<CNode*>& setRecvReady, std::set<CNode*>& setSendReady, bool fWait)
+{
+#ifdef USE_EPOLL
+    if (epollfd != -1) {
+        SocketEventsEpoll(setListenReady, setRecvReady, setSendReady, fWait);
+        return;
+    }
+#endif
+#ifdef USE_POLL
+    SocketEventsPoll(setListenReady, setRecvReady, setSendReady, fWait);
+#else
+    SocketEventsSelect(setListenReady, setRecvReady, setSendReady, fWait);
+#endif
+}
+
+void CConnman::SocketRecvData(CNode* pnode)
+{
+    // typical socket buffer is 8K-64K
+    char pchBuf[0x10000];
+    int nBytes = 0;
+    {
+        LOCK(pnode->cs_hSocket);
+        if (pnode->hSocket == INVALID_SOCKET) {
+            pnode->fHasRecvData = false;
+            return;
+        }
+        nBytes = recv(pnode->hSocket, pchBuf, sizeof(pchBuf), MSG_DONTWAIT);
+    }
+    if (nBytes > 0)
+    {
+        bool notify = false;
+        if (!pnode->ReceiveMsgBytes(pchBuf, nBytes, notify))
+            pnode->CloseSocketDisconnect();
+        RecordBytesRecv(nBytes);
+        if (notify) {
+            size_t nSizeAdded = 0;
+            auto it(pnode->vRecvMsg.begin());
+            for (; it != pnode->vRecvMsg.end(); ++it) {
+                if (!it->complete())
+                    break;
+                nSizeAdded += it->vRecv.size() + CMessageHeader::HEADER_SIZE;
+            }
+            {
+                LOCK(pnode->cs_vProcessMsg);
+                pnode->vProcessMsg.splice(pnode->vProcessMsg.end(), pnode->vRecvMsg, pnode->vRecvMsg.begin(), it);
+                pnode->nProcessQueueSize += nSizeAdded;
+                pnode->fPauseRecv = pnode->nProcessQueueSize > nReceiveFloodSize;
+            }
+            WakeMessageHandler();
+        }
+    }
+    else if (nBytes == 0)
+    {
+        // socket closed gracefully
+        if (!pnode->fDisconnect)
+            LogPrint("net", "socket closed\n");
+        pnode->CloseSocketDisconnect();
+        pnode->fHasRecvData = false;
+    }
+    else if (nBytes < 0)
+    {
+        // error
+        int nErr = WSAGetLastError();
+        if (nErr != WSAEWOULDBLOCK && nErr != WSAEMSGSIZE && nErr != WSAEINTR && nErr != WSAEINPROGRESS)
+        {
+            if (!pnode->fDisconnect)
+                LogPrintf("socket recv error %s\n", NetworkErrorString(nErr));
+            pnode->CloseSocketDisconnect();
+            pnode->fHasRecvData = false;
+        }
+        else if (nErr == WSAEWOULDBLOCK)
+        {
+            pnode->fHasRecvData = false;
+        }
+    }
+}
+
+void CConnman::InactivityCheck(CNode* pnode)
+{
+    int64_t nTime = GetSystemTimeInSeconds();
+    if (nTime - pnode->nTimeConnected > 60)
+    {
+        if (pnode->nLastRecv == 0 || pnode->nLastSend == 0)
+        {
+            LogPrint("net", "socket no message in first 60 seconds, %d %d from %d\n", pnode->nLastRecv != 0, pnode->nLastSend != 0, pnode->id);
+            pnode->fDisconnect = true;
+        }
+        else if (nTime - pnode->nLastSend > TIMEOUT_INTERVAL)
+        {
+            LogPrintf("socket sending timeout: %is\n", nTime - pnode->nLastSend);
+            pnode->fDisconnect = true;
+        }
+        else if (nTime - pnode->nLastRecv > (pnode->nVersion > BIP0031_VERSION ? TIMEOUT_INTERVAL : 90*60))
+        {
+            LogPrintf("socket receive timeout: %is\n", nTime - pnode->nLastRecv);
+            pnode->fDisconnect = true;
+        }
+        else if (pnode->nPingNonceSent && pnode->nPingUsecStart + TIMEOUT_INTERVAL * 1000000 < GetTimeMicros())
+        {
+            LogPrintf("ping timeout: %fs\n", 0.000001 * (GetTimeMicros() - pnode->nPingUsecStart));
+            pnode->fDisconnect = true;
+        }
+        else if (!pnode->fSuccessfullyConnected)
+        {
+            LogPrintf("version handshake timeout from %d\n", pnode->id);
+            pnode->fDisconnect = true;
+        }
+    }
+}
+
+void CConnman::ServiceSockets(std::set<CNode*>& setNodesPending)
+{
+    //
+    // Find which sockets are ready, don't wait if a node can still make progress
+    //
+    bool fMoreWork = false;
+    BOOST_FOREACH(CNode* pnode, setNodesPending)
+    {
+        bool fSendData;
+        {
+            LOCK(pnode->cs_vSend);
+            fSendData = !pnode->vSendMsg.empty();
+        }
+        if (fSendData ? pnode->fCanSendData.load() : (pnode->fHasRecvData && !pnode->fPauseRecv)) {
+            fMoreWork = true;
+            break;
+        }
+    }
+
+    std::set<SOCKET> setListenReady;
+    std::set<CNode*> setRecvReady;
+    std::set<CNode*> setSendReady;
+    SocketEvents(setListenReady, setRecvReady, setSendReady, !fMoreWork);
+    if (interruptNet)
+        return;
+
+    //
+    // Accept new connections
+    //
+    BOOST_FOREACH(const ListenSocket& hListenSocket, vhListenSocket)
+    {
+        if (hListenSocket.socket != INVALID_SOCKET && setListenReady.count(hListenSocket.socket))
+        {
+            AcceptConnection(hListenSocket);
+        }
+    }
+
+    BOOST_FOREACH(CNode* pnode, setRecvReady) {
+        pnode->fHasRecvData = true;
+        setNodesPending.insert(pnode);
+    }
+    BOOST_FOREACH(CNode* pnode, setSendReady) {
+        pnode->fCanSendData = true;
+        setNodesPending.insert(pnode);
+    }
+
+    //
+    // Service each socket with readiness left. As with select(), the send
+    // buffer is drained before receiving more so TCP flow control does its job.
+    //
+    for (std::set<CNode*>::iterator it = setNodesPending.begin(); it != setNodesPending.end(); )
+    {
+        if (interruptNet)
+            return;
+
+        CNode* pnode = *it;
+
+        //
+        // Send
+        //
+        bool fSendData;
+        {
+            LOCK(pnode->cs_vSend);
+            if (!pnode->vSendMsg.empty() && pnode->fCanSendData) {
+                size_t nBytes = SocketSendData(pnode);
+                if (nBytes) {
+                    RecordBytesSent(nBytes);
+                } else {
+                    // Wait for the socket to become writable again
+                    pnode->fCanSendData = false;
+                }
+            }
+            fSendData = !pnode->vSendMsg.empty();
+        }
+
+        //
+        // Receive
+        //
+        if (!fSendData && pnode->fHasRecvData && !pnode->fPauseRecv)
+            SocketRecvData(pnode);
+
+        // Readiness isn't reported again until it was used up, so keep the
+        // node around while it has data to read or to send
+        if (pnode->fHasRecvData || (fSendData && pnode->fCanSendData))
+            ++it;
+        else
+            setNodesPending.erase(it++);
     }
 }
 
 void CConnman::ThreadSocketHandler()
 {
     unsigned int nPrevNodeCount = 0;
+    int64_t nLastInactivityCheck = 0;
+    // Nodes with socket readiness left to act on. Only this thread deletes
+    // nodes and it drops them from here when they get disconnected.
+    std::set<CNode*> setNodesPending;
     while (!interruptNet)
     {
         //
@@ -1147,6 +1616,7 @@ void CConnman::ThreadSocketHandler()
 
                     // remove from vNodes
                     vNodes.erase(remove(vNodes.begin(), vNodes.end(), pnode), vNodes.end());
+                    setNodesPending.erase(pnode);
 
                     // release outbound grant (if any)
                     pnode->grantOutbound.Release();
@@ -1196,226 +1666,20 @@ void CConnman::ThreadSocketHandler()
                 clientInterface->NotifyNumConnectionsChanged(nPrevNodeCount);
         }
 
-        //
-        // Find which sockets have data to receive
-        //
-        struct timeval timeout;
-        timeout.tv_sec  = 0;
-        timeout.tv_usec = 50000; // frequency to poll pnode->vSend
-
-        fd_set fdsetRecv;
-        fd_set fdsetSend;
-        fd_set fdsetError;
-        FD_ZERO(&fdsetRecv);
-        FD_ZERO(&fdsetSend);
-        FD_ZERO(&fdsetError);
-        SOCKET hSocketMax = 0;
-        bool have_fds = false;
-
-        BOOST_FOREACH(const ListenSocket& hListenSocket, vhListenSocket) {
-            FD_SET(hListenSocket.socket, &fdsetRecv);
-            hSocketMax = std::max(hSocketMax, hListenSocket.socket);
-            have_fds = true;
-        }
-
-        {
-            LOCK(cs_vNodes);
-            BOOST_FOREACH(CNode* pnode, vNodes)
-            {
-                // Implement the following logic:
-                // * If there is data to send, select() for sending data. As this only
-                //   happens when optimistic write failed, we choose to first drain the
-                //   write buffer in this case before receiving more. This avoids
-                //   needlessly queueing received data, if the remote peer is not themselves
-                //   receiving data. This means properly utilizing TCP flow control signalling.
-                // * Otherwise, if there is space left in the receive buffer, select() for
-                //   receiving data.
-                // * Hand off all complete messages to the processor, to be handled without
-                //   blocking here.
-
-                bool select_recv = !pnode->fPauseRecv;
-                bool select_send;
-                {
-                    LOCK(pnode->cs_vSend);
-                    select_send = !pnode->vSendMsg.empty();
-                }
-
-                LOCK(pnode->cs_hSocket);
-                if (pnode->hSocket == INVALID_SOCKET)
-                    continue;
-
-                FD_SET(pnode->hSocket, &fdsetError);
-                hSocketMax = std::max(hSocketMax, pnode->hSocket);
-                have_fds = true;
-
-                if (select_send) {
-                    FD_SET(pnode->hSocket, &fdsetSend);
-                    continue;
-                }
-                if (select_recv) {
-                    FD_SET(pnode->hSocket, &fdsetRecv);
-                }
-            }
-        }
-
-        int nSelect = select(have_fds ? hSocketMax + 1 : 0,
-                             &fdsetRecv, &fdsetSend, &fdsetError, &timeout);
+        ServiceSockets(setNodesPending);
         if (interruptNet)
             return;
 
-        if (nSelect == SOCKET_ERROR)
-        {
-            if (have_fds)
-            {
-                int nErr = WSAGetLastError();
-                LogPrintf("socket select error %s\n", NetworkErrorString(nErr));
-                for (unsigned int i = 0; i <= hSocketMax; i++)
-                    FD_SET(i, &fdsetRecv);
-            }
-            FD_ZERO(&fdsetSend);
-            FD_ZERO(&fdsetError);
-            if (!interruptNet.sleep_for(std::chrono::milliseconds(timeout.tv_usec/1000)))
-                return;
-        }
-
-        //
-        // Accept new connections
-        //
-        BOOST_FOREACH(const ListenSocket& hListenSocket, vhListenSocket)
-        {
-            if (hListenSocket.socket != INVALID_SOCKET && FD_ISSET(hListenSocket.socket, &fdsetRecv))
-            {
-                AcceptConnection(hListenSocket);
-            }
-        }
-
         //
-        // Service each socket
+        // Inactivity checking
         //
-        std::vector<CNode*> vNodesCopy = CopyNodeVector();
-        BOOST_FOREACH(CNode* pnode, vNodesCopy)
-        {
-            if (interruptNet)
-                return;
-
-            //
-            // Receive
-            //
-            bool recvSet = false;
-            bool sendSet = false;
-            bool errorSet = false;
-            {
-                LOCK(pnode->cs_hSocket);
-                if (pnode->hSocket == INVALID_SOCKET)
-                    continue;
-                recvSet = FD_ISSET(pnode->hSocket, &fdsetRecv);
-                sendSet = FD_ISSET(pnode->hSocket, &fdsetSend);
-                errorSet = FD_ISSET(pnode->hSocket, &fdsetError);
-            }
-            if (recvSet || errorSet)
-            {
-                {
-                    {
-                        // typical socket buffer is 8K-64K
-                        char pchBuf[0x10000];
-                        int nBytes = 0;
-                        {
-                            LOCK(pnode->cs_hSocket);
-                            if (pnode->hSocket == INVALID_SOCKET)
-                                continue;
-                            nBytes = recv(pnode->hSocket, pchBuf, sizeof(pchBuf), MSG_DONTWAIT);
-                        }
-                        if (nBytes > 0)
-                        {
-                            bool notify = false;
-                            if (!pnode->ReceiveMsgBytes(pchBuf, nBytes, notify))
-                                pnode->CloseSocketDisconnect();
-                            RecordBytesRecv(nBytes);
-                            if (notify) {
-                                size_t nSizeAdded = 0;
-                                auto it(pnode->vRecvMsg.begin());
-                                for (; it != pnode->vRecvMsg.end(); ++it) {
-                                    if (!it->complete())
-                                        break;
-                                    nSizeAdded += it->vRecv.size() + CMessageHeader::HEADER_SIZE;
-                                }
-                                {
-                                    LOCK(pnode->cs_vProcessMsg);
-                                    pnode->vProcessMsg.splice(pnode->vProcessMsg.end(), pnode->vRecvMsg, pnode->vRecvMsg.begin(), it);
-                                    pnode->nProcessQueueSize += nSizeAdded;
-                                    pnode->fPauseRecv = pnode->nProcessQueueSize > nReceiveFloodSize;
-                                }
-                                WakeMessageHandler();
-                            }
-                        }
-                        else if (nBytes == 0)
-                        {
-                            // socket closed gracefully
-                            if (!pnode->fDisconnect)
-                                LogPrint("net", "socket closed\n");
-                            pnode->CloseSocketDisconnect();
-                        }
-                        else if (nBytes < 0)
-                        {
-                            // error
-                            int nErr = WSAGetLastError();
-                            if (nErr != WSAEWOULDBLOCK && nErr != WSAEMSGSIZE && nErr != WSAEINTR && nErr != WSAEINPROGRESS)
-                            {
-                                if (!pnode->fDisconnect)
-                                    LogPrintf("socket recv error %s\n", NetworkErrorString(nErr));
-                                pnode->CloseSocketDisconnect();
-                            }
-                        }
-                    }
-                }
-            }
-
-            //
-            // Send
-            //
-            if (sendSet)
-            {
-                LOCK(pnode->cs_vSend);
-                size_t nBytes = SocketSendData(pnode);
-                if (nBytes) {
-                    RecordBytesSent(nBytes);
-                }
-            }
-
-            //
-            // Inactivity checking
-            //
-            int64_t nTime = GetSystemTimeInSeconds();
-            if (nTime - pnode->nTimeConnected > 60)
-            {
-                if (pnode->nLastRecv == 0 || pnode->nLastSend == 0)
-                {
-                    LogPrint("net", "socket no message in first 60 seconds, %d %d from %d\n", pnode->nLastRecv != 0, pnode->nLastSend != 0, pnode->id);
-                    pnode->fDisconnect = true;
-                }
-                else if (nTime - pnode->nLastSend > TIMEOUT_INTERVAL)
-                {
-                    LogPrintf("socket sending timeout: %is\n", nTime - pnode->nLastSend);
-                    pnode->fDisconnect = true;
-                }
-                else if (nTime - pnode->nLastRecv > (pnode->nVersion > BIP0031_VERSION ? TIMEOUT_INTERVAL : 90*60))
-                {
-                    LogPrintf("socket receive timeout: %is\n", nTime - pnode->nLastRecv);
-                    pnode->fDisconnect = true;
-                }
-                else if (pnode->nPingNonceSent && pnode->nPingUsecStart + TIMEOUT_INTERVAL * 1000000 < GetTimeMicros())
-                {
-                    LogPrintf("ping timeout: %fs\n", 0.000001 * (GetTimeMicros() - pnode->nPingUsecStart));
-                    pnode->fDisconnect = true;
-                }
-                else if (!pnode->fSuccessfullyConnected)
-                {
-                    LogPrintf("version handshake timeout from %d\n", pnode->id);
-                    pnode->fDisconnect = true;
-                }
-            }
+        if (GetSystemTimeInSeconds() != nLastInactivityCheck) {
+            nLastInactivityCheck = GetSystemTimeInSeconds();
+            std::vector<CNode*> vNodesCopy = CopyNodeVector();
+            BOOST_FOREACH(CNode* pnode, vNodesCopy)
+                InactivityCheck(pnode);
+            ReleaseNodeVector(vNodesCopy);
         }
-        ReleaseNodeVector(vNodesCopy);
     }
 }
 
@@ -2073,10 +2337,7 @@ bool CConnman::OpenNetworkConnection(const CAddress& addrConnect, bool fCountFai
         pnode->fFundamentalnode = true;
 
     GetNodeSignals().InitializeNode(pnode, *this);
-    {
-        LOCK(cs_vNodes);
-        vNodes.push_back(pnode);
-    }
+    AddNodeToVector(pnode);
 
     return true;
 }
@@ -2102,19 +2363,34 @@ void CConnman::ThreadMessageHandler()
             if (pnode->fDisconnect)
                 continue;
 
+            // Skip nodes another message handler thread is working on
+            bool fInProcessing = false;
+            if (!pnode->fInMessageProcessing.compare_exchange_strong(fInProcessing, true))
+                continue;
+
             // Receive messages
             bool fMoreNodeWork = GetNodeSignals().ProcessMessages(pnode, *this, flagInterruptMsgProc);
             fMoreWork |= (fMoreNodeWork && !pnode->fPauseSend);
-            if (flagInterruptMsgProc)
+            if (flagInterruptMsgProc) {
+                pnode->fInMessageProcessing = false;
                 return;
+            }
 
             // Send messages
             {
                 LOCK(pnode->cs_sendProcessing);
                 GetNodeSignals().SendMessages(pnode, *this, flagInterruptMsgProc);
             }
+            pnode->fInMessageProcessing = false;
             if (flagInterruptMsgProc)
                 return;
+
+            // A thread woken for messages that arrived meanwhile skipped this
+            // node while we held it, so look again instead of sleeping on them
+            {
+                LOCK(pnode->cs_vProcessMsg);
+                fMoreWork |= (!pnode->vProcessMsg.empty() && !pnode->fPauseSend);
+            }
         }
 
         ReleaseNodeVector(vNodesCopy);
@@ -2312,6 +2588,7 @@ CConnman::CConnman(uint64_t nSeed0In, uint64_t nSeed1In) :
     nLastNodeId = 0;
     nSendBufferMaxSize = 0;
     nReceiveFloodSize = 0;
+    nMessageHandlerThreads = 1;
     semOutbound = NULL;
     semAddnode = NULL;
     semMasternodeOutbound = NULL;
@@ -2322,6 +2599,9 @@ CConnman::CConnman(uint64_t nSeed0In, uint64_t nSeed1In) :
     nBestHeight = 0;
     clientInterface = NULL;
     flagInterruptMsgProc = false;
+#ifdef USE_EPOLL
+    epollfd = -1;
+#endif
 }
 
 NodeId CConnman::GetNewNodeId()
@@ -2345,6 +2625,7 @@ bool CConnman::Start(CScheduler& scheduler, std::string& strNodeError, Options c
 
     nSendBufferMaxSize = connOptions.nSendBufferMaxSize;
     nReceiveFloodSize = connOptions.nReceiveFloodSize;
+    nMessageHandlerThreads = std::max(1, std::min(connOptions.nMessageHandlerThreads, MAX_MSGHAND_THREADS));
 
     nMaxOutboundLimit = connOptions.nMaxOutboundLimit;
     nMaxOutboundTimeframe = connOptions.nMaxOutboundTimeframe;
@@ -2420,6 +2701,23 @@ bool CConnman::Start(CScheduler& scheduler, std::string& strNodeError, Options c
         fMsgProcWake = false;
     }
 
+#ifdef USE_EPOLL
+    epollfd = epoll_create1(EPOLL_CLOEXEC);
+    if (epollfd == -1) {
+        LogPrintf("epoll_create1 failed, falling back to poll(): %s\n", NetworkErrorString(WSAGetLastError()));
+    } else {
+        BOOST_FOREACH(const ListenSocket& hListenSocket, vhListenSocket) {
+            struct epoll_event event;
+            event.events = EPOLLIN;
+            event.data.ptr = NULL;
+            if (epoll_ctl(epollfd, EPOLL_CTL_ADD, hListenSocket.socket, &event) != 0) {
+                strNodeError = strprintf("epoll_ctl failed for listening socket: %s", NetworkErrorString(WSAGetLastError()));
+                return false;
+            }
+        }
+    }
+#endif
+
     // Send and receive from sockets, accept connections
     threadSocketHandler = std::thread(&TraceThread<std::function<void()> >, "net", std::function<void()>(std::bind(&CConnman::ThreadSocketHandler, this)));
 
@@ -2441,8 +2739,9 @@ bool CConnman::Start(CScheduler& scheduler, std::string& strNodeError, Options c
     // Initiate fundamentalnode connections
     threadOpenFundamentalnodeConnections = std::thread(&TraceThread<std::function<void()> >, "fncon", std::function<void()>(std::bind(&CConnman::ThreadOpenFundamentalnodeConnections, this)));
 
-    // Process messages
-    threadMessageHandler = std::thread(&TraceThread<std::function<void()> >, "msghand", std::function<void()>(std::bind(&CConnman::ThreadMessageHandler, this)));
+    // Process messages, each node is handled by one thread at a time
+    for (int i = 0; i < nMessageHandlerThreads; i++)
+        threadMessageHandlers.push_back(std::thread(&TraceThread<std::function<void()> >, "msghand", std::function<void()>(std::bind(&CConnman::ThreadMessageHandler, this))));
 
     // Dump network addresses
     scheduler.scheduleEvery(boost::bind(&CConnman::DumpData, this), DUMP_ADDRESSES_INTERVAL);
@@ -2511,8 +2810,10 @@ void CConnman::Interrupt()
 
 void CConnman::Stop()
 {
-    if (threadMessageHandler.joinable())
-        threadMessageHandler.join();
+    for (std::thread& threadMessageHandler : threadMessageHandlers)
+        if (threadMessageHandler.joinable())
+            threadMessageHandler.join();
+    threadMessageHandlers.clear();
     if (threadOpenMasternodeConnections.joinable())
         threadOpenMasternodeConnections.join();
     if (threadOpenFundamentalnodeConnections.joinable())
@@ -2550,6 +2851,12 @@ void CConnman::Stop()
     vNodes.clear();
     vNodesDisconnected.clear();
     vhListenSocket.clear();
+#ifdef USE_EPOLL
+    if (epollfd != -1) {
+        close(epollfd);
+        epollfd = -1;
+    }
+#endif
     delete semOutbound;
     semOutbound = NULL;
     delete semAddnode;
@@ -2907,6 +3214,9 @@ CNode::CNode(NodeId idIn, ServiceFlags nLocalServicesIn, int nMyStartingHeightIn
     nMinPingUsecTime = std::numeric_limits<int64_t>::max();
     fPauseRecv = false;
     fPauseSend = false;
+    fInMessageProcessing = false;
+    fHasRecvData = false;
+    fCanSendData = false;
     nProcessQueueSize = 0;
 
     BOOST_FOREACH(const std::string &msg, getAllNetMessageTypes())
@@ -2946,6 +3256,8 @@ void CNode::AskFor(const CInv& inv)
     if (!setAskFor.insert(inv.hash).second)
         return;
 
+    LOCK(cs_mapAlreadyAskedFor);
+
     // We're using mapAskFor as a priority queue,
     // the key is the earliest time the request can be sent
     int64_t nRequestTime;
@@ -2978,11 +3290,9 @@ bool CConnman::NodeFullyConnected(const CNode* pnode)
     return pnode && pnode->fSuccessfullyConnected && !pnode->fDisconnect;
 }
 
-void CConnman::PushMessage(CNode* pnode, CSerializedNetMsg&& msg)
+CSharedNetMsg CConnman::MakeSharedMsg(CSerializedNetMsg&& msg)
 {
     size_t nMessageSize = msg.data.size();
-    size_t nTotalSize = nMessageSize + CMessageHeader::HEADER_SIZE;
-    LogPrint("net", "sending %s (%d bytes) peer=%d\n",  SanitizeString(msg.command.c_str()), nMessageSize, pnode->id);
 
     std::vector<unsigned char> serializedHeader;
     serializedHeader.reserve(CMessageHeader::HEADER_SIZE);
@@ -2992,6 +3302,25 @@ void CConnman::PushMessage(CNode* pnode, CSerializedNetMsg&& msg)
 
     CVectorWriter{SER_NETWORK, INIT_PROTO_VERSION, serializedHeader, 0, hdr};
 
+    CSharedNetMsg sharedMsg;
+    sharedMsg.command = std::move(msg.command);
+    sharedMsg.header = std::make_shared<const std::vector<unsigned char>>(std::move(serializedHeader));
+    sharedMsg.data = std::make_shared<const std::vector<unsigned char>>(std::move(msg.data));
+    return sharedMsg;
+}
+
+void CConnman::PushMessage(CNode* pnode, CSerializedNetMsg&& msg)
+{
+    PushMessage(pnode, MakeSharedMsg(std::move(msg)));
+}
+
+void CConnman::PushMessage(CNode* pnode, const CSharedNetMsg& msg)
+{
+    assert(!msg.IsNull());
+    size_t nMessageSize = msg.data->size();
+    size_t nTotalSize = nMessageSize + CMessageHeader::HEADER_SIZE;
+    LogPrint("net", "sending %s (%d bytes) peer=%d\n",  SanitizeString(msg.command.c_str()), nMessageSize, pnode->id);
+
     size_t nBytesSent = 0;
     {
         LOCK(pnode->cs_vSend);
@@ -3003,9 +3332,9 @@ void CConnman::PushMessage(CNode* pnode, CSerializedNetMsg&& msg)
 
         if (pnode->nSendSize > nSendBufferMaxSize)
             pnode->fPauseSend = true;
-        pnode->vSendMsg.push_back(std::move(serializedHeader));
+        pnode->vSendMsg.push_back(msg.header);
         if (nMessageSize)
-            pnode->vSendMsg.push_back(std::move(msg.data));
+            pnode->vSendMsg.push_back(msg.data);
 
         // If write queue empty, attempt "optimistic write"
         if (optimisticSend == true)
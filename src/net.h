@@ -26,6 +26,7 @@
 #include <stdint.h>
 #include <thread>
 #include <memory>
+#include <set>
 #include <condition_variable>
 
 #ifndef WIN32
@@ -58,6 +59,10 @@ static const unsigned int MAX_INV_SZ = 50000;
 static const unsigned int MAX_ADDR_TO_SEND = 1000;
 /** Maximum length of incoming protocol messages (no message over 3 MiB is currently acceptable). */
 static const unsigned int MAX_PROTOCOL_MESSAGE_LENGTH = 3 * 1024 * 1024;
+/** Maximum number of processed messages kept per connection for receiving the next ones */
+static const size_t MAX_POOLED_RECV_MSGS = 16;
+/** Receive buffers up to this size are kept when a message is recycled, larger ones are released */
+static const size_t MAX_POOLED_RECV_BUFFER = 4 * 1024;
 /** Maximum length of strSubVer in `version` message */
 static const unsigned int MAX_SUBVERSION_LENGTH = 256;
 /** Maximum number of automatic outgoing nodes */
@@ -92,6 +97,10 @@ static const bool DEFAULT_BLOCKSONLY = false;
 static const bool DEFAULT_FORCEDNSSEED = false;
 static const size_t DEFAULT_MAXRECEIVEBUFFER = 5 * 1000;
 static const size_t DEFAULT_MAXSENDBUFFER    = 1 * 1000;
+/** Default number of threads processing messages, -msghandthreads */
+static const int DEFAULT_MSGHAND_THREADS = 4;
+/** Maximum number of threads processing messages */
+static const int MAX_MSGHAND_THREADS = 16;
 
 static const ServiceFlags REQUIRED_SERVICES = NODE_NETWORK;
 
@@ -125,6 +134,22 @@ struct CSerializedNetMsg
     std::string command;
 };
 
+/** Immutable payload or header bytes, shared by the send queues of all peers it goes to */
+typedef std::shared_ptr<const std::vector<unsigned char>> CSharedNetBuffer;
+
+/**
+ * A message serialized and checksummed once, which can be pushed to any number of
+ * peers. Only valid for peers using the send version it was serialized with.
+ */
+struct CSharedNetMsg
+{
+    std::string command;
+    CSharedNetBuffer header;
+    CSharedNetBuffer data;
+
+    bool IsNull() const { return !header; }
+};
+
 
 class CConnman
 {
@@ -149,6 +174,7 @@ public:
         CClientUIInterface* uiInterface = nullptr;
         unsigned int nSendBufferMaxSize = 0;
         unsigned int nReceiveFloodSize = 0;
+        int nMessageHandlerThreads = 1;
         uint64_t nMaxOutboundTimeframe = 0;
         uint64_t nMaxOutboundLimit = 0;
     };
@@ -206,6 +232,10 @@ public:
     bool IsFundamentalnodeOrDisconnectRequested(const CService& addr);
 
     void PushMessage(CNode* pnode, CSerializedNetMsg&& msg);
+    void PushMessage(CNode* pnode, const CSharedNetMsg& msg);
+
+    /** Build the header of a message so it can be queued for many peers without copying */
+    static CSharedNetMsg MakeSharedMsg(CSerializedNetMsg&& msg);
 
     template<typename Condition, typename Callable>
     bool ForEachNodeContinueIf(const Condition& cond, Callable&& func)
@@ -401,6 +431,8 @@ public:
 
     void WakeMessageHandler();
 private:
+    friend struct CConnmanTest;
+
     struct ListenSocket {
         SOCKET socket;
         bool whitelisted;
@@ -413,6 +445,21 @@ private:
     void ThreadOpenConnections();
     void ThreadMessageHandler();
     void AcceptConnection(const ListenSocket& hListenSocket);
+    void AddNodeToVector(CNode* pnode);
+    void SocketEvents(std::set<SOCKET>& setListenReady, std::set<CNode*>& setRecvReady, std::set<CNode*>& setSendReady, bool fWait);
+#ifdef USE_EPOLL
+    void SocketEventsEpoll(std::set<SOCKET>& setListenReady, std::set<CNode*>& setRecvReady, std::set<CNode*>& setSendReady, bool fWait);
+#endif
+#ifdef USE_POLL
+    void SocketEventsPoll(std::set<SOCKET>& setListenReady, std::set<CNode*>& setRecvReady, std::set<CNode*>& setSendReady, bool fWait);
+#else
+    void SocketEventsSelect(std::set<SOCKET>& setListenReady, std::set<CNode*>& setRecvReady, std::set<CNode*>& setSendReady, bool fWait);
+#endif
+    void SocketRecvData(CNode* pnode);
+    /** Wait for socket events and act on them. setNodesPending holds the nodes
+     *  with readiness left over, which edge-triggered events don't report again. */
+    void ServiceSockets(std::set<CNode*>& setNodesPending);
+    void InactivityCheck(CNode* pnode);
     void ThreadSocketHandler();
     void ThreadDNSAddressSeed();
     void ThreadOpenMasternodeConnections();
@@ -470,8 +517,14 @@ private:
 
     unsigned int nSendBufferMaxSize;
     unsigned int nReceiveFloodSize;
+    int nMessageHandlerThreads;
 
     std::vector<ListenSocket> vhListenSocket;
+#ifdef USE_EPOLL
+    // Nodes are registered edge-triggered with the node as event data, the
+    // listening sockets level-triggered without any
+    int epollfd;
+#endif
     std::atomic<bool> fNetworkActive;
     banmap_t setBanned;
     CCriticalSection cs_setBanned;
@@ -526,7 +579,7 @@ private:
     std::thread threadOpenConnections;
     std::thread threadOpenMasternodeConnections;
     std::thread threadOpenFundamentalnodeConnections;
-    std::thread threadMessageHandler;
+    std::vector<std::thread> threadMessageHandlers;
 };
 extern std::unique_ptr<CConnman> g_connman;
 void Discover(boost::thread_group& threadGroup);
@@ -593,6 +646,7 @@ extern bool fDiscover;
 extern bool fListen;
 extern bool fRelayTxes;
 
+extern CCriticalSection cs_mapAlreadyAskedFor;
 extern limitedmap<uint256, int64_t> mapAlreadyAskedFor;
 
 /** Subversion as sent to the P2P network in `version` messages */
@@ -679,6 +733,30 @@ public:
 
     int readHeader(const char *pch, unsigned int nBytes);
     int readData(const char *pch, unsigned int nBytes);
+
+    // Prepare for receiving the next message, keeping the buffers unless they grew large
+    void Reset(const CMessageHeader::MessageStartChars& pchMessageStartIn);
+};
+
+/**
+ * Received messages of a connection that are not in use. Completed messages travel as
+ * list nodes from the socket handler to the message handler and are given back here once
+ * processed, so assembling the next message reuses their node and buffers instead of
+ * allocating. Buffers larger than MAX_POOLED_RECV_BUFFER are released on the way back.
+ */
+class CNetMessagePool
+{
+public:
+    //! Append an empty message to msgs, recycled from the pool when possible
+    void Take(std::list<CNetMessage>& msgs);
+    //! Recycle all messages in msgs, up to MAX_POOLED_RECV_MSGS of them are kept
+    void Give(std::list<CNetMessage>& msgs);
+
+    size_t size();
+
+private:
+    CCriticalSection cs;
+    std::list<CNetMessage> vFree;
 };
 
 
@@ -694,13 +772,14 @@ public:
     size_t nSendSize; // total size of all vSendMsg entries
     size_t nSendOffset; // offset inside the first vSendMsg already sent
     uint64_t nSendBytes;
-    std::deque<std::vector<unsigned char>> vSendMsg;
+    std::deque<CSharedNetBuffer> vSendMsg;
     CCriticalSection cs_vSend;
     CCriticalSection cs_hSocket;
     CCriticalSection cs_vRecv;
 
     CCriticalSection cs_vProcessMsg;
     std::list<CNetMessage> vProcessMsg;
+    CNetMessagePool recvMsgPool;
     size_t nProcessQueueSize;
 
     CCriticalSection cs_sendProcessing;
@@ -753,6 +832,13 @@ public:
 
     std::atomic_bool fPauseRecv;
     std::atomic_bool fPauseSend;
+    // Claimed by the message handler thread processing this node's messages, so they
+    // are handled in order while other nodes are processed concurrently
+    std::atomic_bool fInMessageProcessing;
+    // Socket readiness as last reported to the socket handler, kept until
+    // recv()/send() reports that the operation would block
+    std::atomic_bool fHasRecvData;
+    std::atomic_bool fCanSendData;
 protected:
 
     mapMsgCmdSize mapSendBytesPerMsgCmd;
@@ -763,9 +849,13 @@ public:
     std::atomic<int> nStartingHeight;
 
     // flood relay
+    // Addresses are pushed by the message handler threads of other nodes too,
+    // vAddrToSend and addrKnown are protected by cs_addrSend
+    CCriticalSection cs_addrSend;
     std::vector<CAddress> vAddrToSend;
     CRollingBloomFilter addrKnown;
     bool fGetAddr;
+    // Alerts known to the node, protected by cs_mapAlerts
     std::set<uint256> setKnown;
     int64_t nNextAddrSend;
     int64_t nNextLocalAddrSend;
@@ -881,6 +971,7 @@ public:
 
     void AddAddressKnown(const CAddress& _addr)
     {
+        LOCK(cs_addrSend);
         addrKnown.insert(_addr.GetKey());
     }
 
@@ -889,6 +980,7 @@ public:
         // Known checking here is only to save space from duplicates.
         // SendMessages will filter it again for knowns that were added
         // after addresses were pushed.
+        LOCK(cs_addrSend);
         if (_addr.IsValid() && !addrKnown.contains(_addr.GetKey())) {
             if (vAddrToSend.size() >= MAX_ADDR_TO_SEND) {
                 vAddrToSend[insecure_rand.rand32() % vAddrToSend.size()] = _addr;
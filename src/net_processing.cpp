@@ -45,6 +45,8 @@
 #endif // ENABLE_WALLET
 #include "privatesend-server.h"
 
+#include <functional>
+
 #include <boost/thread.hpp>
 
 #if defined(NDEBUG)
@@ -138,6 +140,17 @@ namespace {
     MapRelay mapRelay;
     /** Expiration-time ordered list of (expire time, relay map entry) pairs, protected by cs_main). */
     std::deque<std::pair<int64_t, MapRelay::iterator>> vRelayExpiration;
+
+    /** Messages recently served for getdata, shared between peers with the same send version */
+    struct RelayMsg {
+        int64_t nRevision;
+        CSharedNetMsg msg;
+    };
+    /** Relay message map, protected by cs_main. */
+    typedef std::map<std::pair<CInv, int>, RelayMsg> MapRelayMsg;
+    MapRelayMsg mapRelayMsg;
+    /** Expiration-time ordered list of (expire time, relay message map entry) pairs, protected by cs_main. */
+    std::deque<std::pair<int64_t, MapRelayMsg::iterator>> vRelayMsgExpiration;
 } // anon namespace
 
 //////////////////////////////////////////////////////////////////////////////
@@ -714,6 +727,8 @@ unsigned int LimitOrphanTxSize(unsigned int nMaxOrphans) EXCLUSIVE_LOCKS_REQUIRE
 // Requires cs_main.
 void Misbehaving(NodeId pnode, int howmuch)
 {
+    AssertLockHeld(cs_main);
+
     if (howmuch == 0)
         return;
 
@@ -778,12 +793,12 @@ void PeerLogicValidation::SyncTransaction(const CTransaction& tx, const CBlockIn
 
 static CCriticalSection cs_most_recent_block;
 static std::shared_ptr<const CBlock> most_recent_block;
-static std::shared_ptr<const CBlockHeaderAndShortTxIDs> most_recent_compact_block;
+static CSharedNetMsg most_recent_compact_block_msg;
 static uint256 most_recent_block_hash;
 
 void PeerLogicValidation::NewPoWValidBlock(const CBlockIndex *pindex, const std::shared_ptr<const CBlock>& pblock) {
-    std::shared_ptr<const CBlockHeaderAndShortTxIDs> pcmpctblock = std::make_shared<const CBlockHeaderAndShortTxIDs> (*pblock);
-    const CNetMsgMaker msgMaker(PROTOCOL_VERSION);
+    CBlockHeaderAndShortTxIDs cmpctblock(*pblock);
+    const CSharedNetMsg msgCmpctBlock = CConnman::MakeSharedMsg(CNetMsgMaker(PROTOCOL_VERSION).Make(NetMsgType::CMPCTBLOCK, cmpctblock));
 
     LOCK(cs_main);
 
@@ -798,11 +813,10 @@ void PeerLogicValidation::NewPoWValidBlock(const CBlockIndex *pindex, const std:
         LOCK(cs_most_recent_block);
         most_recent_block_hash = hashBlock;
         most_recent_block = pblock;
-        most_recent_compact_block = pcmpctblock;
+        most_recent_compact_block_msg = msgCmpctBlock;
     }
 
-    connman->ForEachNode([this, &pcmpctblock, pindex, &msgMaker, &hashBlock](CNode* pnode) {
-        // TODO: Avoid the repeated-serialization here
+    connman->ForEachNode([this, &msgCmpctBlock, pindex, &hashBlock](CNode* pnode) {
         if (pnode->fDisconnect)
             return;
         ProcessBlockAvailability(pnode->GetId());
@@ -814,7 +828,7 @@ void PeerLogicValidation::NewPoWValidBlock(const CBlockIndex *pindex, const std:
 
             LogPrint("net", "%s sending header-and-ids %s to peer=%d\n", "PeerLogicValidation::NewPoWValidBlock",
                     hashBlock.ToString(), pnode->id);
-            connman->PushMessage(pnode, msgMaker.Make(NetMsgType::CMPCTBLOCK, *pcmpctblock));
+            connman->PushMessage(pnode, msgCmpctBlock);
             state.pindexBestHeaderSent = pindex;
         }
     });
@@ -934,7 +948,7 @@ bool static AlreadyHave(const CInv& inv) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
         return instantsend.AlreadyHave(inv.hash);
 
     case MSG_SPORK:
-        return mapSporks.count(inv.hash);
+        return sporkManager.SporkMessageExists(inv.hash);
 
     case MSG_MASTERNODE_PAYMENT_VOTE:
         return mnpayments.mapMasternodePaymentVotes.count(inv.hash);
@@ -1022,11 +1036,75 @@ static void RelayAddress(const CAddress& addr, bool fReachable, CConnman& connma
     connman.ForEachNodeThen(std::move(sortfunc), std::move(pushfunc));
 }
 
+/**
+ * Push the message for an inventory item, reusing the payload served to another peer with
+ * the same send version in the last RELAY_MSG_CACHE_TIME seconds. nRevision identifies
+ * content that may change without changing the inventory hash. Make fills in the message
+ * and returns false if the item is not available (anymore).
+ */
+template <typename Make>
+bool static PushRelayMessage(CNode* pfrom, CConnman& connman, const CInv& inv, int64_t nRevision, Make make)
+{
+    AssertLockHeld(cs_main);
+
+    int64_t nNow = GetTimeMicros();
+    while (!vRelayMsgExpiration.empty() && vRelayMsgExpiration.front().first < nNow) {
+        mapRelayMsg.erase(vRelayMsgExpiration.front().second);
+        vRelayMsgExpiration.pop_front();
+    }
+
+    MapRelayMsg::iterator mi = mapRelayMsg.find(std::make_pair(inv, pfrom->GetSendVersion()));
+    if (mi == mapRelayMsg.end() || mi->second.nRevision != nRevision) {
+        CSerializedNetMsg msg;
+        if (!make(msg))
+            return false;
+        if (mi == mapRelayMsg.end()) {
+            mi = mapRelayMsg.insert(std::make_pair(std::make_pair(inv, pfrom->GetSendVersion()), RelayMsg())).first;
+            vRelayMsgExpiration.push_back(std::make_pair(nNow + RELAY_MSG_CACHE_TIME * 1000000, mi));
+        }
+        mi->second.nRevision = nRevision;
+        mi->second.msg = CConnman::MakeSharedMsg(std::move(msg));
+    }
+    connman.PushMessage(pfrom, mi->second.msg);
+    return true;
+}
+
 void static ProcessGetData(CNode* pfrom, const Consensus::Params& consensusParams, CConnman& connman, const std::atomic<bool>& interruptMsgProc)
 {
     std::deque<CInv>::iterator it = pfrom->vRecvGetData.begin();
     std::vector<CInv> vNotFound;
     const CNetMsgMaker msgMaker(pfrom->GetSendVersion());
+
+    // If we have a requested block and all of its parents, but have not yet
+    // validated it, we might be in the middle of connecting it (ie in the
+    // unlock of cs_main before ActivateBestChain but after AcceptBlock).
+    // In this case, we need to run ActivateBestChain prior to checking the
+    // relay conditions below. It must run before we take cs_main, as it
+    // acquires cs_activatebestchain first.
+    bool fActivateChain = false;
+    {
+        LOCK(cs_main);
+        for (const CInv& inv : pfrom->vRecvGetData) {
+            if (inv.type != MSG_BLOCK && inv.type != MSG_FILTERED_BLOCK && inv.type != MSG_CMPCT_BLOCK)
+                continue;
+            BlockMap::iterator mi = mapBlockIndex.find(inv.hash);
+            if (mi != mapBlockIndex.end() && mi->second->nChainTx &&
+                    !mi->second->IsValid(BLOCK_VALID_SCRIPTS) && mi->second->IsValid(BLOCK_VALID_TREE)) {
+                fActivateChain = true;
+                break;
+            }
+        }
+    }
+    if (fActivateChain) {
+        std::shared_ptr<const CBlock> a_recent_block;
+        {
+            LOCK(cs_most_recent_block);
+            a_recent_block = most_recent_block;
+        }
+        CValidationState dummy;
+        ActivateBestChain(dummy, Params(), a_recent_block);
+    }
+
     LOCK(cs_main);
 
     while (it != pfrom->vRecvGetData.end()) {
@@ -1048,21 +1126,6 @@ void static ProcessGetData(CNode* pfrom, const Consensus::Params& consensusParam
                 BlockMap::iterator mi = mapBlockIndex.find(inv.hash);
                 if (mi != mapBlockIndex.end())
                 {
-                    if (mi->second->nChainTx && !mi->second->IsValid(BLOCK_VALID_SCRIPTS) &&
-                            mi->second->IsValid(BLOCK_VALID_TREE)) {
-                        // If we have the block and all of its parents, but have not yet validated it,
-                        // we might be in the middle of connecting it (ie in the unlock of cs_main
-                        // before ActivateBestChain but after AcceptBlock).
-                        // In this case, we need to run ActivateBestChain prior to checking the relay
-                        // conditions below.
-                        std::shared_ptr<const CBlock> a_recent_block;
-                        {
-                            LOCK(cs_most_recent_block);
-                            a_recent_block = most_recent_block;
-                        }
-                        CValidationState dummy;
-                        ActivateBestChain(dummy, Params(), a_recent_block);
-                    }
                     if (chainActive.Contains(mi->second)) {
                         send = true;
                     } else {
@@ -1092,13 +1155,29 @@ void static ProcessGetData(CNode* pfrom, const Consensus::Params& consensusParam
                 // Pruned nodes may have deleted the block, so check whether
                 // it's available before trying to send.
                 if (send && (mi->second->nStatus & BLOCK_HAVE_DATA)) {
-                    // Send block from disk
+                    // Send block from disk. A full block is sent as stored, there is
+                    // no need to deserialize and serialize it again.
                     CBlock block;
-                    if (!ReadBlockFromDisk(block, (*mi).second, consensusParams))
+                    if (inv.type == MSG_BLOCK) {
+                        const CBlockIndex* pindex = (*mi).second;
+                        auto readBlock = [pindex](CSerializedNetMsg& msg) {
+                            msg.command = NetMsgType::BLOCK;
+                            if (!ReadRawBlockFromDisk(msg.data, pindex, Params().MessageStart()))
+                                assert(!"cannot load block from disk");
+                            return true;
+                        };
+                        // Only new blocks are asked for by many peers at once, don't
+                        // keep the ones served to syncing peers around
+                        if (pindex->nHeight >= chainActive.Height() - RELAY_MSG_CACHE_BLOCKS) {
+                            PushRelayMessage(pfrom, connman, inv, 0, readBlock);
+                        } else {
+                            CSerializedNetMsg msg;
+                            readBlock(msg);
+                            connman.PushMessage(pfrom, std::move(msg));
+                        }
+                    } else if (!ReadBlockFromDisk(block, (*mi).second, consensusParams))
                         assert(!"cannot load block from disk");
-                    if (inv.type == MSG_BLOCK)
-                        connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::BLOCK, block));
-                    else if (inv.type == MSG_FILTERED_BLOCK)
+                    if (inv.type == MSG_FILTERED_BLOCK)
                     {
                         bool sendMerkleBlock = false;
                         CMerkleBlock merkleBlock;
@@ -1189,8 +1268,9 @@ void static ProcessGetData(CNode* pfrom, const Consensus::Params& consensusParam
                 }
 
                 if (!push && inv.type == MSG_SPORK) {
-                    if(mapSporks.count(inv.hash)) {
-                        connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::SPORK, mapSporks[inv.hash]));
+                    CSporkMessage spork;
+                    if(sporkManager.GetSporkByHash(inv.hash, spork)) {
+                        connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::SPORK, spork));
                         push = true;
                     }
                 }
@@ -1242,29 +1322,51 @@ void static ProcessGetData(CNode* pfrom, const Consensus::Params& consensusParam
                 }
 
                 if (!push && inv.type == MSG_MASTERNODE_ANNOUNCE) {
-                    if(mnodeman.mapSeenMasternodeBroadcast.count(inv.hash)){
-                        connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::MNANNOUNCE, mnodeman.mapSeenMasternodeBroadcast[inv.hash].second));
+                    auto mi = mnodeman.mapSeenMasternodeBroadcast.find(inv.hash);
+                    if (mi != mnodeman.mapSeenMasternodeBroadcast.end()) {
+                        // The last ping is updated in place, the hash doesn't cover it
+                        const auto& mnb = mi->second.second;
+                        PushRelayMessage(pfrom, connman, inv, mnb.lastPing.sigTime, [&msgMaker, &mnb](CSerializedNetMsg& msg) {
+                            msg = msgMaker.Make(NetMsgType::MNANNOUNCE, mnb);
+                            return true;
+                        });
                         push = true;
                     }
                 }
 
                 if (!push && inv.type == MSG_FUNDAMENTALNODE_ANNOUNCE) {
-                    if(fnodeman.mapSeenFundamentalnodeBroadcast.count(inv.hash)){
-                        connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::FNANNOUNCE, fnodeman.mapSeenFundamentalnodeBroadcast[inv.hash].second));
+                    auto mi = fnodeman.mapSeenFundamentalnodeBroadcast.find(inv.hash);
+                    if (mi != fnodeman.mapSeenFundamentalnodeBroadcast.end()) {
+                        // The last ping is updated in place, the hash doesn't cover it
+                        const auto& mnb = mi->second.second;
+                        PushRelayMessage(pfrom, connman, inv, mnb.lastPing.sigTime, [&msgMaker, &mnb](CSerializedNetMsg& msg) {
+                            msg = msgMaker.Make(NetMsgType::FNANNOUNCE, mnb);
+                            return true;
+                        });
                         push = true;
                     }
                 }
 
                 if (!push && inv.type == MSG_MASTERNODE_PING) {
-                    if(mnodeman.mapSeenMasternodePing.count(inv.hash)) {
-                        connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::MNPING, mnodeman.mapSeenMasternodePing[inv.hash]));
+                    auto mi = mnodeman.mapSeenMasternodePing.find(inv.hash);
+                    if (mi != mnodeman.mapSeenMasternodePing.end()) {
+                        const auto& mnp = mi->second;
+                        PushRelayMessage(pfrom, connman, inv, 0, [&msgMaker, &mnp](CSerializedNetMsg& msg) {
+                            msg = msgMaker.Make(NetMsgType::MNPING, mnp);
+                            return true;
+                        });
                         push = true;
                     }
                 }
 
                 if (!push && inv.type == MSG_FUNDAMENTALNODE_PING) {
-                    if(fnodeman.mapSeenFundamentalnodePing.count(inv.hash)) {
-                        connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::FNPING, fnodeman.mapSeenFundamentalnodePing[inv.hash]));
+                    auto mi = fnodeman.mapSeenFundamentalnodePing.find(inv.hash);
+                    if (mi != fnodeman.mapSeenFundamentalnodePing.end()) {
+                        const auto& mnp = mi->second;
+                        PushRelayMessage(pfrom, connman, inv, 0, [&msgMaker, &mnp](CSerializedNetMsg& msg) {
+                            msg = msgMaker.Make(NetMsgType::FNPING, mnp);
+                            return true;
+                        });
                         push = true;
                     }
                 }
@@ -1279,37 +1381,33 @@ void static ProcessGetData(CNode* pfrom, const Consensus::Params& consensusParam
 
                 if (!push && inv.type == MSG_GOVERNANCE_OBJECT) {
                     LogPrint("net", "ProcessGetData -- MSG_GOVERNANCE_OBJECT: inv = %s\n", inv.ToString());
-                    CDataStream ss(SER_NETWORK, pfrom->GetSendVersion());
-                    bool topush = false;
-                    {
-                        if(governance.HaveObjectForHash(inv.hash)) {
+                    bool topush = governance.HaveObjectForHash(inv.hash) &&
+                        PushRelayMessage(pfrom, connman, inv, 0, [pfrom, &msgMaker, &inv](CSerializedNetMsg& msg) {
+                            CDataStream ss(SER_NETWORK, pfrom->GetSendVersion());
                             ss.reserve(1000);
-                            if(governance.SerializeObjectForHash(inv.hash, ss)) {
-                                topush = true;
-                            }
-                        }
-                    }
+                            if (!governance.SerializeObjectForHash(inv.hash, ss))
+                                return false;
+                            msg = msgMaker.Make(NetMsgType::MNGOVERNANCEOBJECT, ss);
+                            return true;
+                        });
                     LogPrint("net", "ProcessGetData -- MSG_GOVERNANCE_OBJECT: topush = %d, inv = %s\n", topush, inv.ToString());
                     if(topush) {
-                        connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::MNGOVERNANCEOBJECT, ss));
                         push = true;
                     }
                 }
 
                 if (!push && inv.type == MSG_GOVERNANCE_OBJECT_VOTE) {
-                    CDataStream ss(SER_NETWORK, pfrom->GetSendVersion());
-                    bool topush = false;
-                    {
-                        if(governance.HaveVoteForHash(inv.hash)) {
+                    bool topush = governance.HaveVoteForHash(inv.hash) &&
+                        PushRelayMessage(pfrom, connman, inv, 0, [pfrom, &msgMaker, &inv](CSerializedNetMsg& msg) {
+                            CDataStream ss(SER_NETWORK, pfrom->GetSendVersion());
                             ss.reserve(1000);
-                            if(governance.SerializeVoteForHash(inv.hash, ss)) {
-                                topush = true;
-                            }
-                        }
-                    }
+                            if (!governance.SerializeVoteForHash(inv.hash, ss))
+                                return false;
+                            msg = msgMaker.Make(NetMsgType::MNGOVERNANCEOBJECTVOTE, ss);
+                            return true;
+                        });
                     if(topush) {
                         LogPrint("net", "ProcessGetData -- pushing: inv = %s\n", inv.ToString());
-                        connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::MNGOVERNANCEOBJECTVOTE, ss));
                         push = true;
                     }
                 }
@@ -1370,6 +1468,115 @@ inline void static SendBlockTransactions(const CBlock& block, const BlockTransac
     connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::BLOCKTXN, resp));
 }
 
+namespace {
+
+/** Processes a message type handled by one of the SecureTag extension modules */
+typedef std::function<void(CNode*, const std::string&, CDataStream&, CConnman&)> ExtensionMessageHandler;
+
+struct CExtensionMessageHandlers
+{
+    // Called in order, each handler reads its own part of the message
+    std::vector<ExtensionMessageHandler> vHandlers;
+    // Name of the module behind each handler
+    std::vector<std::string> vModules;
+    // Messages processed and total time spent on them, for -debug=bench
+    std::atomic<int64_t> nCount{0};
+    std::atomic<int64_t> nTimeMicros{0};
+};
+
+typedef std::map<std::string, CExtensionMessageHandlers> ExtensionMessageHandlerMap;
+
+/**
+ * Map every known message type that is not processed in ProcessMessage itself
+ * to the modules handling it. When a module starts handling a new message
+ * type, it has to be added here. Handlers run concurrently on the message
+ * handler threads, so every module guards its state with its own lock.
+ */
+ExtensionMessageHandlerMap MakeExtensionMessageHandlers()
+{
+    ExtensionMessageHandlerMap mapHandlers;
+
+    // Known message types without any handler are ignored without logging them as unknown
+    for (const std::string& strCommand : getAllNetMessageTypes())
+        mapHandlers[strCommand];
+
+    auto add = [&mapHandlers](const std::string& strModule, const std::vector<std::string>& vCommands, const ExtensionMessageHandler& handler) {
+        for (const std::string& strCommand : vCommands) {
+            mapHandlers[strCommand].vHandlers.push_back(handler);
+            mapHandlers[strCommand].vModules.push_back(strModule);
+        }
+    };
+
+#ifdef ENABLE_WALLET
+    add("privatesend-client", {NetMsgType::DSQUEUE, NetMsgType::DSSTATUSUPDATE, NetMsgType::DSFINALTX, NetMsgType::DSCOMPLETE},
+        [](CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, CConnman& connman) {
+            privateSendClient.ProcessMessage(pfrom, strCommand, vRecv, connman);
+        });
+#endif // ENABLE_WALLET
+    add("privatesend-server", {NetMsgType::DSACCEPT, NetMsgType::DSQUEUE, NetMsgType::DSVIN, NetMsgType::DSSIGNFINALTX},
+        [](CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, CConnman& connman) {
+            privateSendServer.ProcessMessage(pfrom, strCommand, vRecv, connman);
+        });
+    add("masternodeman", {NetMsgType::MNANNOUNCE, NetMsgType::MNPING, NetMsgType::DSEG, NetMsgType::MNVERIFY},
+        [](CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, CConnman& connman) {
+            mnodeman.ProcessMessage(pfrom, strCommand, vRecv, connman);
+        });
+    add("mnpayments", {NetMsgType::MASTERNODEPAYMENTSYNC, NetMsgType::MASTERNODEPAYMENTVOTE},
+        [](CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, CConnman& connman) {
+            mnpayments.ProcessMessage(pfrom, strCommand, vRecv, connman);
+        });
+    add("instantsend", {NetMsgType::TXLOCKVOTE},
+        [](CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, CConnman& connman) {
+            instantsend.ProcessMessage(pfrom, strCommand, vRecv, connman);
+        });
+    add("spork", {NetMsgType::SPORK, NetMsgType::GETSPORKS},
+        [](CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, CConnman& connman) {
+            sporkManager.ProcessSpork(pfrom, strCommand, vRecv, connman);
+        });
+    add("masternode-sync", {NetMsgType::SYNCSTATUSCOUNT},
+        [](CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, CConnman& connman) {
+            masternodeSync.ProcessMessage(pfrom, strCommand, vRecv);
+        });
+    add("fundamentalnode-sync", {NetMsgType::SYNCSTATUSCOUNTFN},
+        [](CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, CConnman& connman) {
+            fundamentalnodeSync.ProcessMessage(pfrom, strCommand, vRecv);
+        });
+    add("governance", {NetMsgType::MNGOVERNANCESYNC, NetMsgType::MNGOVERNANCEOBJECT, NetMsgType::MNGOVERNANCEOBJECTVOTE},
+        [](CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, CConnman& connman) {
+            governance.ProcessMessage(pfrom, strCommand, vRecv, connman);
+        });
+
+    return mapHandlers;
+}
+
+ExtensionMessageHandlerMap& GetExtensionMessageHandlers()
+{
+    static ExtensionMessageHandlerMap mapHandlers = MakeExtensionMessageHandlers();
+    return mapHandlers;
+}
+
+/** Whether a message is processed by the extension modules rather than in ProcessMessage itself */
+bool IsExtensionMessage(const std::string& strCommand)
+{
+    ExtensionMessageHandlerMap& mapHandlers = GetExtensionMessageHandlers();
+    ExtensionMessageHandlerMap::const_iterator it = mapHandlers.find(strCommand);
+    return it != mapHandlers.end() && !it->second.vHandlers.empty();
+}
+
+} // anon namespace
+
+bool GetExtensionMessageStats(const std::string& strCommand, CExtensionMessageStats& stats)
+{
+    ExtensionMessageHandlerMap& mapHandlers = GetExtensionMessageHandlers();
+    ExtensionMessageHandlerMap::const_iterator it = mapHandlers.find(strCommand);
+    if (it == mapHandlers.end())
+        return false;
+    stats.vModules = it->second.vModules;
+    stats.nCount = it->second.nCount;
+    stats.nTimeMicros = it->second.nTimeMicros;
+    return true;
+}
+
 bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, int64_t nTimeReceived, const CChainParams& chainparams, CConnman& connman, const std::atomic<bool>& interruptMsgProc)
 {
     LogPrint("net", "received: %s (%u bytes) peer=%d\n", SanitizeString(strCommand), vRecv.size(), pfrom->id);
@@ -1909,7 +2116,9 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
             inv.type = MSG_BLOCK;
             inv.hash = req.blockhash;
             pfrom->vRecvGetData.push_back(inv);
-            ProcessGetData(pfrom, chainparams.GetConsensus(), connman, interruptMsgProc);
+            // The message processing loop will go around again (without pausing)
+            // and respond then, without cs_main: ProcessGetData may need to run
+            // ActivateBestChain, which takes cs_activatebestchain first.
             return true;
         }
 
@@ -2055,7 +2264,10 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
         bool fMissingInputs = false;
         CValidationState state;
 
-        mapAlreadyAskedFor.erase(inv.hash);
+        {
+            LOCK(cs_mapAlreadyAskedFor);
+            mapAlreadyAskedFor.erase(inv.hash);
+        }
 
         std::list<CTransactionRef> lRemovedTxn;
 
@@ -2510,6 +2722,10 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
             return true;
         }
 
+        // Hash the whole batch at once, outside cs_main
+        std::vector<uint256> vHashes;
+        GetBlockHeaderHashes(headers, vHashes);
+
         const CBlockIndex *pindexLast = NULL;
         {
         LOCK(cs_main);
@@ -2527,14 +2743,14 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
             nodestate->nUnconnectingHeaders++;
             connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::GETHEADERS, chainActive.GetLocator(pindexBestHeader), uint256()));
             LogPrint("net", "received header %s: missing prev block %s, sending getheaders (%d) to end (peer=%d, nUnconnectingHeaders=%d)\n",
-                    headers[0].GetHash().ToString(),
+                    vHashes[0].ToString(),
                     headers[0].hashPrevBlock.ToString(),
                     pindexBestHeader->nHeight,
                     pfrom->id, nodestate->nUnconnectingHeaders);
             // Set hashLastUnknownBlock for this peer, so that if we
             // eventually get the headers - even from a different peer -
             // we can use this peer to download.
-            UpdateBlockAvailability(pfrom->GetId(), headers.back().GetHash());
+            UpdateBlockAvailability(pfrom->GetId(), vHashes.back());
 
             if (nodestate->nUnconnectingHeaders % MAX_UNCONNECTING_HEADERS == 0) {
                 Misbehaving(pfrom->GetId(), 20);
@@ -2543,17 +2759,17 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
         }
 
         uint256 hashLastBlock;
-        for (const CBlockHeader& header : headers) {
-            if (!hashLastBlock.IsNull() && header.hashPrevBlock != hashLastBlock) {
+        for (unsigned int n = 0; n < nCount; n++) {
+            if (!hashLastBlock.IsNull() && headers[n].hashPrevBlock != hashLastBlock) {
                 Misbehaving(pfrom->GetId(), 20);
                 return error("non-continuous headers sequence");
             }
-            hashLastBlock = header.GetHash();
+            hashLastBlock = vHashes[n];
         }
         }
 
         CValidationState state;
-        if (!ProcessNewBlockHeaders(headers, state, chainparams, &pindexLast)) {
+        if (!ProcessNewBlockHeaders(headers, state, chainparams, &pindexLast, &vHashes)) {
             int nDoS;
             if (state.IsInvalid(nDoS)) {
                 if (nDoS > 0) {
@@ -2645,18 +2861,23 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
         bool forceProcessing = false;
         const uint256 hash(pblock->GetHash());
 
-        auto it = mapBlockIndex.find(pblock->hashPrevBlock);
-        if (it != mapBlockIndex.end() && ((it->second->nStatus & BLOCK_HAVE_DATA) == 0))
+        bool fOutOfOrder = false;
         {
-            LogPrint("Received block out of order: %s\n", pblock->GetHash().ToString());
-            if (mapBlocksInFlight.count(pblock->hashPrevBlock))
+            // Other message handler threads may be adding to mapBlockIndex
+            LOCK(cs_main);
+            auto it = mapBlockIndex.find(pblock->hashPrevBlock);
+            if (it != mapBlockIndex.end() && ((it->second->nStatus & BLOCK_HAVE_DATA) == 0))
             {
-                LOCK(cs_main);
-                mapBlocksUnknownParent.insert(std::make_pair(pblock->hashPrevBlock, pblock));
-                MarkBlockAsReceived(pblock->hashPrevBlock); // invalidate to send again.
+                fOutOfOrder = true;
+                LogPrint("Received block out of order: %s\n", pblock->GetHash().ToString());
+                if (mapBlocksInFlight.count(pblock->hashPrevBlock))
+                {
+                    mapBlocksUnknownParent.insert(std::make_pair(pblock->hashPrevBlock, pblock));
+                    MarkBlockAsReceived(pblock->hashPrevBlock); // invalidate to send again.
+                }
             }
         }
-        else
+        if (!fOutOfOrder)
         {
             {
                 LOCK(cs_main);
@@ -2680,23 +2901,24 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
                 {
                     uint256 head = queue.front();
                     queue.pop_front();
-                    auto it = mapBlocksUnknownParent.find(head);
-                    if (it != std::end(mapBlocksUnknownParent))
+                    // Other message handler threads insert into and take
+                    // from mapBlocksUnknownParent under cs_main as well
+                    std::shared_ptr<CBlock> pblockrecursive;
+                    bool forceProcessing = false;
                     {
-                        std::shared_ptr<CBlock> pblockrecursive = it->second;
-                        auto recursiveHash = pblockrecursive->GetHash();
-                        LogPrint("%s: Processing out of order child %s of %s\n", __func__, recursiveHash.ToString(),
-                                 head.ToString());
-
-                        bool forceProcessing = false;
-                        {
-                            LOCK(cs_main);
-                            mapBlocksUnknownParent.erase(it);
-                            forceProcessing = MarkBlockAsReceived(recursiveHash);
-                        }
-                        ProcessNewBlock(chainparams, pblockrecursive, forceProcessing, &fNewBlock);
-                        queue.push_back(recursiveHash);
+                        LOCK(cs_main);
+                        auto it = mapBlocksUnknownParent.find(head);
+                        if (it == std::end(mapBlocksUnknownParent))
+                            continue;
+                        pblockrecursive = it->second;
+                        mapBlocksUnknownParent.erase(it);
+                        forceProcessing = MarkBlockAsReceived(pblockrecursive->GetHash());
                     }
+                    auto recursiveHash = pblockrecursive->GetHash();
+                    LogPrint("%s: Processing out of order child %s of %s\n", __func__, recursiveHash.ToString(),
+                             head.ToString());
+                    ProcessNewBlock(chainparams, pblockrecursive, forceProcessing, &fNewBlock);
+                    queue.push_back(recursiveHash);
                 }
             }
             else {
@@ -2728,7 +2950,10 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
         }
         pfrom->fSentAddr = true;
 
-        pfrom->vAddrToSend.clear();
+        {
+            LOCK(pfrom->cs_addrSend);
+            pfrom->vAddrToSend.clear();
+        }
         std::vector<CAddress> vAddr = connman.GetAddresses();
         FastRandomContext insecure_rand;
         BOOST_FOREACH(const CAddress &addr, vAddr)
@@ -2842,12 +3067,20 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
         vRecv >> alert;
 
         uint256 alertHash = alert.GetHash();
-        if (pfrom->setKnown.count(alertHash) == 0)
+        bool fKnown;
+        {
+            LOCK(cs_mapAlerts);
+            fKnown = pfrom->setKnown.count(alertHash) > 0;
+        }
+        if (!fKnown)
         {
             if (alert.ProcessAlert(chainparams.AlertKey()))
             {
                 // Relay
-                pfrom->setKnown.insert(alertHash);
+                {
+                    LOCK(cs_mapAlerts);
+                    pfrom->setKnown.insert(alertHash);
+                }
                 {
                     connman.ForEachNode([&alert, &connman](CNode* pnode) {
                         alert.RelayTo(pnode, connman);
@@ -2861,6 +3094,7 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
                 // This isn't a Misbehaving(100) (immediate ban) because the
                 // peer might be an older or different implementation with
                 // a different signature key, etc.
+                LOCK(cs_main);
                 Misbehaving(pfrom->GetId(), 10);
             }
         }
@@ -2931,29 +3165,19 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
     }
 
     else {
-        bool found = false;
-        const std::vector<std::string> &allMessages = getAllNetMessageTypes();
-        BOOST_FOREACH(const std::string msg, allMessages) {
-            if(msg == strCommand) {
-                found = true;
-                break;
-            }
-        }
+        ExtensionMessageHandlerMap& mapHandlers = GetExtensionMessageHandlers();
+        ExtensionMessageHandlerMap::iterator it = mapHandlers.find(strCommand);
 
-        if (found)
+        if (it != mapHandlers.end())
         {
             //probably one the extensions
-#ifdef ENABLE_WALLET
-            privateSendClient.ProcessMessage(pfrom, strCommand, vRecv, connman);
-#endif // ENABLE_WALLET
-            privateSendServer.ProcessMessage(pfrom, strCommand, vRecv, connman);
-            mnodeman.ProcessMessage(pfrom, strCommand, vRecv, connman);
-            mnpayments.ProcessMessage(pfrom, strCommand, vRecv, connman);
-            instantsend.ProcessMessage(pfrom, strCommand, vRecv, connman);
-            sporkManager.ProcessSpork(pfrom, strCommand, vRecv, connman);
-            masternodeSync.ProcessMessage(pfrom, strCommand, vRecv);
-            fundamentalnodeSync.ProcessMessage(pfrom, strCommand, vRecv);
-            governance.ProcessMessage(pfrom, strCommand, vRecv, connman);
+            int64_t nTimeStart = GetTimeMicros();
+            for (const ExtensionMessageHandler& handler : it->second.vHandlers)
+                handler(pfrom, strCommand, vRecv, connman);
+            int64_t nTime = GetTimeMicros() - nTimeStart;
+            int64_t nCount = ++it->second.nCount;
+            int64_t nTimeTotal = it->second.nTimeMicros += nTime;
+            LogPrint("bench", "  - Process %s: %.2fms [%d messages, %.2fs]\n", strCommand, 0.001 * nTime, nCount, nTimeTotal * 0.000001);
         }
         else
         {
@@ -3022,6 +3246,12 @@ bool ProcessMessages(CNode* pfrom, CConnman& connman, const std::atomic<bool>& i
             return false;
 
         std::list<CNetMessage> msgs;
+        // Give the message back to the receive pool however processing ends
+        struct RecycleMsgs {
+            CNode* pnode;
+            std::list<CNetMessage>& msgs;
+            ~RecycleMsgs() { pnode->recvMsgPool.Give(msgs); }
+        } recycle{pfrom, msgs};
         {
             LOCK(pfrom->cs_vProcessMsg);
             if (pfrom->vProcessMsg.empty())
@@ -3109,8 +3339,12 @@ bool ProcessMessages(CNode* pfrom, CConnman& connman, const std::atomic<bool>& i
             LogPrintf("%s(%s, %u bytes) FAILED peer=%d\n", __func__, SanitizeString(strCommand), nMessageSize, pfrom->id);
         }
 
-        LOCK(cs_main);
-        SendRejectsAndCheckIfBanned(pfrom, connman);
+        // Extension modules don't queue rejects, and SendMessages() right after
+        // takes care of bans, so their messages don't need to wait for cs_main
+        if (!IsExtensionMessage(strCommand)) {
+            LOCK(cs_main);
+            SendRejectsAndCheckIfBanned(pfrom, connman);
+        }
 
     return fMoreWork;
 }
@@ -3192,28 +3426,28 @@ bool SendMessages(CNode* pto, CConnman& connman, const std::atomic<bool>& interr
         //
         if (pto->nNextAddrSend < nNow) {
             pto->nNextAddrSend = PoissonNextSend(nNow, AVG_ADDRESS_BROADCAST_INTERVAL);
+            // Take the queued addresses, other nodes' threads keep pushing to the new vector
+            std::vector<CAddress> vAddrToSend;
             std::vector<CAddress> vAddr;
-            vAddr.reserve(pto->vAddrToSend.size());
-            BOOST_FOREACH(const CAddress& addr, pto->vAddrToSend)
             {
-                if (!pto->addrKnown.contains(addr.GetKey()))
+                LOCK(pto->cs_addrSend);
+                // this also drops the capacity, we only send the big addr message once
+                vAddrToSend.swap(pto->vAddrToSend);
+                vAddr.reserve(vAddrToSend.size());
+                BOOST_FOREACH(const CAddress& addr, vAddrToSend)
                 {
-                    pto->addrKnown.insert(addr.GetKey());
-                    vAddr.push_back(addr);
-                    // receiver rejects addr messages larger than 1000
-                    if (vAddr.size() >= 1000)
+                    if (!pto->addrKnown.contains(addr.GetKey()))
                     {
-                        connman.PushMessage(pto, msgMaker.Make(NetMsgType::ADDR, vAddr));
-                        vAddr.clear();
+                        pto->addrKnown.insert(addr.GetKey());
+                        vAddr.push_back(addr);
                     }
                 }
             }
-            pto->vAddrToSend.clear();
-            if (!vAddr.empty())
-                connman.PushMessage(pto, msgMaker.Make(NetMsgType::ADDR, vAddr));
-            // we only send the big addr message once
-            if (pto->vAddrToSend.capacity() > 40)
-                pto->vAddrToSend.shrink_to_fit();
+            // receiver rejects addr messages larger than 1000
+            for (size_t nStart = 0; nStart < vAddr.size(); nStart += 1000) {
+                std::vector<CAddress> vAddrMsg(vAddr.begin() + nStart, vAddr.begin() + std::min(vAddr.size(), nStart + 1000));
+                connman.PushMessage(pto, msgMaker.Make(NetMsgType::ADDR, vAddrMsg));
+            }
         }
 
         // Start block sync
@@ -3327,8 +3561,7 @@ bool SendMessages(CNode* pto, CConnman& connman, const std::atomic<bool>& interr
                     {
                         LOCK(cs_most_recent_block);
                         if (most_recent_block_hash == pBestIndex->GetBlockHash()) {
-                            CBlockHeaderAndShortTxIDs cmpctblock(*most_recent_block);
-                            connman.PushMessage(pto, msgMaker.Make(NetMsgType::CMPCTBLOCK, cmpctblock));
+                            connman.PushMessage(pto, most_recent_compact_block_msg);
                             fGotBlockFromCache = true;
                         }
                     }
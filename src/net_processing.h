@@ -15,6 +15,10 @@ static const unsigned int DEFAULT_MAX_ORPHAN_TRANSACTIONS = 100;
 static const int64_t ORPHAN_TX_EXPIRE_TIME = 20 * 60;
 /** Minimum time between orphan transactions expire time checks in seconds */
 static const int64_t ORPHAN_TX_EXPIRE_INTERVAL = 5 * 60;
+/** How long a message served for getdata is kept for other peers asking for it, in seconds */
+static const int64_t RELAY_MSG_CACHE_TIME = 60;
+/** Blocks this close to the tip are kept in the getdata message cache */
+static const int RELAY_MSG_CACHE_BLOCKS = 2;
 
 /** Headers download timeout expressed in microseconds
  *  Timeout = base + per_header * (expected number of headers) */
@@ -54,6 +58,17 @@ bool GetNodeStateStats(NodeId nodeid, CNodeStateStats &stats);
 /** Increase a node's misbehavior score. */
 void Misbehaving(NodeId nodeid, int howmuch);
 
+struct CExtensionMessageStats {
+    // Modules handling the message type, in the order they run
+    std::vector<std::string> vModules;
+    // Messages processed and total time spent on them
+    int64_t nCount;
+    int64_t nTimeMicros;
+};
+
+/** Get the handlers and statistics of a known message type not processed in ProcessMessage itself */
+bool GetExtensionMessageStats(const std::string& strCommand, CExtensionMessageStats& stats);
+
 /** Process protocol messages received from a given node */
 bool ProcessMessages(CNode* pfrom, CConnman& connman, const std::atomic<bool>& interrupt);
 /**
@@ -11,11 +11,49 @@
 #include "crypto/common.h"
 #include "crypto/neoscrypt.h"
 
+CBlockHeader& CBlockHeader::operator=(const CBlockHeader& other)
+{
+    if (this == &other)
+        return *this;
+
+    nVersion = other.nVersion;
+    hashPrevBlock = other.hashPrevBlock;
+    hashMerkleRoot = other.hashMerkleRoot;
+    nTime = other.nTime;
+    nBits = other.nBits;
+    nNonce = other.nNonce;
+
+    // Take the other header's hash along, unless its fields changed since
+    nHashState = HASH_EMPTY;
+    if (other.nHashState.load(std::memory_order_acquire) == HASH_STORED &&
+        memcmp(other.vchHashedHeader, &other.nVersion, HEADER_SIZE) == 0) {
+        memcpy(vchHashedHeader, other.vchHashedHeader, HEADER_SIZE);
+        hashStored = other.hashStored;
+        nHashState = HASH_STORED;
+    }
+    return *this;
+}
+
 uint256 CBlockHeader::GetHash() const
 {
+        unsigned char header[HEADER_SIZE];
+        memcpy(header, &nVersion, HEADER_SIZE);
+        if (nHashState.load(std::memory_order_acquire) == HASH_STORED &&
+            memcmp(header, vchHashedHeader, HEADER_SIZE) == 0)
+            return hashStored;
+
         uint256 thash;
         unsigned int profile = 0x0;
-        neoscrypt((unsigned char *) &nVersion, (unsigned char *) &thash, profile);
+        neoscrypt(header, (unsigned char *) &thash, profile);
+
+        // Only the first hash is stored, a header whose fields were changed
+        // after that hashes without the memo
+        int nState = HASH_EMPTY;
+        if (nHashState.compare_exchange_strong(nState, HASH_WRITING)) {
+            memcpy(vchHashedHeader, header, HEADER_SIZE);
+            hashStored = thash;
+            nHashState.store(HASH_STORED, std::memory_order_release);
+        }
         return thash;
 
 }
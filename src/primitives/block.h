@@ -10,6 +10,8 @@
 #include "serialize.h"
 #include "uint256.h"
 
+#include <atomic>
+
 /** Nodes collect new transactions into a block, hash them into a hash tree,
  * and scan through nonce values to make the block's hash satisfy proof-of-work
  * requirements.  When they solve the proof-of-work, they broadcast the block
@@ -28,11 +30,34 @@ public:
     uint32_t nBits;
     uint32_t nNonce;
 
+    /** Size of the hashed part of the header, starting at nVersion */
+    static const size_t HEADER_SIZE = 80;
+
+private:
+    // memory only: the first hash computed since the header was set up, read
+    // or assigned, and the header bytes it was computed from. The hash is
+    // stored once, so threads sharing a header read it without a lock: the
+    // one thread that moves nHashState from HASH_EMPTY to HASH_WRITING stores
+    // it and then publishes it as HASH_STORED. Any later change to a header
+    // field makes the bytes differ, so the stored hash is not used again.
+    enum { HASH_EMPTY, HASH_WRITING, HASH_STORED };
+    mutable std::atomic<int> nHashState;
+    mutable unsigned char vchHashedHeader[HEADER_SIZE];
+    mutable uint256 hashStored;
+
+public:
     CBlockHeader()
     {
         SetNull();
     }
 
+    CBlockHeader(const CBlockHeader& other) : nHashState(HASH_EMPTY)
+    {
+        *this = other;
+    }
+
+    CBlockHeader& operator=(const CBlockHeader& other);
+
     ADD_SERIALIZE_METHODS;
 
     template <typename Stream, typename Operation>
@@ -43,7 +68,8 @@ public:
         READWRITE(nTime);
         READWRITE(nBits);
         READWRITE(nNonce);
-
+        if (ser_action.ForRead())
+            nHashState = HASH_EMPTY;
     }
 
 
@@ -55,7 +81,7 @@ public:
         nTime = 0;
         nBits = 0;
         nNonce = 0;
-
+        nHashState = HASH_EMPTY;
     }
 
     bool IsNull() const
@@ -128,13 +154,8 @@ public:
 
     CBlockHeader GetBlockHeader() const
     {
-        CBlockHeader block;
-        block.nVersion       = nVersion;
-        block.hashPrevBlock  = hashPrevBlock;
-        block.hashMerkleRoot = hashMerkleRoot;
-        block.nTime          = nTime;
-        block.nBits          = nBits;
-        block.nNonce         = nNonce;
+        // Copy including the cached hash
+        CBlockHeader block(*this);
         return block;
     }
     bool IsProofOfStake() const;
@@ -26,10 +26,10 @@ void CPrivateSendClient::ProcessMessage(CNode* pfrom, const std::string& strComm
     if(fLiteMode) return; // ignore all SecureTag related functionality
     if(!masternodeSync.IsBlockchainSynced()) return;
 
-    if(strCommand == NetMsgType::DSQUEUE) {
-        TRY_LOCK(cs_darksend, lockRecv);
-        if(!lockRecv) return;
+    // Mixing messages are handled on several message handler threads
+    LOCK(cs_darksend);
 
+    if(strCommand == NetMsgType::DSQUEUE) {
         if(pfrom->nVersion < MIN_PRIVATESEND_PEER_PROTO_VERSION) {
             LogPrint("privatesend", "DSQUEUE -- peer=%d using obsolete version %i\n", pfrom->id, pfrom->nVersion);
             connman.PushMessage(pfrom, CNetMsgMaker(pfrom->GetSendVersion()).Make(NetMsgType::REJECT, strCommand, REJECT_OBSOLETE,
@@ -297,12 +297,14 @@ std::string CPrivateSendClient::GetStatus()
 
 bool CPrivateSendClient::GetMixingMasternodeInfo(masternode_info_t& mnInfoRet)
 {
+    LOCK(cs_darksend);
     mnInfoRet = infoMixingMasternode.fInfoValid ? infoMixingMasternode : masternode_info_t();
     return infoMixingMasternode.fInfoValid;
 }
 
 bool CPrivateSendClient::IsMixingMasternode(const CNode* pnode)
 {
+    LOCK(cs_darksend);
     return infoMixingMasternode.fInfoValid && pnode->addr == infoMixingMasternode.addr;
 }
 
@@ -331,6 +333,8 @@ void CPrivateSendClient::CheckTimeout()
 {
     if(fMasternodeMode) return;
 
+    LOCK(cs_darksend);
+
     CheckQueue();
 
     if(!fEnablePrivateSend) return;
@@ -23,6 +23,9 @@ void CPrivateSendServer::ProcessMessage(CNode* pfrom, const std::string& strComm
     if(fLiteMode) return; // ignore all SecureTag related functionality
     if(!masternodeSync.IsBlockchainSynced()) return;
 
+    // Mixing messages are handled on several message handler threads
+    LOCK(cs_darksend);
+
     if(strCommand == NetMsgType::DSACCEPT) {
 
         if(pfrom->nVersion < MIN_PRIVATESEND_PEER_PROTO_VERSION) {
@@ -76,8 +79,6 @@ void CPrivateSendServer::ProcessMessage(CNode* pfrom, const std::string& strComm
         }
 
     } else if(strCommand == NetMsgType::DSQUEUE) {
-        TRY_LOCK(cs_darksend, lockRecv);
-        if(!lockRecv) return;
 
         if(pfrom->nVersion < MIN_PRIVATESEND_PEER_PROTO_VERSION) {
             LogPrint("privatesend", "DSQUEUE -- peer=%d using obsolete version %i\n", pfrom->id, pfrom->nVersion);
@@ -499,6 +500,8 @@ void CPrivateSendServer::CheckTimeout(CConnman& connman)
 {
     if(!fMasternodeMode) return;
 
+    LOCK(cs_darksend);
+
     CheckQueue();
 
     int nTimeout = (nState == POOL_STATE_SIGNING) ? PRIVATESEND_SIGNING_TIMEOUT : PRIVATESEND_QUEUE_TIMEOUT;
@@ -521,6 +524,8 @@ void CPrivateSendServer::CheckForCompleteQueue(CConnman& connman)
 {
     if(!fMasternodeMode) return;
 
+    LOCK(cs_darksend);
+
     if(nState == POOL_STATE_QUEUE && IsSessionReady()) {
         SetState(POOL_STATE_ACCEPTING_ENTRIES);
 
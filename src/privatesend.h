@@ -374,11 +374,11 @@ public:
 
     CPrivateSendBase() { SetNull(); }
 
-    int GetQueueSize() const { return vecDarksendQueue.size(); }
+    int GetQueueSize() const { LOCK(cs_darksend); return vecDarksendQueue.size(); }
     int GetState() const { return nState; }
     std::string GetStateString() const;
 
-    int GetEntriesCount() const { return vecEntries.size(); }
+    int GetEntriesCount() const { LOCK(cs_darksend); return vecEntries.size(); }
 };
 
 // helper class
@@ -637,6 +637,8 @@ UniValue getblockhashes(const JSONRPCRequest& request)
     unsigned int low = request.params[1].get_int();
     std::vector<uint256> blockHashes;
 
+    EnsureIndexReady("timestampindex");
+
     if (!GetTimestampIndex(high, low, blockHashes)) {
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for block hashes");
     }
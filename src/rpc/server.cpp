@@ -7,6 +7,7 @@
 #include "rpc/server.h"
 
 #include "base58.h"
+#include "indexer.h"
 #include "init.h"
 #include "random.h"
 #include "sync.h"
@@ -172,6 +173,13 @@ std::vector<unsigned char> ParseHexO(const UniValue& o, std::string strKey)
     return ParseHexV(find_value(o, strKey), strKey);
 }
 
+void EnsureIndexReady(const std::string& strName)
+{
+    std::string strError;
+    if (!BlockUntilIndexSynced(strName, strError))
+        throw JSONRPCError(RPC_MISC_ERROR, strError);
+}
+
 /**
  * Note: This interface may still be subject to change.
  */
@@ -131,3 +131,80 @@ size_t CScheduler::getQueueInfo(boost::chrono::system_clock::time_point &first,
     }
     return result;
 }
+
+void SingleThreadedSchedulerClient::MaybeScheduleProcessQueue()
+{
+    {
+        boost::unique_lock<boost::mutex> lock(cs_callbacksPending);
+        // Try to avoid scheduling too many copies here, but if we
+        // accidentally have two ProcessQueue's scheduled at once it's
+        // not a big deal.
+        if (fCallbacksRunning || listCallbacksPending.empty())
+            return;
+    }
+    pscheduler->schedule(boost::bind(&SingleThreadedSchedulerClient::ProcessQueue, this), boost::chrono::system_clock::now());
+}
+
+void SingleThreadedSchedulerClient::ProcessQueue()
+{
+    CScheduler::Function callback;
+    {
+        boost::unique_lock<boost::mutex> lock(cs_callbacksPending);
+        if (fCallbacksRunning || listCallbacksPending.empty())
+            return;
+        fCallbacksRunning = true;
+
+        callback = listCallbacksPending.front();
+        listCallbacksPending.pop_front();
+    }
+
+    // Reset fCallbacksRunning and schedule the next callback even if this one throws
+    struct RAIICallbacksRunning {
+        SingleThreadedSchedulerClient* instance;
+        RAIICallbacksRunning(SingleThreadedSchedulerClient* instanceIn) : instance(instanceIn) {}
+        ~RAIICallbacksRunning() {
+            // Do everything under the lock: once it is released, EmptyQueue
+            // may return and the client be destroyed
+            boost::unique_lock<boost::mutex> lock(instance->cs_callbacksPending);
+            instance->fCallbacksRunning = false;
+            instance->cvCallbacksRunning.notify_all();
+            if (!instance->listCallbacksPending.empty())
+                instance->pscheduler->schedule(boost::bind(&SingleThreadedSchedulerClient::ProcessQueue, instance), boost::chrono::system_clock::now());
+        }
+    } raiicallbacksrunning(this);
+
+    callback();
+}
+
+void SingleThreadedSchedulerClient::AddToProcessQueue(const CScheduler::Function& func)
+{
+    assert(pscheduler);
+
+    {
+        boost::unique_lock<boost::mutex> lock(cs_callbacksPending);
+        listCallbacksPending.push_back(func);
+    }
+    MaybeScheduleProcessQueue();
+}
+
+void SingleThreadedSchedulerClient::EmptyQueue()
+{
+    boost::unique_lock<boost::mutex> lock(cs_callbacksPending);
+    while (true) {
+        // A callback may still be running on a scheduler thread, and the
+        // caller may tear down what it uses as soon as we return
+        while (fCallbacksRunning)
+            cvCallbacksRunning.wait(lock);
+        if (listCallbacksPending.empty())
+            return;
+        lock.unlock();
+        ProcessQueue();
+        lock.lock();
+    }
+}
+
+size_t SingleThreadedSchedulerClient::CallbacksPending()
+{
+    boost::unique_lock<boost::mutex> lock(cs_callbacksPending);
+    return listCallbacksPending.size();
+}
@@ -13,8 +13,11 @@
 #include <boost/function.hpp>
 #include <boost/chrono/chrono.hpp>
 #include <boost/thread.hpp>
+#include <list>
 #include <map>
 
+#include "sync.h"
+
 //
 // Simple class for background tasks that should be run
 // periodically or once "after a while"
@@ -80,4 +83,37 @@ private:
     bool shouldStop() { return stopRequested || (stopWhenEmpty && taskQueue.empty()); }
 };
 
+/**
+ * Class used by CScheduler clients which may schedule multiple jobs
+ * which are required to be run serially. Jobs may not be run on the
+ * same thread, but no two jobs will be executed at the same time
+ * and they are run in the order they were added.
+ */
+class SingleThreadedSchedulerClient
+{
+private:
+    CScheduler *pscheduler;
+
+    CWaitableCriticalSection cs_callbacksPending;
+    std::list<CScheduler::Function> listCallbacksPending;
+    bool fCallbacksRunning;
+    // Signalled when a callback returns, see EmptyQueue
+    CConditionVariable cvCallbacksRunning;
+
+    void MaybeScheduleProcessQueue();
+    void ProcessQueue();
+
+public:
+    SingleThreadedSchedulerClient(CScheduler *pschedulerIn) : pscheduler(pschedulerIn), fCallbacksRunning(false) {}
+
+    // Add a callback to be executed after all the ones added before it
+    void AddToProcessQueue(const CScheduler::Function& func);
+
+    // Processes all remaining queue members on the calling thread, blocking
+    // until the queue is empty and no callback is running on another thread
+    void EmptyQueue();
+
+    size_t CallbacksPending();
+};
+
 #endif
@@ -369,5 +369,34 @@ struct CAddressIndexIteratorHeightKey {
     }
 };
 
+/** Running totals of the address index entries of an address */
+struct CAddressBalanceValue {
+    CAmount balance;
+    CAmount received;
+    unsigned int txCount;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(balance);
+        READWRITE(received);
+        READWRITE(txCount);
+    }
+
+    CAddressBalanceValue() {
+        SetNull();
+    }
+
+    void SetNull() {
+        balance = 0;
+        received = 0;
+        txCount = 0;
+    }
+
+    bool IsNull() const {
+        return (txCount == 0);
+    }
+};
 
 #endif // BITCOIN_SPENTINDEX_H
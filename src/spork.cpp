@@ -15,7 +15,6 @@
 
 CSporkManager sporkManager;
 
-std::map<uint256, CSporkMessage> mapSporks;
 std::map<int, int64_t> mapSporkDefaults = {
     {SPORK_2_INSTANTSEND_ENABLED,            0},             // ON
     {SPORK_3_INSTANTSEND_BLOCK_FILTERING,    0},             // ON
@@ -50,26 +49,35 @@ void CSporkManager::ProcessSpork(CNode* pfrom, const std::string& strCommand, CD
             strLogMsg = strprintf("SPORK -- hash: %s id: %d value: %10d bestHeight: %d peer=%d", hash.ToString(), spork.nSporkID, spork.nValue, chainActive.Height(), pfrom->id);
         }
 
-        if(mapSporksActive.count(spork.nSporkID)) {
-            if (mapSporksActive[spork.nSporkID].nTimeSigned >= spork.nTimeSigned) {
-                LogPrint("spork", "%s seen\n", strLogMsg);
-                return;
+        bool fValidSig;
+        {
+            LOCK(cs);
+            if(mapSporksActive.count(spork.nSporkID)) {
+                if (mapSporksActive[spork.nSporkID].nTimeSigned >= spork.nTimeSigned) {
+                    LogPrint("spork", "%s seen\n", strLogMsg);
+                    return;
+                } else {
+                    LogPrintf("%s updated\n", strLogMsg);
+                }
             } else {
-                LogPrintf("%s updated\n", strLogMsg);
+                LogPrintf("%s new\n", strLogMsg);
+            }
+
+            fValidSig = spork.CheckSignature(sporkPubKeyID);
+            if(fValidSig) {
+                mapSporksByHash[hash] = spork;
+                mapSporksActive[spork.nSporkID] = spork;
             }
-        } else {
-            LogPrintf("%s new\n", strLogMsg);
         }
 
-        if(!spork.CheckSignature(sporkPubKeyID)) {
+        // cs_main is taken before cs elsewhere, so punish the peer only after releasing it
+        if(!fValidSig) {
             LOCK(cs_main);
             LogPrintf("CSporkManager::ProcessSpork -- ERROR: invalid signature\n");
             Misbehaving(pfrom->GetId(), 100);
             return;
         }
 
-        mapSporks[hash] = spork;
-        mapSporksActive[spork.nSporkID] = spork;
         spork.Relay(connman);
 
         //does a task if needed
@@ -77,9 +85,15 @@ void CSporkManager::ProcessSpork(CNode* pfrom, const std::string& strCommand, CD
 
     } else if (strCommand == NetMsgType::GETSPORKS) {
 
-        std::map<int, CSporkMessage>::iterator it = mapSporksActive.begin();
+        std::map<int, CSporkMessage> mapSporksToSend;
+        {
+            LOCK(cs);
+            mapSporksToSend = mapSporksActive;
+        }
+
+        std::map<int, CSporkMessage>::iterator it = mapSporksToSend.begin();
 
-        while(it != mapSporksActive.end()) {
+        while(it != mapSporksToSend.end()) {
             connman.PushMessage(pfrom, CNetMsgMaker(pfrom->GetSendVersion()).Make(NetMsgType::SPORK, it->second));
             it++;
         }
@@ -96,23 +110,24 @@ void CSporkManager::ExecuteSpork(int nSporkID, int nValue)
         // this potentially can be a heavy operation, so only allow this to be executed once per 10 minutes
         int64_t nTimeout = 10 * 60;
 
-        static int64_t nTimeExecuted = 0; // i.e. it was never executed before
-
-        if(GetTime() - nTimeExecuted < nTimeout) {
-            LogPrint("spork", "CSporkManager::ExecuteSpork -- ERROR: Trying to reconsider blocks, too soon - %d/%d\n", GetTime() - nTimeExecuted, nTimeout);
-            return;
-        }
-
         if(nValue > nMaxBlocks) {
             LogPrintf("CSporkManager::ExecuteSpork -- ERROR: Trying to reconsider too many blocks %d/%d\n", nValue, nMaxBlocks);
             return;
         }
 
+        {
+            LOCK(cs);
+            if(GetTime() - nTimeReconsiderExecuted < nTimeout) {
+                LogPrint("spork", "CSporkManager::ExecuteSpork -- ERROR: Trying to reconsider blocks, too soon - %d/%d\n", GetTime() - nTimeReconsiderExecuted, nTimeout);
+                return;
+            }
+            nTimeReconsiderExecuted = GetTime();
+        }
 
         LogPrintf("CSporkManager::ExecuteSpork -- Reconsider Last %d Blocks\n", nValue);
 
+        // Not under cs: ActivateBestChain listeners query sporks
         ReprocessBlocks(nValue);
-        nTimeExecuted = GetTime();
     }
 }
 
@@ -121,19 +136,22 @@ bool CSporkManager::UpdateSpork(int nSporkID, int64_t nValue, CConnman& connman)
 
     CSporkMessage spork = CSporkMessage(nSporkID, nValue, GetAdjustedTime());
 
-    if(spork.Sign(sporkPrivKey)) {
-        spork.Relay(connman);
-        mapSporks[spork.GetHash()] = spork;
+    {
+        LOCK(cs);
+        if(!spork.Sign(sporkPrivKey))
+            return false;
+        mapSporksByHash[spork.GetHash()] = spork;
         mapSporksActive[nSporkID] = spork;
-        return true;
     }
 
-    return false;
+    spork.Relay(connman);
+    return true;
 }
 
 // grab the spork, otherwise say it's off
 bool CSporkManager::IsSporkActive(int nSporkID)
 {
+    LOCK(cs);
     int64_t r = -1;
 
     if(mapSporksActive.count(nSporkID)){
@@ -151,6 +169,7 @@ bool CSporkManager::IsSporkActive(int nSporkID)
 // grab the value of the spork on the network, or the default
 int64_t CSporkManager::GetSporkValue(int nSporkID)
 {
+    LOCK(cs);
     if (mapSporksActive.count(nSporkID))
         return mapSporksActive[nSporkID].nValue;
 
@@ -162,6 +181,23 @@ int64_t CSporkManager::GetSporkValue(int nSporkID)
     return -1;
 }
 
+bool CSporkManager::SporkMessageExists(const uint256& hash)
+{
+    LOCK(cs);
+    return mapSporksByHash.count(hash);
+}
+
+bool CSporkManager::GetSporkByHash(const uint256& hash, CSporkMessage& sporkRet)
+{
+    LOCK(cs);
+    std::map<uint256, CSporkMessage>::iterator it = mapSporksByHash.find(hash);
+    if (it == mapSporksByHash.end())
+        return false;
+
+    sporkRet = it->second;
+    return true;
+}
+
 int CSporkManager::GetSporkIDByName(const std::string& strName)
 {
     if (strName == "SPORK_2_INSTANTSEND_ENABLED")               return SPORK_2_INSTANTSEND_ENABLED;
@@ -203,6 +239,7 @@ std::string CSporkManager::GetSporkNameByID(int nSporkID)
 }
 
 bool CSporkManager::SetSporkAddress(const std::string& strAddress) {
+    LOCK(cs);
     CBitcoinAddress address(strAddress);
     if (!address.IsValid() || !address.GetKeyID(sporkPubKeyID)) {
         LogPrintf("CSporkManager::SetSporkAddress -- Failed to parse spork address\n");
@@ -213,6 +250,7 @@ bool CSporkManager::SetSporkAddress(const std::string& strAddress) {
 
 bool CSporkManager::SetPrivKey(const std::string& strPrivKey)
 {
+    LOCK(cs);
     CKey key;
     CPubKey pubKey;
     if(!CMessageSigner::GetKeysFromSecret(strPrivKey, key, pubKey)) {
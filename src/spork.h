@@ -33,7 +33,6 @@ static const int SPORK_START                                            = SPORK_
 static const int SPORK_END                                              = SPORK_15_REQUIRE_SENTINEL_FLAG;
 
 extern std::map<int, int64_t> mapSporkDefaults;
-extern std::map<uint256, CSporkMessage> mapSporks;
 extern CSporkManager sporkManager;
 
 //
@@ -88,15 +87,20 @@ public:
 class CSporkManager
 {
 private:
+    // Taken by readers and writers alike, spork messages are handled on
+    // several message handler threads while the rest of the node queries them
+    mutable CCriticalSection cs;
     std::vector<unsigned char> vchSig;
+    std::map<uint256, CSporkMessage> mapSporksByHash;
     std::map<int, CSporkMessage> mapSporksActive;
+    int64_t nTimeReconsiderExecuted;
 
     CKeyID sporkPubKeyID;
     CKey sporkPrivKey;
 
 public:
 
-    CSporkManager() {}
+    CSporkManager() : nTimeReconsiderExecuted(0) {}
 
     void ProcessSpork(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, CConnman& connman);
     void ExecuteSpork(int nSporkID, int nValue);
@@ -104,6 +108,8 @@ public:
 
     bool IsSporkActive(int nSporkID);
     int64_t GetSporkValue(int nSporkID);
+    bool SporkMessageExists(const uint256& hash);
+    bool GetSporkByHash(const uint256& hash, CSporkMessage& sporkRet);
     int GetSporkIDByName(const std::string& strName);
     std::string GetSporkNameByID(int nSporkID);
 
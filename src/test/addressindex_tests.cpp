@@ -0,0 +1,66 @@
+// Copyright (c) 2018 The SecureTag Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "random.h"
+#include "txdb.h"
+#include "utilstrencodings.h"
+
+#include "test/test_securetag.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(addressindex_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(addressindex_balance)
+{
+    CBlockTreeDB db(1 << 20, true);
+    BOOST_CHECK(db.BuildAddressBalanceIndex());
+
+    const uint160 hashAddress = uint160(ParseHex("0101010101010101010101010101010101010101"));
+    const uint256 txid1 = GetRandHash();
+    const uint256 txid2 = GetRandHash();
+
+    // Two outputs received in one transaction, one of them spent by the next block
+    std::vector<std::pair<CAddressIndexKey, CAmount> > vBlock1;
+    vBlock1.push_back(std::make_pair(CAddressIndexKey(1, hashAddress, 1, 1, txid1, 0, false), 50));
+    vBlock1.push_back(std::make_pair(CAddressIndexKey(1, hashAddress, 1, 1, txid1, 1, false), 20));
+    std::vector<std::pair<CAddressIndexKey, CAmount> > vBlock2;
+    vBlock2.push_back(std::make_pair(CAddressIndexKey(1, hashAddress, 2, 1, txid2, 0, true), -50));
+
+    CAddressBalanceValue balance;
+    BOOST_CHECK(db.WriteAddressIndex(vBlock1));
+    BOOST_CHECK(db.WriteAddressIndex(vBlock2));
+    BOOST_CHECK(db.ReadAddressBalanceIndex(hashAddress, 1, balance));
+    BOOST_CHECK_EQUAL(balance.balance, 20);
+    BOOST_CHECK_EQUAL(balance.received, 70);
+    BOOST_CHECK_EQUAL(balance.txCount, 2U);
+
+    // Writing a block again doesn't count it twice
+    BOOST_CHECK(db.WriteAddressIndex(vBlock2));
+    BOOST_CHECK(db.ReadAddressBalanceIndex(hashAddress, 1, balance));
+    BOOST_CHECK_EQUAL(balance.balance, 20);
+    BOOST_CHECK_EQUAL(balance.txCount, 2U);
+
+    // Building the totals from the entries gives the same result
+    BOOST_CHECK(db.BuildAddressBalanceIndex());
+    BOOST_CHECK(db.ReadAddressBalanceIndex(hashAddress, 1, balance));
+    BOOST_CHECK_EQUAL(balance.balance, 20);
+    BOOST_CHECK_EQUAL(balance.received, 70);
+    BOOST_CHECK_EQUAL(balance.txCount, 2U);
+
+    // Erasing the blocks reverts the totals
+    BOOST_CHECK(db.EraseAddressIndex(vBlock2));
+    BOOST_CHECK(db.ReadAddressBalanceIndex(hashAddress, 1, balance));
+    BOOST_CHECK_EQUAL(balance.balance, 70);
+    BOOST_CHECK_EQUAL(balance.received, 70);
+    BOOST_CHECK_EQUAL(balance.txCount, 1U);
+
+    BOOST_CHECK(db.EraseAddressIndex(vBlock1));
+    BOOST_CHECK(db.EraseAddressIndex(vBlock1));
+    BOOST_CHECK(db.ReadAddressBalanceIndex(hashAddress, 1, balance));
+    BOOST_CHECK(balance.IsNull());
+    BOOST_CHECK_EQUAL(balance.balance, 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
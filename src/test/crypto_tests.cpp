@@ -9,6 +9,7 @@
 #include "crypto/sha512.h"
 #include "crypto/hmac_sha256.h"
 #include "crypto/hmac_sha512.h"
+#include "crypto/neoscrypt.h"
 #include "utilstrencodings.h"
 #include "test/test_securetag.h"
 #include "test/test_random.h"
@@ -462,4 +463,30 @@ BOOST_AUTO_TEST_CASE(pbkdf2_hmac_sha512_test) {
     BOOST_CHECK(HexStr(k, k + 64) == "8c0511f4c6e597c6ac6315d8f0362e225f3c501495ba23b868c005174dc4ee71115b59f9e60cd9532fa33e0f75aefe30225c583a186cd82bd4daea9724a3d3b8");
 }
 
+BOOST_AUTO_TEST_CASE(neoscrypt_engines) {
+    unsigned char in[80], out[32], ref[32];
+    for (int i = 0; i < 80; i++)
+        in[i] = i;
+
+    // Every engine the CPU supports must match the portable one bit for bit
+    for (unsigned int engine = NEOSCRYPT_ENGINE_SCALAR; engine <= NEOSCRYPT_ENGINE_AVX2; engine++) {
+        if (neoscrypt_engine_select(engine) != engine)
+            continue;
+        neoscrypt(in, out, 0);
+        BOOST_CHECK_EQUAL(HexStr(out, out + 32), "7258961afb33fd12d00cacb8d63f4f4f52bb6917043865dd24a08f578853122d");
+    }
+
+    for (int i = 0; i < 32; i++) {
+        for (int j = 0; j < 80; j++)
+            in[j] = insecure_rand();
+        neoscrypt_engine_select(NEOSCRYPT_ENGINE_SCALAR);
+        neoscrypt(in, ref, 0);
+        neoscrypt_engine_init();
+        neoscrypt(in, out, 0);
+        BOOST_CHECK(memcmp(ref, out, 32) == 0);
+    }
+
+    neoscrypt_engine_init();
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,146 @@
+// Copyright (c) 2018 The SecureTag Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "governance-object.h"
+#include "governance-vote.h"
+#include "masternodeman.h"
+#include "streams.h"
+#include "utilstrencodings.h"
+#include "utiltime.h"
+
+#include "test/test_securetag.h"
+
+#include <boost/test/unit_test.hpp>
+
+/** Drives votes into an object directly, as CGovernanceManager does */
+struct GovernanceVoteTestingSetup : public TestingSetup
+{
+    std::vector<CKey> vKeys;
+    std::vector<COutPoint> vOutpoints;
+    int64_t nTime;
+
+    GovernanceVoteTestingSetup() : vKeys(3), nTime(GetTime())
+    {
+        for (size_t i = 0; i < vKeys.size(); i++) {
+            vKeys[i].MakeNewKey(true);
+            vOutpoints.push_back(COutPoint(uint256S("10"), i));
+            AddMasternode(i);
+        }
+    }
+
+    ~GovernanceVoteTestingSetup()
+    {
+        mnodeman.Clear();
+        SetMockTime(0);
+    }
+
+    void AddMasternode(size_t nMasternode)
+    {
+        CMasternode mn(CService(), vOutpoints[nMasternode], vKeys[nMasternode].GetPubKey(), vKeys[nMasternode].GetPubKey(), PROTOCOL_VERSION);
+        BOOST_CHECK(mnodeman.Add(mn));
+    }
+
+    bool Vote(CGovernanceObject& govobj, size_t nMasternode, vote_signal_enum_t eSignal, vote_outcome_enum_t eOutcome)
+    {
+        // Each vote is newer than the previous one, so changed votes are not obsolete
+        SetMockTime(++nTime);
+        // Votes refer to the object by its cached hash
+        CGovernanceVote vote(vOutpoints[nMasternode], govobj.GetHash(), eSignal, eOutcome);
+        BOOST_CHECK(vote.Sign(vKeys[nMasternode], vKeys[nMasternode].GetPubKey()));
+        CGovernanceException exception;
+        return govobj.ProcessVote(NULL, vote, exception, *connman);
+    }
+
+    void ClearMasternodeVotes(CGovernanceObject& govobj)
+    {
+        govobj.ClearMasternodeVotes();
+    }
+};
+
+BOOST_FIXTURE_TEST_SUITE(governance_object_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(governance_object_hash)
+{
+    const std::string strData = HexStr(std::string("[[\"proposal\",{\"name\":\"test\"}]]"));
+    CGovernanceObject govobj(uint256(), 1, 1561000000, uint256S("01"), strData);
+    uint256 hash = govobj.GetHash();
+
+    // Copies and deserialized objects have the same hash
+    CGovernanceObject govobjCopy(govobj);
+    BOOST_CHECK(govobjCopy.GetHash() == hash);
+
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << govobj;
+    CGovernanceObject govobjRead;
+    BOOST_CHECK(govobjRead.GetHash() != hash);
+    ss >> govobjRead;
+    BOOST_CHECK(govobjRead.GetHash() == hash);
+
+    // Changing a hashed field updates the hash
+    govobj.SetMasternodeOutpoint(COutPoint(uint256S("02"), 0));
+    BOOST_CHECK(govobj.GetHash() != hash);
+    ss << govobj;
+    ss >> govobjRead;
+    BOOST_CHECK(govobjRead.GetHash() == govobj.GetHash());
+
+    // Objects without votes don't count any
+    BOOST_CHECK_EQUAL(govobjRead.GetYesCount(VOTE_SIGNAL_FUNDING), 0);
+    BOOST_CHECK_EQUAL(govobjRead.GetAbsoluteYesCount(VOTE_SIGNAL_FUNDING), 0);
+}
+
+/** Check the running vote counts against the counts rebuilt when the object is read back from disk */
+static void CheckVoteCounts(const CGovernanceObject& govobj)
+{
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << govobj;
+    CGovernanceObject govobjRecount;
+    ss >> govobjRecount;
+    BOOST_CHECK(govobjRecount.GetHash() == govobj.GetHash());
+    for (int nSignal = VOTE_SIGNAL_FUNDING; nSignal <= VOTE_SIGNAL_ENDORSED; nSignal++) {
+        for (int nOutcome = VOTE_OUTCOME_NONE; nOutcome <= VOTE_OUTCOME_ABSTAIN; nOutcome++) {
+            BOOST_CHECK_EQUAL(govobj.CountMatchingVotes(vote_signal_enum_t(nSignal), vote_outcome_enum_t(nOutcome)),
+                              govobjRecount.CountMatchingVotes(vote_signal_enum_t(nSignal), vote_outcome_enum_t(nOutcome)));
+        }
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(governance_object_vote_counts, GovernanceVoteTestingSetup)
+{
+    const std::string strData = HexStr(std::string("[[\"proposal\",{\"name\":\"test\"}]]"));
+    CGovernanceObject govobj(uint256(), 1, 1561000000, uint256S("01"), strData);
+    const uint256 hash = govobj.GetHash();
+
+    BOOST_CHECK(Vote(govobj, 0, VOTE_SIGNAL_FUNDING, VOTE_OUTCOME_YES));
+    BOOST_CHECK(Vote(govobj, 1, VOTE_SIGNAL_FUNDING, VOTE_OUTCOME_YES));
+    BOOST_CHECK(Vote(govobj, 2, VOTE_SIGNAL_FUNDING, VOTE_OUTCOME_NO));
+    BOOST_CHECK(Vote(govobj, 2, VOTE_SIGNAL_VALID, VOTE_OUTCOME_YES));
+    BOOST_CHECK_EQUAL(govobj.GetYesCount(VOTE_SIGNAL_FUNDING), 2);
+    BOOST_CHECK_EQUAL(govobj.GetNoCount(VOTE_SIGNAL_FUNDING), 1);
+    BOOST_CHECK_EQUAL(govobj.GetAbsoluteYesCount(VOTE_SIGNAL_FUNDING), 1);
+    BOOST_CHECK_EQUAL(govobj.GetYesCount(VOTE_SIGNAL_VALID), 1);
+    CheckVoteCounts(govobj);
+
+    // A changed vote moves from one outcome to the other
+    BOOST_CHECK(Vote(govobj, 1, VOTE_SIGNAL_FUNDING, VOTE_OUTCOME_ABSTAIN));
+    BOOST_CHECK(Vote(govobj, 2, VOTE_SIGNAL_FUNDING, VOTE_OUTCOME_YES));
+    BOOST_CHECK_EQUAL(govobj.GetYesCount(VOTE_SIGNAL_FUNDING), 2);
+    BOOST_CHECK_EQUAL(govobj.GetNoCount(VOTE_SIGNAL_FUNDING), 0);
+    BOOST_CHECK_EQUAL(govobj.GetAbstainCount(VOTE_SIGNAL_FUNDING), 1);
+    CheckVoteCounts(govobj);
+
+    // Votes don't change the object's hash
+    BOOST_CHECK(govobj.GetHash() == hash);
+
+    // Votes of masternodes that are gone are removed from the counts
+    mnodeman.Clear();
+    AddMasternode(0);
+    AddMasternode(1);
+    ClearMasternodeVotes(govobj);
+    BOOST_CHECK_EQUAL(govobj.GetYesCount(VOTE_SIGNAL_FUNDING), 1);
+    BOOST_CHECK_EQUAL(govobj.GetAbstainCount(VOTE_SIGNAL_FUNDING), 1);
+    BOOST_CHECK_EQUAL(govobj.GetYesCount(VOTE_SIGNAL_VALID), 0);
+    CheckVoteCounts(govobj);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
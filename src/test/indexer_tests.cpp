@@ -0,0 +1,220 @@
+// Copyright (c) 2018 The SecureTag Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "chainparams.h"
+#include "consensus/validation.h"
+#include "indexer.h"
+#include "key.h"
+#include "script/standard.h"
+#include "txdb.h"
+#include "undo.h"
+#include "utiltime.h"
+#include "validation.h"
+#include "validationinterface.h"
+
+#include "test/test_securetag.h"
+
+#include <algorithm>
+
+#include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
+
+// Expose the per block writes of the indexers
+class TestAddressIndexer : public CAddressIndexer
+{
+public:
+    using CAddressIndexer::WriteBlock;
+    using CAddressIndexer::RewindBlock;
+};
+
+class TestSpentIndexer : public CSpentIndexer
+{
+public:
+    using CSpentIndexer::WriteBlock;
+    using CSpentIndexer::RewindBlock;
+};
+
+class TestTimestampIndexer : public CTimestampIndexer
+{
+public:
+    using CTimestampIndexer::WriteBlock;
+    using CTimestampIndexer::RewindBlock;
+};
+
+static bool HasTimestampEntry(const CBlockIndex* pindex)
+{
+    std::vector<uint256> hashes;
+    BOOST_CHECK(pblocktree->ReadTimestampIndex(pindex->nTime, pindex->nTime, hashes));
+    return std::find(hashes.begin(), hashes.end(), pindex->GetBlockHash()) != hashes.end();
+}
+
+// Wait for an indexer thread to catch up with the active chain
+static bool WaitForSync(CBaseIndexer& indexer)
+{
+    std::string strError;
+    for (int i = 0; i < 1000 && !indexer.IsReady(strError); i++)
+        MilliSleep(10);
+    return indexer.BlockUntilSyncedToCurrentChain(10 * 1000, strError);
+}
+
+BOOST_FIXTURE_TEST_SUITE(indexer_tests, TestChain100Setup)
+
+BOOST_AUTO_TEST_CASE(indexer_write_rewind)
+{
+    CScript scriptPubKey = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+    const uint160 hashCoinbase = coinbaseKey.GetPubKey().GetID();
+    CKey keyDest;
+    keyDest.MakeNewKey(true);
+    const uint160 hashDest = keyDest.GetPubKey().GetID();
+
+    // Spend the first coinbase to a new address
+    CMutableTransaction spend;
+    spend.nVersion = 1;
+    spend.vin.resize(1);
+    spend.vin[0].prevout = COutPoint(coinbaseTxns[0].GetHash(), 0);
+    spend.vout.resize(1);
+    spend.vout[0].nValue = 11*CENT;
+    spend.vout[0].scriptPubKey = GetScriptForDestination(keyDest.GetPubKey().GetID());
+    std::vector<unsigned char> vchSig;
+    uint256 hash = SignatureHash(scriptPubKey, spend, 0, SIGHASH_ALL);
+    BOOST_CHECK(coinbaseKey.Sign(hash, vchSig));
+    vchSig.push_back((unsigned char)SIGHASH_ALL);
+    spend.vin[0].scriptSig << vchSig;
+
+    CBlock block = CreateAndProcessBlock(std::vector<CMutableTransaction>(1, spend), scriptPubKey);
+    const CBlockIndex* pindex = chainActive.Tip();
+    BOOST_CHECK(pindex->GetBlockHash() == block.GetHash());
+    CBlockUndo blockundo;
+    BOOST_CHECK(UndoReadFromDisk(blockundo, pindex->GetUndoPos(), pindex->pprev->GetBlockHash()));
+
+    TestAddressIndexer addressIndexer;
+    TestSpentIndexer spentIndexer;
+    TestTimestampIndexer timestampIndexer;
+    BOOST_CHECK(addressIndexer.WriteBlock(block, blockundo, pindex));
+    BOOST_CHECK(spentIndexer.WriteBlock(block, blockundo, pindex));
+    BOOST_CHECK(timestampIndexer.WriteBlock(block, blockundo, pindex));
+
+    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
+    BOOST_CHECK(pblocktree->ReadAddressIndex(hashDest, 1, addressIndex));
+    BOOST_CHECK_EQUAL(addressIndex.size(), 1U);
+    BOOST_CHECK_EQUAL(addressIndex[0].second, 11*CENT);
+    BOOST_CHECK_EQUAL(addressIndex[0].first.blockHeight, pindex->nHeight);
+    BOOST_CHECK(!addressIndex[0].first.spending);
+
+    addressIndex.clear();
+    BOOST_CHECK(pblocktree->ReadAddressIndex(hashCoinbase, 1, addressIndex));
+    bool fFoundSpend = false;
+    for (const auto& entry : addressIndex) {
+        if (entry.first.spending && entry.first.txhash == spend.GetHash())
+            fFoundSpend = entry.second == -coinbaseTxns[0].vout[0].nValue;
+    }
+    BOOST_CHECK(fFoundSpend);
+
+    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspentOutputs;
+    BOOST_CHECK(pblocktree->ReadAddressUnspentIndex(hashDest, 1, unspentOutputs));
+    BOOST_CHECK_EQUAL(unspentOutputs.size(), 1U);
+    BOOST_CHECK_EQUAL(unspentOutputs[0].second.satoshis, 11*CENT);
+
+    CSpentIndexKey spentKey(coinbaseTxns[0].GetHash(), 0);
+    CSpentIndexValue spentValue;
+    BOOST_CHECK(pblocktree->ReadSpentIndex(spentKey, spentValue));
+    BOOST_CHECK(spentValue.txid == spend.GetHash());
+    BOOST_CHECK_EQUAL(spentValue.inputIndex, 0U);
+    BOOST_CHECK_EQUAL(spentValue.blockHeight, pindex->nHeight);
+    BOOST_CHECK(spentValue.addressHash == hashCoinbase);
+
+    BOOST_CHECK(HasTimestampEntry(pindex));
+
+    // Rewinding the block removes its entries and restores the spent output
+    BOOST_CHECK(addressIndexer.RewindBlock(block, blockundo, pindex));
+    BOOST_CHECK(spentIndexer.RewindBlock(block, blockundo, pindex));
+    BOOST_CHECK(timestampIndexer.RewindBlock(block, blockundo, pindex));
+
+    addressIndex.clear();
+    BOOST_CHECK(pblocktree->ReadAddressIndex(hashDest, 1, addressIndex));
+    BOOST_CHECK(addressIndex.empty());
+    unspentOutputs.clear();
+    BOOST_CHECK(pblocktree->ReadAddressUnspentIndex(hashDest, 1, unspentOutputs));
+    BOOST_CHECK(unspentOutputs.empty());
+
+    unspentOutputs.clear();
+    BOOST_CHECK(pblocktree->ReadAddressUnspentIndex(hashCoinbase, 1, unspentOutputs));
+    bool fRestored = false;
+    for (const auto& output : unspentOutputs) {
+        if (output.first.txhash == coinbaseTxns[0].GetHash() && output.first.index == 0)
+            fRestored = output.second.satoshis == coinbaseTxns[0].vout[0].nValue && output.second.blockHeight == 1;
+    }
+    BOOST_CHECK(fRestored);
+
+    BOOST_CHECK(!pblocktree->ReadSpentIndex(spentKey, spentValue));
+    BOOST_CHECK(!HasTimestampEntry(pindex));
+}
+
+BOOST_AUTO_TEST_CASE(indexer_upgrade_legacy)
+{
+    // An index written while connecting blocks continues from the tip
+    BOOST_CHECK(pblocktree->WriteFlag("addressindex", true));
+    CBaseIndexer::UpgradeLegacyIndex("addressindex");
+    uint256 hashBest;
+    bool fLegacy = true;
+    BOOST_CHECK(pblocktree->ReadIndexBestBlock("addressindex", hashBest));
+    BOOST_CHECK(hashBest == chainActive.Tip()->GetBlockHash());
+    BOOST_CHECK(pblocktree->ReadFlag("addressindex", fLegacy));
+    BOOST_CHECK(!fLegacy);
+
+    CAddressIndexer addressIndexer;
+    BOOST_CHECK(addressIndexer.Init());
+    BOOST_CHECK_EQUAL(addressIndexer.GetBestHeight(), chainActive.Height());
+
+    // An index that was never written starts from the genesis block
+    CBaseIndexer::UpgradeLegacyIndex("spentindex");
+    BOOST_CHECK(!pblocktree->ReadIndexBestBlock("spentindex", hashBest));
+    CSpentIndexer spentIndexer;
+    BOOST_CHECK(spentIndexer.Init());
+    BOOST_CHECK_EQUAL(spentIndexer.GetBestHeight(), -1);
+}
+
+BOOST_AUTO_TEST_CASE(indexer_resume_reorg)
+{
+    // Resume after a block in the middle of the chain
+    const int nResumeHeight = 50;
+    BOOST_CHECK(pblocktree->WriteIndexBestBlock("timestampindex", chainActive[nResumeHeight]->GetBlockHash()));
+    CTimestampIndexer indexer;
+    BOOST_CHECK(indexer.Init());
+    BOOST_CHECK_EQUAL(indexer.GetBestHeight(), nResumeHeight);
+
+    RegisterValidationInterface(&indexer);
+    boost::thread thread(boost::bind(&CBaseIndexer::ThreadSync, &indexer));
+
+    BOOST_CHECK(WaitForSync(indexer));
+    BOOST_CHECK_EQUAL(indexer.GetBestHeight(), chainActive.Height());
+    BOOST_CHECK(!HasTimestampEntry(chainActive[nResumeHeight]));
+    BOOST_CHECK(HasTimestampEntry(chainActive[nResumeHeight + 1]));
+    BOOST_CHECK(HasTimestampEntry(chainActive.Tip()));
+    uint256 hashBest;
+    BOOST_CHECK(pblocktree->ReadIndexBestBlock("timestampindex", hashBest));
+    BOOST_CHECK(hashBest == chainActive.Tip()->GetBlockHash());
+
+    // Disconnecting the tip rewinds it from the index
+    CBlockIndex* pindexOldTip = chainActive.Tip();
+    CValidationState state;
+    {
+        LOCK(cs_main);
+        InvalidateBlock(state, Params(), pindexOldTip);
+    }
+    ActivateBestChain(state, Params());
+    BOOST_CHECK(chainActive.Tip() == pindexOldTip->pprev);
+
+    std::string strError;
+    BOOST_CHECK(indexer.BlockUntilSyncedToCurrentChain(10 * 1000, strError));
+    BOOST_CHECK_EQUAL(indexer.GetBestHeight(), chainActive.Height());
+    BOOST_CHECK(!HasTimestampEntry(pindexOldTip));
+    BOOST_CHECK(HasTimestampEntry(chainActive.Tip()));
+
+    thread.interrupt();
+    thread.join();
+    UnregisterValidationInterface(&indexer);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
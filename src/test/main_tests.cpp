@@ -2,10 +2,16 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include "crypto/neoscrypt.h"
 #include "net.h"
+#include "streams.h"
+#include "validation.h"
+#include "version.h"
 
 #include "test/test_securetag.h"
 
+#include <thread>
+
 #include <boost/signals2/signal.hpp>
 #include <boost/test/unit_test.hpp>
 
@@ -27,4 +33,86 @@ BOOST_AUTO_TEST_CASE(test_combiner_all)
     Test.disconnect(&ReturnTrue);
     BOOST_CHECK(Test());
 }
+
+BOOST_AUTO_TEST_CASE(block_header_hash_batch)
+{
+    std::vector<CBlockHeader> headers(64);
+    for (size_t i = 0; i < headers.size(); i++) {
+        headers[i].nVersion = 4;
+        headers[i].nTime = 1540526903 + i;
+        headers[i].nBits = 0x1e0ffff0;
+        headers[i].nNonce = i;
+    }
+
+    std::vector<uint256> vHashes;
+    GetBlockHeaderHashes(headers, vHashes);
+    BOOST_CHECK_EQUAL(vHashes.size(), headers.size());
+    for (size_t i = 0; i < headers.size(); i++)
+        BOOST_CHECK(vHashes[i] == headers[i].GetHash());
+
+    GetBlockHeaderHashes(std::vector<CBlockHeader>(), vHashes);
+    BOOST_CHECK(vHashes.empty());
+}
+
+static uint256 UncachedHash(const CBlockHeader& header)
+{
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << header;
+    uint256 hash;
+    neoscrypt((unsigned char*)ss.data(), (unsigned char*)&hash, 0);
+    return hash;
+}
+
+BOOST_AUTO_TEST_CASE(block_header_hash_cache)
+{
+    CBlock block;
+    block.nVersion = 4;
+    block.nTime = 1540526903;
+    block.nBits = 0x1e0ffff0;
+    const uint256 hash = block.GetHash();
+    BOOST_CHECK(block.GetHash() == hash);
+    BOOST_CHECK(UncachedHash(block) == hash);
+
+    // Every header field change invalidates the cached hash
+    block.nNonce++;
+    BOOST_CHECK(block.GetHash() != hash);
+    BOOST_CHECK(block.GetHash() == UncachedHash(block));
+    block.nNonce--;
+    BOOST_CHECK(block.GetHash() == hash);
+    block.hashPrevBlock = hash;
+    BOOST_CHECK(block.GetHash() == UncachedHash(block));
+    block.hashMerkleRoot = hash;
+    BOOST_CHECK(block.GetHash() == UncachedHash(block));
+    block.nTime++;
+    BOOST_CHECK(block.GetHash() == UncachedHash(block));
+    block.nBits = 0x1d00ffff;
+    BOOST_CHECK(block.GetHash() == UncachedHash(block));
+    block.nVersion++;
+    BOOST_CHECK(block.GetHash() == UncachedHash(block));
+
+    // Copies carry the stored hash along, and stay independent afterwards
+    CBlockHeader header = block.GetBlockHeader();
+    CBlock copy(block);
+    BOOST_CHECK(header.GetHash() == block.GetHash());
+    BOOST_CHECK(copy.GetHash() == block.GetHash());
+    copy.nNonce++;
+    BOOST_CHECK(copy.GetHash() == UncachedHash(copy));
+    BOOST_CHECK(copy.GetHash() != block.GetHash());
+    header = copy;
+    BOOST_CHECK(header.GetHash() == copy.GetHash());
+    block.SetNull();
+    BOOST_CHECK(block.GetHash() == UncachedHash(block));
+
+    // Threads sharing a header all get its hash, whichever one stores it
+    const CBlock shared(copy);
+    std::vector<uint256> vHashes(4);
+    std::vector<std::thread> threads;
+    for (uint256& hashThread : vHashes)
+        threads.emplace_back([&shared, &hashThread] { hashThread = shared.GetHash(); });
+    for (std::thread& thread : threads)
+        thread.join();
+    for (const uint256& hashThread : vHashes)
+        BOOST_CHECK(hashThread == UncachedHash(copy));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
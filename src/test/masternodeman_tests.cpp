@@ -0,0 +1,170 @@
+// Copyright (c) 2018 The SecureTag Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "chainparams.h"
+#include "consensus/validation.h"
+#include "masternode-sync.h"
+#include "masternodeman.h"
+#include "script/standard.h"
+#include "validation.h"
+#include "validationinterface.h"
+
+#include "test/test_securetag.h"
+
+#include <boost/test/unit_test.hpp>
+
+// Hand collateral spends to mnodeman, as CDSNotificationInterface does
+struct CollateralSpendListener : public CValidationInterface
+{
+    void SyncTransaction(const CTransaction& tx, const CBlockIndex* pindex, int posInBlock) override
+    {
+        mnodeman.SyncTransaction(tx, pindex, posInBlock);
+    }
+};
+
+struct MasternodeManTestingSetup : public TestChain100Setup
+{
+    MasternodeManTestingSetup()
+    {
+        mnodeman.Clear();
+        SetListSynced(true);
+    }
+
+    ~MasternodeManTestingSetup()
+    {
+        mnodeman.Clear();
+        masternodeSync.Reset();
+    }
+
+    void SetListSynced(bool fSynced)
+    {
+        masternodeSync.Reset();
+        if (!fSynced) return;
+        // initial -> waiting -> list -> winners
+        for (int i = 0; i < 3; i++)
+            masternodeSync.SwitchToNextAsset(*connman);
+        BOOST_CHECK(masternodeSync.IsMasternodeListSynced());
+    }
+
+    COutPoint AddMasternode(uint32_t n, int nActiveState = CMasternode::MASTERNODE_ENABLED)
+    {
+        CKey key;
+        key.MakeNewKey(true);
+        COutPoint outpoint(uint256S("10"), n);
+        CMasternode mn(CService(), outpoint, key.GetPubKey(), key.GetPubKey(), PROTOCOL_VERSION);
+        mn.nActiveState = nActiveState;
+        BOOST_CHECK(mnodeman.Add(mn));
+        return outpoint;
+    }
+
+    bool IsCollateralSpent(const COutPoint& outpoint)
+    {
+        masternode_info_t mnInfo;
+        BOOST_CHECK(mnodeman.GetMasternodeInfo(outpoint, mnInfo));
+        return mnInfo.nActiveState == CMasternode::MASTERNODE_OUTPOINT_SPENT;
+    }
+
+    size_t CountRanks()
+    {
+        CMasternodeMan::rank_pair_vec_t vecRanks;
+        mnodeman.GetMasternodeRanks(vecRanks);
+        return vecRanks.size();
+    }
+};
+
+BOOST_FIXTURE_TEST_SUITE(masternodeman_tests, MasternodeManTestingSetup)
+
+BOOST_AUTO_TEST_CASE(masternode_rank_cache)
+{
+    std::vector<COutPoint> vOutpoints;
+    for (uint32_t i = 0; i < 3; i++)
+        vOutpoints.push_back(AddMasternode(i));
+    BOOST_CHECK_EQUAL(CountRanks(), 3U);
+
+    // Adding a masternode invalidates the cached ranks
+    const COutPoint outpointSpent = AddMasternode(3, CMasternode::MASTERNODE_OUTPOINT_SPENT);
+    BOOST_CHECK_EQUAL(CountRanks(), 4U);
+    int nRank;
+    BOOST_CHECK(mnodeman.GetMasternodeRank(outpointSpent, nRank));
+    BOOST_CHECK(nRank >= 1 && nRank <= 4);
+
+    // So does removing one
+    mnodeman.CheckAndRemove(*connman);
+    BOOST_CHECK(!mnodeman.Has(outpointSpent));
+    BOOST_CHECK_EQUAL(CountRanks(), 3U);
+    BOOST_CHECK(!mnodeman.GetMasternodeRank(outpointSpent, nRank));
+    BOOST_CHECK_EQUAL(nRank, -1);
+    for (const auto& outpoint : vOutpoints) {
+        BOOST_CHECK(mnodeman.GetMasternodeRank(outpoint, nRank));
+        BOOST_CHECK(nRank >= 1 && nRank <= 3);
+    }
+
+    // Cached ranks are not served once the list is no longer synced
+    SetListSynced(false);
+    BOOST_CHECK_EQUAL(CountRanks(), 0U);
+    BOOST_CHECK(!mnodeman.GetMasternodeRank(vOutpoints[0], nRank));
+    SetListSynced(true);
+    BOOST_CHECK_EQUAL(CountRanks(), 3U);
+}
+
+BOOST_AUTO_TEST_CASE(masternode_collateral_reorg)
+{
+    CollateralSpendListener listener;
+    RegisterValidationInterface(&listener);
+
+    CKey key;
+    key.MakeNewKey(true);
+    const COutPoint outpoint(coinbaseTxns[0].GetHash(), 0);
+    CMasternode mn(CService(), outpoint, key.GetPubKey(), key.GetPubKey(), PROTOCOL_VERSION);
+    BOOST_CHECK(mnodeman.Add(mn));
+    mnodeman.Check();
+    BOOST_CHECK(!IsCollateralSpent(outpoint));
+
+    // Spending the collateral in a block marks the masternode spent
+    CScript scriptPubKey = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+    CMutableTransaction spend;
+    spend.nVersion = 1;
+    spend.vin.resize(1);
+    spend.vin[0].prevout = outpoint;
+    spend.vout.resize(1);
+    spend.vout[0].nValue = 11*CENT;
+    spend.vout[0].scriptPubKey = GetScriptForDestination(key.GetPubKey().GetID());
+    std::vector<unsigned char> vchSig;
+    uint256 hash = SignatureHash(scriptPubKey, spend, 0, SIGHASH_ALL);
+    BOOST_CHECK(coinbaseKey.Sign(hash, vchSig));
+    vchSig.push_back((unsigned char)SIGHASH_ALL);
+    spend.vin[0].scriptSig << vchSig;
+
+    CreateAndProcessBlock(std::vector<CMutableTransaction>(1, spend), scriptPubKey);
+    CBlockIndex* pindexSpend = chainActive.Tip();
+    BOOST_CHECK(IsCollateralSpent(outpoint));
+    mnodeman.Check();
+    BOOST_CHECK(IsCollateralSpent(outpoint));
+
+    // Disconnecting the block makes the next check look the collateral up,
+    // and finds it unspent again
+    CValidationState state;
+    {
+        LOCK(cs_main);
+        InvalidateBlock(state, Params(), pindexSpend);
+    }
+    ActivateBestChain(state, Params());
+    BOOST_CHECK(chainActive.Tip() == pindexSpend->pprev);
+    BOOST_CHECK(!IsCollateralSpent(outpoint));
+    mnodeman.Check();
+    BOOST_CHECK(!IsCollateralSpent(outpoint));
+
+    // Connecting it again spends the collateral again
+    {
+        LOCK(cs_main);
+        ResetBlockFailureFlags(pindexSpend);
+    }
+    ActivateBestChain(state, Params());
+    BOOST_CHECK(chainActive.Tip() == pindexSpend);
+    BOOST_CHECK(IsCollateralSpent(outpoint));
+
+    UnregisterValidationInterface(&listener);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
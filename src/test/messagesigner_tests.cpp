@@ -0,0 +1,56 @@
+// Copyright (c) 2018 The SecureTag Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "messagesigner.h"
+#include "random.h"
+
+#include "test/test_securetag.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(messagesigner_tests, TestingSetup)
+
+BOOST_AUTO_TEST_CASE(messagesigner_verify_hashes)
+{
+    std::vector<CKey> vKeys(8);
+    std::vector<uint256> vHashes;
+    std::vector<std::vector<unsigned char> > vSigs(vKeys.size());
+    for (size_t i = 0; i < vKeys.size(); i++) {
+        vKeys[i].MakeNewKey(true);
+        vHashes.push_back(GetRandHash());
+        BOOST_CHECK(CHashSigner::SignHash(vHashes[i], vKeys[i], vSigs[i]));
+    }
+
+    // Every other check is given the wrong key or a wrong hash
+    std::vector<CHashSignatureCheck> vChecks;
+    for (size_t i = 0; i < vKeys.size(); i++) {
+        if (i % 4 == 1)
+            vChecks.push_back(CHashSignatureCheck(vHashes[i], vKeys[(i + 1) % vKeys.size()].GetPubKey().GetID(), vSigs[i]));
+        else if (i % 4 == 3)
+            vChecks.push_back(CHashSignatureCheck(GetRandHash(), vKeys[i].GetPubKey().GetID(), vSigs[i]));
+        else
+            vChecks.push_back(CHashSignatureCheck(vHashes[i], vKeys[i].GetPubKey().GetID(), vSigs[i]));
+    }
+    for (size_t i = 0; i < vKeys.size(); i++)
+        BOOST_CHECK(!IsMessageSignatureCached(vHashes[i], vKeys[i].GetPubKey().GetID(), vSigs[i]));
+    CHashSigner::VerifyHashes(vChecks);
+
+    // The batch stored the valid signatures, and only those, in the cache
+    for (size_t i = 0; i < vKeys.size(); i++) {
+        BOOST_CHECK_EQUAL(IsMessageSignatureCached(vHashes[i], vKeys[i].GetPubKey().GetID(), vSigs[i]), i % 2 == 0);
+        BOOST_CHECK(!IsMessageSignatureCached(vHashes[i], vKeys[(i + 1) % vKeys.size()].GetPubKey().GetID(), vSigs[i]));
+    }
+
+    // Checking again gives the same results, whether cached or not, and
+    // caches the rest of the valid signatures
+    std::string strError;
+    for (size_t i = 0; i < vKeys.size(); i++) {
+        BOOST_CHECK(CHashSigner::VerifyHash(vHashes[i], vKeys[i].GetPubKey(), vSigs[i], strError));
+        BOOST_CHECK(IsMessageSignatureCached(vHashes[i], vKeys[i].GetPubKey().GetID(), vSigs[i]));
+        BOOST_CHECK(!CHashSigner::VerifyHash(vHashes[i], vKeys[(i + 1) % vKeys.size()].GetPubKey(), vSigs[i], strError));
+        BOOST_CHECK(!CHashSigner::VerifyHash(GetRandHash(), vKeys[i].GetPubKey(), vSigs[i], strError));
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
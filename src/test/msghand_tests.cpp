@@ -0,0 +1,264 @@
+// Copyright (c) 2018 The SecureTag Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+// Unit tests for message handling on several msghand threads
+
+#include "blockencodings.h"
+#include "chainparams.h"
+#include "consensus/validation.h"
+#include "miner.h"
+#include "net.h"
+#include "net_processing.h"
+#include "netmessagemaker.h"
+#include "pow.h"
+#include "spork.h"
+#include "timedata.h"
+#include "validation.h"
+
+#include "test/test_securetag.h"
+
+#include <atomic>
+#include <list>
+#include <thread>
+
+#include <boost/test/unit_test.hpp>
+
+struct MsgHandSetup : public TestChain100Setup {
+    // Store a block forking off chainActive at nForkHeight without connecting
+    // it, so it has nChainTx set but is not BLOCK_VALID_SCRIPTS
+    CBlockIndex* ProcessSideChainBlock(int nForkHeight)
+    {
+        const CChainParams& chainparams = Params();
+        CBlockIndex* pindexTip = chainActive.Tip();
+        CBlockIndex* pindexFirst = chainActive[nForkHeight + 1];
+        CValidationState state;
+        {
+            LOCK(cs_main);
+            InvalidateBlock(state, chainparams, pindexFirst);
+        }
+        ActivateBestChain(state, chainparams);
+        BOOST_CHECK_EQUAL(chainActive.Height(), nForkHeight);
+
+        // A different payee keeps the block apart from the one invalidated
+        CKey key;
+        key.MakeNewKey(true);
+        CScript scriptPubKey = CScript() << ToByteVector(key.GetPubKey()) << OP_CHECKSIG;
+        std::unique_ptr<CBlockTemplate> pblocktemplate = BlockAssembler(chainparams).CreateNewBlock(nullptr, chainparams, scriptPubKey, false);
+        CBlock& block = pblocktemplate->block;
+        block.vtx.resize(1);
+        unsigned int extraNonce = 0;
+        IncrementExtraNonce(&block, chainActive.Tip(), extraNonce);
+        while (!CheckProofOfWork(block.GetHash(), block.nBits, chainparams.GetConsensus())) ++block.nNonce;
+
+        {
+            LOCK(cs_main);
+            ResetBlockFailureFlags(pindexFirst);
+        }
+        ActivateBestChain(state, chainparams);
+        BOOST_CHECK(chainActive.Tip() == pindexTip);
+
+        std::shared_ptr<const CBlock> shared_pblock = std::make_shared<const CBlock>(block);
+        BOOST_CHECK(ProcessNewBlock(chainparams, shared_pblock, true, NULL));
+
+        LOCK(cs_main);
+        BOOST_CHECK(chainActive.Tip() == pindexTip);
+        CBlockIndex* pindex = mapBlockIndex[block.GetHash()];
+        BOOST_CHECK(pindex->nChainTx && !pindex->IsValid(BLOCK_VALID_SCRIPTS));
+        return pindex;
+    }
+};
+
+static void InitTestNode(CNode& node, CConnman& connman)
+{
+    node.SetSendVersion(PROTOCOL_VERSION);
+    node.SetRecvVersion(PROTOCOL_VERSION);
+    node.nVersion = PROTOCOL_VERSION;
+    node.fSuccessfullyConnected = true;
+    GetNodeSignals().InitializeNode(&node, connman);
+}
+
+// Hand a message to the node as the socket handler would
+static void QueueMessage(CNode& node, CSerializedNetMsg&& msg)
+{
+    CSharedNetMsg shared = CConnman::MakeSharedMsg(std::move(msg));
+    std::list<CNetMessage> msgs;
+    node.recvMsgPool.Take(msgs);
+    CNetMessage& netmsg = msgs.front();
+    netmsg.readHeader((const char*)shared.header->data(), shared.header->size());
+    if (!shared.data->empty())
+        netmsg.readData((const char*)shared.data->data(), shared.data->size());
+    assert(netmsg.complete());
+
+    LOCK(node.cs_vProcessMsg);
+    node.nProcessQueueSize += shared.data->size() + CMessageHeader::HEADER_SIZE;
+    node.vProcessMsg.splice(node.vProcessMsg.end(), msgs);
+}
+
+// Drop what was sent, as the socket handler would once it is written out
+static void ClearSendQueue(CNode& node)
+{
+    LOCK(node.cs_vSend);
+    node.vSendMsg.clear();
+    node.nSendSize = 0;
+    node.fPauseSend = false;
+}
+
+// Process queued messages until none are left, as one msghand thread would
+static void ProcessAllMessages(CNode& node, CConnman& connman, const std::atomic<bool>& interrupt)
+{
+    do {
+        ClearSendQueue(node);
+    } while (ProcessMessages(&node, connman, interrupt) && !node.fDisconnect);
+    ClearSendQueue(node);
+}
+
+static uint64_t SentBytes(CNode& node, const std::string& strCommand)
+{
+    CNodeStats stats;
+    node.copyStats(stats);
+    return stats.mapSendBytesPerMsgCmd[strCommand];
+}
+
+BOOST_FIXTURE_TEST_SUITE(msghand_tests, MsgHandSetup)
+
+BOOST_AUTO_TEST_CASE(getblocktxn_deep_block)
+{
+    std::atomic<bool> interruptDummy(false);
+    CAddress addr(CService(), NODE_NONE);
+    CNode node(0, NODE_NETWORK, 0, INVALID_SOCKET, addr, 0, 0, "", true);
+    InitTestNode(node, *connman);
+
+    // A block too deep for blocktxn is answered with the full block, but only
+    // on the next pass of the processing loop, where cs_main is not held
+    BlockTransactionsRequest req;
+    req.blockhash = chainActive[chainActive.Height() - MAX_BLOCKTXN_DEPTH - 10]->GetBlockHash();
+    QueueMessage(node, CNetMsgMaker(PROTOCOL_VERSION).Make(NetMsgType::GETBLOCKTXN, req));
+    BOOST_CHECK(ProcessMessages(&node, *connman, interruptDummy));
+    BOOST_CHECK_EQUAL(node.vRecvGetData.size(), 1U);
+    BOOST_CHECK_EQUAL(SentBytes(node, NetMsgType::BLOCK), 0U);
+
+    BOOST_CHECK(!ProcessMessages(&node, *connman, interruptDummy));
+    BOOST_CHECK(node.vRecvGetData.empty());
+    BOOST_CHECK(SentBytes(node, NetMsgType::BLOCK) > 0);
+    BOOST_CHECK(!node.fDisconnect);
+
+    bool fUpdateConnectionTime = false;
+    GetNodeSignals().FinalizeNode(node.GetId(), fUpdateConnectionTime);
+}
+
+BOOST_AUTO_TEST_CASE(msghand_threads_activate_chain)
+{
+    // Serving a stored side chain block runs ActivateBestChain first, while
+    // another peer's block message runs it from ProcessNewBlock. Each takes
+    // cs_activatebestchain before cs_main, so the two threads must not
+    // deadlock.
+    CBlockIndex* pindexTip = chainActive.Tip();
+    CBlockIndex* pindexSide = ProcessSideChainBlock(chainActive.Height() - MAX_BLOCKTXN_DEPTH - 10);
+    CBlock blockSide;
+    BOOST_CHECK(ReadBlockFromDisk(blockSide, pindexSide, Params().GetConsensus()));
+
+    std::atomic<bool> interruptDummy(false);
+    CAddress addr(CService(), NODE_NONE);
+    CNode node1(1, NODE_NETWORK, 0, INVALID_SOCKET, addr, 1, 1, "", true);
+    CNode node2(2, NODE_NETWORK, 0, INVALID_SOCKET, addr, 2, 2, "", true);
+    InitTestNode(node1, *connman);
+    InitTestNode(node2, *connman);
+
+    static const int nRounds = 50;
+    BlockTransactionsRequest req;
+    req.blockhash = pindexSide->GetBlockHash();
+    std::thread threadGetBlockTxn([&] {
+        for (int i = 0; i < nRounds; i++) {
+            QueueMessage(node1, CNetMsgMaker(PROTOCOL_VERSION).Make(NetMsgType::GETBLOCKTXN, req));
+            ProcessAllMessages(node1, *connman, interruptDummy);
+        }
+    });
+    std::thread threadBlock([&] {
+        for (int i = 0; i < nRounds; i++) {
+            QueueMessage(node2, CNetMsgMaker(PROTOCOL_VERSION).Make(NetMsgType::BLOCK, blockSide));
+            ProcessAllMessages(node2, *connman, interruptDummy);
+        }
+    });
+    threadGetBlockTxn.join();
+    threadBlock.join();
+
+    BOOST_CHECK(node1.vRecvGetData.empty());
+    BOOST_CHECK(!node1.fDisconnect);
+    BOOST_CHECK(!node2.fDisconnect);
+    BOOST_CHECK(chainActive.Tip() == pindexTip);
+
+    bool fUpdateConnectionTime = false;
+    GetNodeSignals().FinalizeNode(node1.GetId(), fUpdateConnectionTime);
+    GetNodeSignals().FinalizeNode(node2.GetId(), fUpdateConnectionTime);
+}
+
+BOOST_AUTO_TEST_CASE(extension_message_dispatch)
+{
+    // Every message type of the extension modules reaches the modules that
+    // processed it before the dispatch table, in the same order
+    std::vector<std::pair<std::string, std::vector<std::string> > > vExpected = {
+#ifdef ENABLE_WALLET
+        {NetMsgType::DSQUEUE, {"privatesend-client", "privatesend-server"}},
+        {NetMsgType::DSSTATUSUPDATE, {"privatesend-client"}},
+        {NetMsgType::DSFINALTX, {"privatesend-client"}},
+        {NetMsgType::DSCOMPLETE, {"privatesend-client"}},
+#else
+        {NetMsgType::DSQUEUE, {"privatesend-server"}},
+#endif // ENABLE_WALLET
+        {NetMsgType::DSACCEPT, {"privatesend-server"}},
+        {NetMsgType::DSVIN, {"privatesend-server"}},
+        {NetMsgType::DSSIGNFINALTX, {"privatesend-server"}},
+        {NetMsgType::MNANNOUNCE, {"masternodeman"}},
+        {NetMsgType::MNPING, {"masternodeman"}},
+        {NetMsgType::DSEG, {"masternodeman"}},
+        {NetMsgType::MNVERIFY, {"masternodeman"}},
+        {NetMsgType::MASTERNODEPAYMENTSYNC, {"mnpayments"}},
+        {NetMsgType::MASTERNODEPAYMENTVOTE, {"mnpayments"}},
+        {NetMsgType::TXLOCKVOTE, {"instantsend"}},
+        {NetMsgType::SPORK, {"spork"}},
+        {NetMsgType::GETSPORKS, {"spork"}},
+        {NetMsgType::SYNCSTATUSCOUNT, {"masternode-sync"}},
+        {NetMsgType::SYNCSTATUSCOUNTFN, {"fundamentalnode-sync"}},
+        {NetMsgType::MNGOVERNANCESYNC, {"governance"}},
+        {NetMsgType::MNGOVERNANCEOBJECT, {"governance"}},
+        {NetMsgType::MNGOVERNANCEOBJECTVOTE, {"governance"}},
+    };
+    CExtensionMessageStats stats;
+    for (const auto& expected : vExpected) {
+        BOOST_CHECK(GetExtensionMessageStats(expected.first, stats));
+        BOOST_CHECK_MESSAGE(stats.vModules == expected.second, expected.first);
+    }
+
+    // Messages processed in ProcessMessage itself are known but have no
+    // handler, anything else is unknown
+    BOOST_CHECK(GetExtensionMessageStats(NetMsgType::PING, stats));
+    BOOST_CHECK(stats.vModules.empty());
+    BOOST_CHECK(!GetExtensionMessageStats("nosuchcmd", stats));
+
+    // A spork with a bad signature goes through the spork manager, which
+    // punishes the peer, and is counted
+    std::atomic<bool> interruptDummy(false);
+    CAddress addr(CService(), NODE_NONE);
+    CNode node(3, NODE_NETWORK, 0, INVALID_SOCKET, addr, 3, 3, "", true);
+    InitTestNode(node, *connman);
+
+    BOOST_CHECK(GetExtensionMessageStats(NetMsgType::SPORK, stats));
+    const int64_t nCountBefore = stats.nCount;
+    const int64_t nTimeBefore = stats.nTimeMicros;
+    CSporkMessage spork(SPORK_2_INSTANTSEND_ENABLED, 0, GetAdjustedTime());
+    QueueMessage(node, CNetMsgMaker(PROTOCOL_VERSION).Make(NetMsgType::SPORK, spork));
+    ProcessAllMessages(node, *connman, interruptDummy);
+
+    BOOST_CHECK(GetExtensionMessageStats(NetMsgType::SPORK, stats));
+    BOOST_CHECK_EQUAL(stats.nCount, nCountBefore + 1);
+    BOOST_CHECK(stats.nTimeMicros >= nTimeBefore);
+    CNodeStateStats nodeStats;
+    BOOST_CHECK(GetNodeStateStats(node.GetId(), nodeStats));
+    BOOST_CHECK_EQUAL(nodeStats.nMisbehavior, 100);
+
+    bool fUpdateConnectionTime = false;
+    GetNodeSignals().FinalizeNode(node.GetId(), fUpdateConnectionTime);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
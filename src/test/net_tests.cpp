@@ -3,12 +3,14 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 #include "addrman.h"
 #include "test/test_securetag.h"
+#include <algorithm>
 #include <string>
 #include <boost/test/unit_test.hpp>
 #include "hash.h"
 #include "serialize.h"
 #include "streams.h"
 #include "net.h"
+#include "netmessagemaker.h"
 #include "netbase.h"
 #include "chainparams.h"
 
@@ -70,6 +72,95 @@ CDataStream AddrmanToStream(CAddrManSerializationMock& _addrman)
     return CDataStream(vchData, SER_DISK, CLIENT_VERSION);
 }
 
+// Drives the socket handler of a connman that was not started, one pass at a time
+struct CConnmanTest
+{
+    static void AddNode(CConnman& connman, CNode* pnode, bool fEpoll)
+    {
+#ifdef USE_EPOLL
+        if (fEpoll && connman.epollfd == -1)
+            connman.epollfd = epoll_create1(EPOLL_CLOEXEC);
+        BOOST_REQUIRE(!fEpoll || connman.epollfd != -1);
+#endif
+        connman.nReceiveFloodSize = 5 * 1000 * 1000;
+        connman.AddNodeToVector(pnode);
+    }
+
+    static void RemoveNode(CConnman& connman, CNode* pnode)
+    {
+        LOCK(connman.cs_vNodes);
+        connman.vNodes.erase(std::remove(connman.vNodes.begin(), connman.vNodes.end(), pnode), connman.vNodes.end());
+    }
+
+    static void ServiceSockets(CConnman& connman, std::set<CNode*>& setNodesPending)
+    {
+        connman.ServiceSockets(setNodesPending);
+    }
+};
+
+#ifdef USE_POLL
+static void SendAll(int fd, const std::vector<unsigned char>& vBytes)
+{
+    BOOST_REQUIRE_EQUAL(send(fd, vBytes.data(), vBytes.size(), MSG_DONTWAIT), (ssize_t)vBytes.size());
+}
+
+static void SendMessage(int fd, CSerializedNetMsg&& msg)
+{
+    CSharedNetMsg shared = CConnman::MakeSharedMsg(std::move(msg));
+    SendAll(fd, *shared.header);
+    SendAll(fd, *shared.data);
+}
+
+static size_t ProcessQueueSize(CNode* pnode)
+{
+    LOCK(pnode->cs_vProcessMsg);
+    return pnode->vProcessMsg.size();
+}
+
+// A node must stay pending until its socket is drained: with edge-triggered
+// events, readiness left over is not reported again
+static void CheckSocketDrained(bool fEpoll)
+{
+    CConnman connman(0x1337, 0x1337);
+    int fds[2];
+    BOOST_REQUIRE(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+    int nSendBuffer = 1 << 20;
+    setsockopt(fds[1], SOL_SOCKET, SO_SNDBUF, &nSendBuffer, sizeof(nSendBuffer));
+    in_addr ipv4Addr;
+    ipv4Addr.s_addr = 0xa0b0c001;
+    CAddress addr = CAddress(CService(ipv4Addr, 7777), NODE_NETWORK);
+    CNode* pnode = new CNode(0, NODE_NETWORK, 0, fds[0], addr, 0, 0, "", true);
+    CConnmanTest::AddNode(connman, pnode, fEpoll);
+    std::set<CNode*> setNodesPending;
+
+    // More than one recv() buffer takes several passes
+    SendMessage(fds[1], CNetMsgMaker(PROTOCOL_VERSION).Make("blob", std::vector<unsigned char>(100000)));
+    CConnmanTest::ServiceSockets(connman, setNodesPending);
+    BOOST_CHECK(setNodesPending.count(pnode));
+    BOOST_CHECK_EQUAL(ProcessQueueSize(pnode), 0U);
+    CConnmanTest::ServiceSockets(connman, setNodesPending);
+    BOOST_CHECK(setNodesPending.count(pnode));
+    BOOST_CHECK_EQUAL(ProcessQueueSize(pnode), 1U);
+
+    // Dropped once recv() would block
+    CConnmanTest::ServiceSockets(connman, setNodesPending);
+    BOOST_CHECK(!setNodesPending.count(pnode));
+    BOOST_CHECK(!pnode->fHasRecvData);
+
+    // New data is reported again
+    SendMessage(fds[1], CNetMsgMaker(PROTOCOL_VERSION).Make(NetMsgType::PING, (uint64_t)42));
+    CConnmanTest::ServiceSockets(connman, setNodesPending);
+    BOOST_CHECK_EQUAL(ProcessQueueSize(pnode), 2U);
+    CConnmanTest::ServiceSockets(connman, setNodesPending);
+    BOOST_CHECK(!setNodesPending.count(pnode));
+    BOOST_CHECK(!pnode->fDisconnect);
+
+    CConnmanTest::RemoveNode(connman, pnode);
+    delete pnode;
+    close(fds[1]);
+}
+#endif
+
 BOOST_FIXTURE_TEST_SUITE(net_tests, BasicTestingSetup)
 
 BOOST_AUTO_TEST_CASE(caddrdb_read)
@@ -172,4 +263,89 @@ BOOST_AUTO_TEST_CASE(cnode_simple_test)
     BOOST_CHECK(pnode2->fFeeler == false);
 }
 
+BOOST_AUTO_TEST_CASE(cnode_shared_message)
+{
+    CConnman connman(0x1337, 0x1337);
+    in_addr ipv4Addr;
+    ipv4Addr.s_addr = 0xa0b0c001;
+    CAddress addr = CAddress(CService(ipv4Addr, 7777), NODE_NETWORK);
+    std::unique_ptr<CNode> pnode1(new CNode(0, NODE_NETWORK, 0, INVALID_SOCKET, addr, 0, 0, "", false));
+    std::unique_ptr<CNode> pnode2(new CNode(1, NODE_NETWORK, 0, INVALID_SOCKET, addr, 1, 1, "", false));
+
+    CSharedNetMsg msg = CConnman::MakeSharedMsg(CNetMsgMaker(PROTOCOL_VERSION).Make(NetMsgType::PING, (uint64_t)42));
+    BOOST_CHECK_EQUAL(msg.command, NetMsgType::PING);
+    BOOST_CHECK_EQUAL(msg.header->size(), CMessageHeader::HEADER_SIZE);
+    BOOST_CHECK_EQUAL(msg.data->size(), 8U);
+
+    CMessageHeader hdr(Params().MessageStart());
+    CDataStream ssHeader(*msg.header, SER_NETWORK, INIT_PROTO_VERSION);
+    ssHeader >> hdr;
+    BOOST_CHECK(hdr.IsValid(Params().MessageStart()));
+    BOOST_CHECK_EQUAL(hdr.nMessageSize, 8U);
+    uint256 hash = Hash(msg.data->begin(), msg.data->end());
+    BOOST_CHECK(memcmp(hash.begin(), hdr.pchChecksum, CMessageHeader::CHECKSUM_SIZE) == 0);
+
+    // Both peers queue the same buffers instead of copies
+    connman.PushMessage(pnode1.get(), msg);
+    connman.PushMessage(pnode2.get(), msg);
+    BOOST_CHECK_EQUAL(pnode1->vSendMsg.size(), 2U);
+    BOOST_CHECK_EQUAL(pnode2->vSendMsg.size(), 2U);
+    BOOST_CHECK(pnode1->vSendMsg[0] == pnode2->vSendMsg[0]);
+    BOOST_CHECK(pnode1->vSendMsg[1] == pnode2->vSendMsg[1]);
+    BOOST_CHECK_EQUAL(pnode1->nSendSize, CMessageHeader::HEADER_SIZE + 8U);
+}
+
+BOOST_AUTO_TEST_CASE(cnetmessage_pool)
+{
+    CSharedNetMsg msg = CConnman::MakeSharedMsg(CNetMsgMaker(PROTOCOL_VERSION).Make(NetMsgType::PING, (uint64_t)42));
+    std::vector<unsigned char> vBytes(msg.header->begin(), msg.header->end());
+    vBytes.insert(vBytes.end(), msg.data->begin(), msg.data->end());
+
+    CNetMessagePool pool;
+    std::list<CNetMessage> msgs;
+    pool.Take(msgs);
+    BOOST_CHECK_EQUAL(msgs.size(), 1U);
+    const CNetMessage* pmsg = &msgs.front();
+    for (int i = 0; i < 2; i++) {
+        CNetMessage& netmsg = msgs.front();
+        BOOST_CHECK_EQUAL(netmsg.readHeader((const char*)vBytes.data(), vBytes.size()), (int)CMessageHeader::HEADER_SIZE);
+        BOOST_CHECK_EQUAL(netmsg.readData((const char*)vBytes.data() + CMessageHeader::HEADER_SIZE, 8), 8);
+        BOOST_CHECK(netmsg.complete());
+        BOOST_CHECK(memcmp(netmsg.GetMessageHash().begin(), netmsg.hdr.pchChecksum, CMessageHeader::CHECKSUM_SIZE) == 0);
+        uint64_t nonce = 0;
+        netmsg.vRecv >> nonce;
+        BOOST_CHECK_EQUAL(nonce, 42U);
+
+        // The processed message goes back to the pool and is handed out again, reset
+        pool.Give(msgs);
+        BOOST_CHECK(msgs.empty());
+        BOOST_CHECK_EQUAL(pool.size(), 1U);
+        pool.Take(msgs);
+        BOOST_CHECK_EQUAL(pool.size(), 0U);
+        BOOST_CHECK(&msgs.front() == pmsg);
+        BOOST_CHECK(!msgs.front().in_data);
+        BOOST_CHECK_EQUAL(msgs.front().nDataPos, 0U);
+    }
+
+    // The pool is bounded
+    for (size_t i = 0; i < MAX_POOLED_RECV_MSGS + 5; i++)
+        pool.Take(msgs);
+    pool.Give(msgs);
+    BOOST_CHECK_EQUAL(pool.size(), MAX_POOLED_RECV_MSGS);
+}
+
+#ifdef USE_EPOLL
+BOOST_AUTO_TEST_CASE(socket_events_epoll_drain)
+{
+    CheckSocketDrained(true);
+}
+#endif
+
+#ifdef USE_POLL
+BOOST_AUTO_TEST_CASE(socket_events_poll_drain)
+{
+    CheckSocketDrained(false);
+}
+#endif
+
 BOOST_AUTO_TEST_SUITE_END()
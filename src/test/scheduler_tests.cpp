@@ -4,6 +4,7 @@
 
 #include "random.h"
 #include "scheduler.h"
+#include "utiltime.h"
 
 #include "test/test_securetag.h"
 
@@ -13,6 +14,8 @@
 #include <boost/thread.hpp>
 #include <boost/test/unit_test.hpp>
 
+#include <atomic>
+
 BOOST_AUTO_TEST_SUITE(scheduler_tests)
 
 static void microTask(CScheduler& s, boost::mutex& mutex, int& counter, int delta, boost::chrono::system_clock::time_point rescheduleTime)
@@ -114,4 +117,71 @@ BOOST_AUTO_TEST_CASE(manythreads)
     BOOST_CHECK_EQUAL(counterSum, 200);
 }
 
+BOOST_AUTO_TEST_CASE(singlethreadedscheduler_ordered)
+{
+    CScheduler scheduler;
+
+    // each queue should be well ordered with respect to itself but not other queues
+    SingleThreadedSchedulerClient queue1(&scheduler);
+    SingleThreadedSchedulerClient queue2(&scheduler);
+
+    // create more threads than queues
+    // if the queues only permit execution of one task at once then
+    // the extra threads should effectively be doing nothing
+    // if they don't we'll get out of order behaviour
+    boost::thread_group threads;
+    for (int i = 0; i < 5; ++i) {
+        threads.create_thread(boost::bind(&CScheduler::serviceQueue, &scheduler));
+    }
+
+    // these are not atomic, if SingleThreadedSchedulerClient prevents
+    // parallel execution at the queue level no synchronization should be required here
+    int counter1 = 0;
+    int counter2 = 0;
+
+    // just simply count up on each queue - if execution is properly ordered then
+    // the callbacks should run in exactly the order in which they were enqueued
+    for (int i = 0; i < 100; ++i) {
+        queue1.AddToProcessQueue([i, &counter1]() {
+            BOOST_CHECK_EQUAL(i, counter1++);
+        });
+
+        queue2.AddToProcessQueue([i, &counter2]() {
+            BOOST_CHECK_EQUAL(i, counter2++);
+        });
+    }
+
+    // finish up
+    scheduler.stop(true);
+    threads.join_all();
+
+    BOOST_CHECK_EQUAL(counter1, 100);
+    BOOST_CHECK_EQUAL(counter2, 100);
+}
+
+BOOST_AUTO_TEST_CASE(singlethreadedscheduler_emptyqueue_waits)
+{
+    CScheduler scheduler;
+    SingleThreadedSchedulerClient queue(&scheduler);
+    boost::thread schedulerThread(boost::bind(&CScheduler::serviceQueue, &scheduler));
+
+    // EmptyQueue must not return while the scheduler thread is still inside
+    // a callback, even though nothing is left in the queue
+    std::atomic<bool> fStarted(false);
+    std::atomic<bool> fFinished(false);
+    queue.AddToProcessQueue([&fStarted, &fFinished]() {
+        fStarted = true;
+        MilliSleep(200);
+        fFinished = true;
+    });
+    while (!fStarted)
+        MilliSleep(1);
+    BOOST_CHECK_EQUAL(queue.CallbacksPending(), 0U);
+    queue.EmptyQueue();
+    BOOST_CHECK(fFinished);
+
+    scheduler.stop(true);
+    schedulerThread.join();
+}
+
 BOOST_AUTO_TEST_SUITE_END()
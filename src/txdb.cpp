@@ -12,6 +12,7 @@
 #include "ui_interface.h"
 #include "init.h"
 
+#include <set>
 #include <stdint.h>
 
 #include <boost/thread.hpp>
@@ -22,6 +23,7 @@ static const char DB_BLOCK_FILES = 'f';
 static const char DB_TXINDEX = 't';
 static const char DB_ADDRESSINDEX = 'a';
 static const char DB_ADDRESSUNSPENTINDEX = 'u';
+static const char DB_ADDRESSBALANCEINDEX = 'A';
 static const char DB_TIMESTAMPINDEX = 's';
 static const char DB_SPENTINDEX = 'p';
 static const char DB_BLOCK_INDEX = 'b';
@@ -30,6 +32,7 @@ static const char DB_BEST_BLOCK = 'B';
 static const char DB_FLAG = 'F';
 static const char DB_REINDEX_FLAG = 'R';
 static const char DB_LAST_BLOCK = 'l';
+static const char DB_INDEX_BEST_BLOCK = 'I';
 
 namespace {
 
@@ -260,6 +263,7 @@ bool CBlockTreeDB::ReadAddressUnspentIndex(uint160 addressHash, int type,
 
 bool CBlockTreeDB::WriteAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount > >&vect) {
     CDBBatch batch(*this);
+    UpdateAddressBalanceIndex(batch, vect, false);
     for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=vect.begin(); it!=vect.end(); it++)
         batch.Write(std::make_pair(DB_ADDRESSINDEX, it->first), it->second);
     return WriteBatch(batch);
@@ -267,11 +271,109 @@ bool CBlockTreeDB::WriteAddressIndex(const std::vector<std::pair<CAddressIndexKe
 
 bool CBlockTreeDB::EraseAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount > >&vect) {
     CDBBatch batch(*this);
+    UpdateAddressBalanceIndex(batch, vect, true);
     for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=vect.begin(); it!=vect.end(); it++)
         batch.Erase(std::make_pair(DB_ADDRESSINDEX, it->first));
     return WriteBatch(batch);
 }
 
+void CBlockTreeDB::UpdateAddressBalanceIndex(CDBBatch &batch, const std::vector<std::pair<CAddressIndexKey, CAmount> > &vect, bool fErase) {
+    // Only entries that are really added or removed change the totals, so writing
+    // or erasing the entries of a block a second time leaves them as they are
+    std::map<std::pair<unsigned int, uint160>, CAddressBalanceValue> mapBalances;
+    std::set<std::pair<std::pair<unsigned int, uint160>, uint256> > setAddressTxs;
+    const CAmount nSign = fErase ? -1 : 1;
+    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=vect.begin(); it!=vect.end(); it++) {
+        if (Exists(std::make_pair(DB_ADDRESSINDEX, it->first)) != fErase)
+            continue;
+
+        std::pair<unsigned int, uint160> address(it->first.type, it->first.hashBytes);
+        std::map<std::pair<unsigned int, uint160>, CAddressBalanceValue>::iterator mi = mapBalances.find(address);
+        if (mi == mapBalances.end()) {
+            mi = mapBalances.insert(std::make_pair(address, CAddressBalanceValue())).first;
+            Read(std::make_pair(DB_ADDRESSBALANCEINDEX, CAddressIndexIteratorKey(address.first, address.second)), mi->second);
+        }
+
+        mi->second.balance += nSign * it->second;
+        if (it->second > 0)
+            mi->second.received += nSign * it->second;
+        if (setAddressTxs.insert(std::make_pair(address, it->first.txhash)).second) {
+            if (fErase)
+                mi->second.txCount--;
+            else
+                mi->second.txCount++;
+        }
+    }
+
+    for (std::map<std::pair<unsigned int, uint160>, CAddressBalanceValue>::const_iterator mi=mapBalances.begin(); mi!=mapBalances.end(); mi++) {
+        CAddressIndexIteratorKey key(mi->first.first, mi->first.second);
+        if (mi->second.IsNull())
+            batch.Erase(std::make_pair(DB_ADDRESSBALANCEINDEX, key));
+        else
+            batch.Write(std::make_pair(DB_ADDRESSBALANCEINDEX, key), mi->second);
+    }
+}
+
+bool CBlockTreeDB::ReadAddressBalanceIndex(uint160 addressHash, int type, CAddressBalanceValue &balance) {
+    bool fBuilt = false;
+    if (!ReadFlag("addressbalanceindex", fBuilt) || !fBuilt)
+        return false;
+
+    if (!Read(std::make_pair(DB_ADDRESSBALANCEINDEX, CAddressIndexIteratorKey(type, addressHash)), balance))
+        balance.SetNull();
+    return true;
+}
+
+bool CBlockTreeDB::BuildAddressBalanceIndex() {
+    std::unique_ptr<CDBIterator> pcursor(NewIterator());
+
+    pcursor->Seek(std::make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorKey()));
+
+    // The entries are sorted by address and then by block, so every address is
+    // summed up in one pass and the entries of a transaction are adjacent
+    CDBBatch batch(*this);
+    size_t batch_size = 1 << 24;
+    CAddressIndexIteratorKey address;
+    CAddressBalanceValue balance;
+    uint256 txhashLast;
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        std::pair<char,CAddressIndexKey> key;
+        if (!pcursor->GetKey(key) || key.first != DB_ADDRESSINDEX)
+            break;
+        CAmount nValue;
+        if (!pcursor->GetValue(nValue))
+            return error("failed to get address index value");
+
+        if (key.second.type != address.type || key.second.hashBytes != address.hashBytes) {
+            if (!balance.IsNull())
+                batch.Write(std::make_pair(DB_ADDRESSBALANCEINDEX, address), balance);
+            if (batch.SizeEstimate() > batch_size) {
+                if (!WriteBatch(batch))
+                    return false;
+                batch.Clear();
+            }
+            address = CAddressIndexIteratorKey(key.second.type, key.second.hashBytes);
+            balance.SetNull();
+            txhashLast.SetNull();
+        }
+
+        balance.balance += nValue;
+        if (nValue > 0)
+            balance.received += nValue;
+        if (key.second.txhash != txhashLast) {
+            balance.txCount++;
+            txhashLast = key.second.txhash;
+        }
+        pcursor->Next();
+    }
+
+    if (!balance.IsNull())
+        batch.Write(std::make_pair(DB_ADDRESSBALANCEINDEX, address), balance);
+    batch.Write(std::make_pair(DB_FLAG, std::string("addressbalanceindex")), '1');
+    return WriteBatch(batch, true);
+}
+
 bool CBlockTreeDB::ReadAddressIndex(uint160 addressHash, int type,
                                     std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
                                     int start, int end) {
@@ -312,6 +414,12 @@ bool CBlockTreeDB::WriteTimestampIndex(const CTimestampIndexKey &timestampIndex)
     return WriteBatch(batch);
 }
 
+bool CBlockTreeDB::EraseTimestampIndex(const CTimestampIndexKey &timestampIndex) {
+    CDBBatch batch(*this);
+    batch.Erase(std::make_pair(DB_TIMESTAMPINDEX, timestampIndex));
+    return WriteBatch(batch);
+}
+
 bool CBlockTreeDB::ReadTimestampIndex(const unsigned int &high, const unsigned int &low, std::vector<uint256> &hashes) {
 
     std::unique_ptr<CDBIterator> pcursor(NewIterator());
@@ -344,6 +452,14 @@ bool CBlockTreeDB::ReadFlag(const std::string &name, bool &fValue) {
     return true;
 }
 
+bool CBlockTreeDB::WriteIndexBestBlock(const std::string &name, const uint256 &hash) {
+    return Write(std::make_pair(DB_INDEX_BEST_BLOCK, name), hash);
+}
+
+bool CBlockTreeDB::ReadIndexBestBlock(const std::string &name, uint256 &hash) {
+    return Read(std::make_pair(DB_INDEX_BEST_BLOCK, name), hash);
+}
+
 bool CBlockTreeDB::LoadBlockIndexGuts(boost::function<CBlockIndex*(const uint256&)> insertBlockIndex)
 {
     std::unique_ptr<CDBIterator> pcursor(NewIterator());
@@ -17,6 +17,7 @@
 #include "consensus/merkle.h"
 #include "consensus/validation.h"
 #include "hash.h"
+#include "indexer.h"
 #include "init.h"
 #include "policy/policy.h"
 #include "pow.h"
@@ -1106,6 +1107,10 @@ bool GetTimestampIndex(const unsigned int &high, const unsigned int &low, std::v
     if (!fTimestampIndex)
         return error("Timestamp index not enabled");
 
+    std::string strError;
+    if (!IsIndexReady("timestampindex", strError))
+        return error("%s", strError);
+
     if (!pblocktree->ReadTimestampIndex(high, low, hashes))
         return error("Unable to get hashes for timestamps");
 
@@ -1120,6 +1125,11 @@ bool GetSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value)
     if (mempool.getSpentIndex(key, value))
         return true;
 
+    // Also used to decorate transactions, so don't log while it is syncing
+    std::string strError;
+    if (!IsIndexReady("spentindex", strError))
+        return false;
+
     if (!pblocktree->ReadSpentIndex(key, value))
         return false;
 
@@ -1132,18 +1142,58 @@ bool GetAddressIndex(uint160 addressHash, int type,
     if (!fAddressIndex)
         return error("address index not enabled");
 
+    std::string strError;
+    if (!IsIndexReady("addressindex", strError))
+        return error("%s", strError);
+
     if (!pblocktree->ReadAddressIndex(addressHash, type, addressIndex, start, end))
         return error("unable to get txids for address");
 
     return true;
 }
 
+bool GetAddressBalance(uint160 addressHash, int type, CAddressBalanceValue &balance)
+{
+    if (!fAddressIndex)
+        return error("address index not enabled");
+
+    std::string strError;
+    if (!IsIndexReady("addressindex", strError))
+        return error("%s", strError);
+
+    if (pblocktree->ReadAddressBalanceIndex(addressHash, type, balance))
+        return true;
+
+    // No total is stored for the address, sum up its entries instead
+    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
+    if (!pblocktree->ReadAddressIndex(addressHash, type, addressIndex))
+        return error("unable to get balance for address");
+
+    balance.SetNull();
+    uint256 txhashLast;
+    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=addressIndex.begin(); it!=addressIndex.end(); it++) {
+        if (it->second > 0)
+            balance.received += it->second;
+        balance.balance += it->second;
+        if (it->first.txhash != txhashLast) {
+            balance.txCount++;
+            txhashLast = it->first.txhash;
+        }
+    }
+
+    return true;
+}
+
 bool GetAddressUnspent(uint160 addressHash, int type,
                        std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs)
 {
     if (!fAddressIndex)
         return error("address index not enabled");
 
+    std::string strError;
+    if (!IsIndexReady("addressindex", strError))
+        return error("%s", strError);
+
     if (!pblocktree->ReadAddressUnspentIndex(addressHash, type, unspentOutputs))
         return error("unable to get txids for address");
 
@@ -1243,7 +1293,7 @@ bool WriteBlockToDisk(const CBlock& block, CDiskBlockPos& pos, const CMessageHea
     return true;
 }
 
-bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const Consensus::Params& consensusParams)
+static bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const Consensus::Params& consensusParams, bool fCheckPOW)
 {
     block.SetNull();
 
@@ -1261,20 +1311,75 @@ bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const Consensus:
     }
 
     // Check the header
-    if (block.IsProofOfWork() && !CheckProofOfWork(block.GetHash(), block.nBits, consensusParams))
+    if (fCheckPOW && block.IsProofOfWork() && !CheckProofOfWork(block.GetHash(), block.nBits, consensusParams))
         return error("ReadBlockFromDisk: Errors in block header at %s", pos.ToString());
 
     return true;
 }
 
-bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams)
+bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const Consensus::Params& consensusParams)
 {
+    return ReadBlockFromDisk(block, pos, consensusParams, true);
+}
 
-    if (!ReadBlockFromDisk(block, pindex->GetBlockPos(), consensusParams))
+bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams)
+{
+    // The header was fully checked (including proof of work) when pindex was
+    // created, and the index holds every header field. Comparing the fields
+    // read from disk against it is as strong as comparing hashes, without
+    // running NeoScrypt twice for every block we read back.
+    if (!ReadBlockFromDisk(block, pindex->GetBlockPos(), consensusParams, false))
         return false;
-    if (block.GetHash() != pindex->GetBlockHash())
-        return error("ReadBlockFromDisk(CBlock&, CBlockIndex*): GetHash() doesn't match index for %s at %s",
+    const CBlockHeader header = pindex->GetBlockHeader();
+    if (block.nVersion != header.nVersion || block.hashPrevBlock != header.hashPrevBlock ||
+        block.hashMerkleRoot != header.hashMerkleRoot || block.nTime != header.nTime ||
+        block.nBits != header.nBits || block.nNonce != header.nNonce)
+        return error("ReadBlockFromDisk(CBlock&, CBlockIndex*): block header doesn't match index for %s at %s",
+                pindex->ToString(), pindex->GetBlockPos().ToString());
+    return true;
+}
+
+bool ReadRawBlockFromDisk(std::vector<unsigned char>& vchBlock, const CBlockIndex* pindex, const CMessageHeader::MessageStartChars& messageStart)
+{
+    vchBlock.clear();
+
+    // Step back over the index header written in front of the block
+    CDiskBlockPos pos = pindex->GetBlockPos();
+    if (pos.nPos < 8)
+        return error("ReadRawBlockFromDisk: no index header for %s at %s", pindex->ToString(), pos.ToString());
+    pos.nPos -= 8;
+
+    CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull())
+        return error("ReadRawBlockFromDisk: OpenBlockFile failed for %s", pos.ToString());
+
+    try {
+        CMessageHeader::MessageStartChars blockMessageStart;
+        unsigned int nSize;
+        filein >> FLATDATA(blockMessageStart) >> nSize;
+
+        if (memcmp(blockMessageStart, messageStart, CMessageHeader::MESSAGE_START_SIZE) != 0)
+            return error("ReadRawBlockFromDisk: block magic doesn't match for %s at %s", pindex->ToString(), pos.ToString());
+        if (nSize < CBlockHeader::HEADER_SIZE || nSize > MaxBlockSize(true))
+            return error("ReadRawBlockFromDisk: invalid block size %u for %s at %s", nSize, pindex->ToString(), pos.ToString());
+
+        vchBlock.resize(nSize);
+        filein.read((char*)vchBlock.data(), nSize);
+    }
+    catch (const std::exception& e) {
+        vchBlock.clear();
+        return error("%s: I/O error - %s at %s", __func__, e.what(), pos.ToString());
+    }
+
+    // As in ReadBlockFromDisk, the header must be the one the index was built from
+    CDataStream ssHeader(SER_DISK, CLIENT_VERSION);
+    ssHeader << pindex->GetBlockHeader();
+    if (ssHeader.size() != CBlockHeader::HEADER_SIZE || memcmp(ssHeader.data(), vchBlock.data(), CBlockHeader::HEADER_SIZE) != 0) {
+        vchBlock.clear();
+        return error("ReadRawBlockFromDisk: block header doesn't match index for %s at %s",
                 pindex->ToString(), pindex->GetBlockPos().ToString());
+    }
+
     return true;
 }
 
@@ -1666,6 +1771,32 @@ bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsVi
     return true;
 }
 
+bool UndoReadFromDisk(CBlockUndo& blockundo, const CDiskBlockPos& pos, const uint256& hashBlock)
+{
+    // Open history file to read
+    CAutoFile filein(OpenUndoFile(pos, true), SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull())
+        return error("%s: OpenUndoFile failed", __func__);
+
+    // Read block
+    uint256 hashChecksum;
+    CHashVerifier<CAutoFile> verifier(&filein); // We need a CHashVerifier as reserializing may lose data
+    try {
+        verifier << hashBlock;
+        verifier >> blockundo;
+        filein >> hashChecksum;
+    }
+    catch (const std::exception& e) {
+        return error("%s: Deserialize or I/O error - %s", __func__, e.what());
+    }
+
+    // Verify checksum
+    if (hashChecksum != verifier.GetHash())
+        return error("%s: Checksum mismatch", __func__);
+
+    return true;
+}
+
 namespace {
 
 bool UndoWriteToDisk(const CBlockUndo& blockundo, CDiskBlockPos& pos, const uint256& hashBlock, const CMessageHeader::MessageStartChars& messageStart)
@@ -1695,32 +1826,6 @@ bool UndoWriteToDisk(const CBlockUndo& blockundo, CDiskBlockPos& pos, const uint
     return true;
 }
 
-bool UndoReadFromDisk(CBlockUndo& blockundo, const CDiskBlockPos& pos, const uint256& hashBlock)
-{
-    // Open history file to read
-    CAutoFile filein(OpenUndoFile(pos, true), SER_DISK, CLIENT_VERSION);
-    if (filein.IsNull())
-        return error("%s: OpenUndoFile failed", __func__);
-
-    // Read block
-    uint256 hashChecksum;
-    CHashVerifier<CAutoFile> verifier(&filein); // We need a CHashVerifier as reserializing may lose data
-    try {
-        verifier << hashBlock;
-        verifier >> blockundo;
-        filein >> hashChecksum;
-    }
-    catch (const std::exception& e) {
-        return error("%s: Deserialize or I/O error - %s", __func__, e.what());
-    }
-
-    // Verify checksum
-    if (hashChecksum != verifier.GetHash())
-        return error("%s: Checksum mismatch", __func__);
-
-    return true;
-}
-
 /** Abort with a message */
 bool AbortNode(const std::string& strMessage, const std::string& userMessage="")
 {
@@ -1802,51 +1907,12 @@ static DisconnectResult DisconnectBlock(const CBlock& block, CValidationState& s
         return DISCONNECT_FAILED;
     }
 
-    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
-    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > addressUnspentIndex;
-    std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> > spentIndex;
-
     // undo transactions in reverse order
     for (int i = block.vtx.size() - 1; i >= 0; i--) {
         const CTransaction &tx = *(block.vtx[i]);
         uint256 hash = tx.GetHash();
         bool is_coinbase = tx.IsCoinBase();
 
-        if (fAddressIndex) {
-
-            for (unsigned int k = tx.vout.size(); k-- > 0;) {
-                const CTxOut &out = tx.vout[k];
-
-                if (out.scriptPubKey.IsPayToScriptHash()) {
-                    std::vector<unsigned char> hashBytes(out.scriptPubKey.begin()+2, out.scriptPubKey.begin()+22);
-
-                    // undo receiving activity
-                    addressIndex.push_back(std::make_pair(CAddressIndexKey(2, uint160(hashBytes), pindex->nHeight, i, hash, k, false), out.nValue));
-
-                    // undo unspent index
-                    addressUnspentIndex.push_back(std::make_pair(CAddressUnspentKey(2, uint160(hashBytes), hash, k), CAddressUnspentValue()));
-
-                } else if (out.scriptPubKey.IsPayToPublicKeyHash()) {
-                    std::vector<unsigned char> hashBytes(out.scriptPubKey.begin()+3, out.scriptPubKey.begin()+23);
-
-                    // undo receiving activity
-                    addressIndex.push_back(std::make_pair(CAddressIndexKey(1, uint160(hashBytes), pindex->nHeight, i, hash, k, false), out.nValue));
-
-                    // undo unspent index
-                    addressUnspentIndex.push_back(std::make_pair(CAddressUnspentKey(1, uint160(hashBytes), hash, k), CAddressUnspentValue()));
-
-                } else if (out.scriptPubKey.IsPayToPublicKey()) {
-                    uint160 hashBytes(Hash160(out.scriptPubKey.begin()+1, out.scriptPubKey.end()-1));
-                    addressIndex.push_back(std::make_pair(CAddressIndexKey(1, hashBytes, pindex->nHeight, i, hash, k, false), out.nValue));
-                    addressUnspentIndex.push_back(std::make_pair(CAddressUnspentKey(1, hashBytes, hash, k), CAddressUnspentValue()));
-                } else {
-                    continue;
-                }
-
-            }
-
-        }
-
         // Check that all outputs are available and match the outputs in the block itself
         // exactly.
         for (size_t o = 0; o < tx.vout.size(); o++) {
@@ -1869,49 +1935,9 @@ static DisconnectResult DisconnectBlock(const CBlock& block, CValidationState& s
             }
             for (unsigned int j = tx.vin.size(); j-- > 0;) {
                 const COutPoint &out = tx.vin[j].prevout;
-                int undoHeight = txundo.vprevout[j].nHeight;
                 int res = ApplyTxInUndo(std::move(txundo.vprevout[j]), view, out);
                 if (res == DISCONNECT_FAILED) return DISCONNECT_FAILED;
                 fClean = fClean && res != DISCONNECT_UNCLEAN;
-
-                const CTxIn input = tx.vin[j];
-
-                if (fSpentIndex) {
-                    // undo and delete the spent index
-                    spentIndex.push_back(std::make_pair(CSpentIndexKey(input.prevout.hash, input.prevout.n), CSpentIndexValue()));
-                }
-
-                if (fAddressIndex) {
-                    const Coin &coin = view.AccessCoin(tx.vin[j].prevout);
-                    const CTxOut &prevout = coin.out;
-                    if (prevout.scriptPubKey.IsPayToScriptHash()) {
-                        std::vector<unsigned char> hashBytes(prevout.scriptPubKey.begin()+2, prevout.scriptPubKey.begin()+22);
-
-                        // undo spending activity
-                        addressIndex.push_back(std::make_pair(CAddressIndexKey(2, uint160(hashBytes), pindex->nHeight, i, hash, j, true), prevout.nValue * -1));
-
-                        // restore unspent index
-                        addressUnspentIndex.push_back(std::make_pair(CAddressUnspentKey(2, uint160(hashBytes), input.prevout.hash, input.prevout.n), CAddressUnspentValue(prevout.nValue, prevout.scriptPubKey, undoHeight)));
-
-
-                    } else if (prevout.scriptPubKey.IsPayToPublicKeyHash()) {
-                        std::vector<unsigned char> hashBytes(prevout.scriptPubKey.begin()+3, prevout.scriptPubKey.begin()+23);
-
-                        // undo spending activity
-                        addressIndex.push_back(std::make_pair(CAddressIndexKey(1, uint160(hashBytes), pindex->nHeight, i, hash, j, true), prevout.nValue * -1));
-
-                        // restore unspent index
-                        addressUnspentIndex.push_back(std::make_pair(CAddressUnspentKey(1, uint160(hashBytes), input.prevout.hash, input.prevout.n), CAddressUnspentValue(prevout.nValue, prevout.scriptPubKey, undoHeight)));
-
-                    } else if (prevout.scriptPubKey.IsPayToPublicKey()) {
-                        uint160 hashBytes(Hash160(prevout.scriptPubKey.begin()+1, prevout.scriptPubKey.end()-1));
-                        addressIndex.push_back(std::make_pair(CAddressIndexKey(1, hashBytes, pindex->nHeight, i, hash, j, false), prevout.nValue));
-                        addressUnspentIndex.push_back(std::make_pair(CAddressUnspentKey(1, hashBytes, hash, j), CAddressUnspentValue()));
-                    } else {
-                        continue;
-                    }
-                }
-
             }
             // At this point, all of txundo.vprevout should have been moved out.
         }
@@ -1921,17 +1947,6 @@ static DisconnectResult DisconnectBlock(const CBlock& block, CValidationState& s
     // move best block pointer to prevout block
     view.SetBestBlock(pindex->pprev->GetBlockHash());
 
-    if (fAddressIndex) {
-        if (!pblocktree->EraseAddressIndex(addressIndex)) {
-            AbortNode(state, "Failed to delete address index");
-            return DISCONNECT_FAILED;
-        }
-        if (!pblocktree->UpdateAddressUnspentIndex(addressUnspentIndex)) {
-            AbortNode(state, "Failed to write address unspent index");
-            return DISCONNECT_FAILED;
-        }
-    }
-
     return fClean ? DISCONNECT_OK : DISCONNECT_UNCLEAN;
 }
 
@@ -1967,6 +1982,70 @@ void ThreadScriptCheck() {
     scriptcheckqueue.Thread();
 }
 
+/**
+ * Closure representing the NeoScrypt hash of one block header, computed on
+ * the header hash threads.
+ */
+class CBlockHeaderHashCheck
+{
+private:
+    const CBlockHeader *pheader;
+    uint256 *phash;
+
+public:
+    CBlockHeaderHashCheck(): pheader(NULL), phash(NULL) {}
+    CBlockHeaderHashCheck(const CBlockHeader* pheaderIn, uint256* phashIn) : pheader(pheaderIn), phash(phashIn) {}
+
+    bool operator()() {
+        *phash = pheader->GetHash();
+        return true;
+    }
+
+    void swap(CBlockHeaderHashCheck &check) {
+        std::swap(pheader, check.pheader);
+        std::swap(phash, check.phash);
+    }
+};
+
+static CCheckQueue<CBlockHeaderHashCheck> headerhashqueue(8);
+// Only one thread at a time may act as the master of headerhashqueue
+static CCriticalSection cs_headerhashqueue;
+
+void ThreadHeaderHash() {
+    RenameThread("securetag-hdrhash");
+    headerhashqueue.Thread();
+}
+
+void GetBlockHeaderHashes(const std::vector<const CBlockHeader*>& vpheaders, std::vector<uint256>& vHashes)
+{
+    vHashes.resize(vpheaders.size());
+
+    if (nScriptCheckThreads == 0 || vpheaders.size() < 2) {
+        for (size_t i = 0; i < vpheaders.size(); i++)
+            vHashes[i] = vpheaders[i]->GetHash();
+        return;
+    }
+
+    std::vector<CBlockHeaderHashCheck> vChecks;
+    vChecks.reserve(vpheaders.size());
+    for (size_t i = 0; i < vpheaders.size(); i++)
+        vChecks.push_back(CBlockHeaderHashCheck(vpheaders[i], &vHashes[i]));
+
+    LOCK(cs_headerhashqueue);
+    CCheckQueueControl<CBlockHeaderHashCheck> control(&headerhashqueue);
+    control.Add(vChecks);
+    control.Wait();
+}
+
+void GetBlockHeaderHashes(const std::vector<CBlockHeader>& headers, std::vector<uint256>& vHashes)
+{
+    std::vector<const CBlockHeader*> vpheaders;
+    vpheaders.reserve(headers.size());
+    for (const CBlockHeader& header : headers)
+        vpheaders.push_back(&header);
+    GetBlockHeaderHashes(vpheaders, vHashes);
+}
+
 // Protected by cs_main
 VersionBitsCache versionbitscache;
 
@@ -2127,6 +2206,15 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
                          REJECT_INVALID, "PoW-ended");
     }
 
+    // CheckBlock defers the kernel check when txPrev is not connected yet, the
+    // coins of this block's chain always have it
+    if (block.IsProofOfStake()) {
+        uint256 hashProofOfStake;
+        if (!CheckProofOfStake(block, pindex->pprev, view, hashProofOfStake))
+            return state.DoS(100, error("ConnectBlock(): check proof-of-stake failed for block %s", block.GetHash().ToString()),
+                             REJECT_INVALID, "bad-cs-kernel");
+    }
+
     bool fScriptChecks = true;
     if (!hashAssumeValid.IsNull()) {
         // We've been configured with the hash of a block which has been externally verified to have a valid history.
@@ -2246,9 +2334,6 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
     std::vector<std::pair<uint256, CDiskTxPos> > vPos;
     vPos.reserve(block.vtx.size());
     blockundo.vtxundo.reserve(block.vtx.size() - 1);
-    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
-    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > addressUnspentIndex;
-    std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> > spentIndex;
 
     bool fDIP0001Active_context = pindex->nHeight >= Params().GetConsensus().DIP0001Height;
     CAmount nValueOut = 0;
@@ -2256,7 +2341,6 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
     for (unsigned int i = 0; i < block.vtx.size(); i++)
     {
         const CTransaction &tx = *(block.vtx[i]);
-        const uint256 txhash = tx.GetHash();
 
         nInputs += tx.vin.size();
         nSigOps += GetLegacySigOpCount(tx);
@@ -2283,46 +2367,6 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
                                  REJECT_INVALID, "bad-txns-nonfinal");
             }
 
-            if (fAddressIndex || fSpentIndex)
-            {
-                for (size_t j = 0; j < tx.vin.size(); j++) {
-                    const CTxIn input = tx.vin[j];
-                    const Coin& coin = view.AccessCoin(tx.vin[j].prevout);
-                    const CTxOut &prevout = coin.out;
-                    uint160 hashBytes;
-                    int addressType;
-
-                    if (prevout.scriptPubKey.IsPayToScriptHash()) {
-                        hashBytes = uint160(std::vector<unsigned char>(prevout.scriptPubKey.begin()+2, prevout.scriptPubKey.begin()+22));
-                        addressType = 2;
-                    } else if (prevout.scriptPubKey.IsPayToPublicKeyHash()) {
-                        hashBytes = uint160(std::vector<unsigned char>(prevout.scriptPubKey.begin()+3, prevout.scriptPubKey.begin()+23));
-                        addressType = 1;
-                    } else if (prevout.scriptPubKey.IsPayToPublicKey()) {
-                        hashBytes = Hash160(prevout.scriptPubKey.begin()+1, prevout.scriptPubKey.end()-1);
-                        addressType = 1;
-                    } else {
-                        hashBytes.SetNull();
-                        addressType = 0;
-                    }
-
-                    if (fAddressIndex && addressType > 0) {
-                        // record spending activity
-                        addressIndex.push_back(std::make_pair(CAddressIndexKey(addressType, hashBytes, pindex->nHeight, i, txhash, j, true), prevout.nValue * -1));
-
-                        // remove address from unspent index
-                        addressUnspentIndex.push_back(std::make_pair(CAddressUnspentKey(addressType, hashBytes, input.prevout.hash, input.prevout.n), CAddressUnspentValue()));
-                    }
-
-                    if (fSpentIndex) {
-                        // add the spent index to determine the txid and input that spent an output
-                        // and to find the amount and address from an input
-                        spentIndex.push_back(std::make_pair(CSpentIndexKey(input.prevout.hash, input.prevout.n), CSpentIndexValue(txhash, j, pindex->nHeight, prevout.nValue, addressType, hashBytes)));
-                    }
-                }
-
-            }
-
             if (fStrictPayToScriptHash)
             {
                 // Add in sigops done by pay-to-script-hash inputs;
@@ -2348,38 +2392,6 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
             control.Add(vChecks);
         }
 
-        if (fAddressIndex) {
-            for (unsigned int k = 0; k < tx.vout.size(); k++) {
-                const CTxOut &out = tx.vout[k];
-
-                if (out.scriptPubKey.IsPayToScriptHash()) {
-                    std::vector<unsigned char> hashBytes(out.scriptPubKey.begin()+2, out.scriptPubKey.begin()+22);
-
-                    // record receiving activity
-                    addressIndex.push_back(std::make_pair(CAddressIndexKey(2, uint160(hashBytes), pindex->nHeight, i, txhash, k, false), out.nValue));
-
-                    // record unspent output
-                    addressUnspentIndex.push_back(std::make_pair(CAddressUnspentKey(2, uint160(hashBytes), txhash, k), CAddressUnspentValue(out.nValue, out.scriptPubKey, pindex->nHeight)));
-
-                } else if (out.scriptPubKey.IsPayToPublicKeyHash()) {
-                    std::vector<unsigned char> hashBytes(out.scriptPubKey.begin()+3, out.scriptPubKey.begin()+23);
-
-                    // record receiving activity
-                    addressIndex.push_back(std::make_pair(CAddressIndexKey(1, uint160(hashBytes), pindex->nHeight, i, txhash, k, false), out.nValue));
-
-                    // record unspent output
-                    addressUnspentIndex.push_back(std::make_pair(CAddressUnspentKey(1, uint160(hashBytes), txhash, k), CAddressUnspentValue(out.nValue, out.scriptPubKey, pindex->nHeight)));
-
-                } else if (out.scriptPubKey.IsPayToPublicKey()) {
-                    uint160 hashBytes(Hash160(out.scriptPubKey.begin()+1, out.scriptPubKey.end()-1));
-                    addressIndex.push_back(std::make_pair(CAddressIndexKey(1, hashBytes, pindex->nHeight, i, txhash, k, false), out.nValue));
-                    addressUnspentIndex.push_back(std::make_pair(CAddressUnspentKey(1, hashBytes, txhash, k), CAddressUnspentValue(out.nValue, out.scriptPubKey, pindex->nHeight)));
-                } else {
-                    continue;
-                }
-
-            }
-        }
         nValueOut += tx.GetValueOut();
         CTxUndo undoDummy;
         if (i > 0) {
@@ -2453,24 +2465,6 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
         if (!pblocktree->WriteTxIndex(vPos))
             return AbortNode(state, "Failed to write transaction index");
 
-    if (fAddressIndex) {
-        if (!pblocktree->WriteAddressIndex(addressIndex)) {
-            return AbortNode(state, "Failed to write address index");
-        }
-
-        if (!pblocktree->UpdateAddressUnspentIndex(addressUnspentIndex)) {
-            return AbortNode(state, "Failed to write address unspent index");
-        }
-    }
-
-    if (fSpentIndex)
-        if (!pblocktree->UpdateSpentIndex(spentIndex))
-            return AbortNode(state, "Failed to write transaction index");
-
-    if (fTimestampIndex)
-        if (!pblocktree->WriteTimestampIndex(CTimestampIndexKey(pindex->nTime, pindex->GetBlockHash())))
-            return AbortNode(state, "Failed to write timestamp index");
-
     // add this block to the view's block chain
     view.SetBestBlock(pindex->GetBlockHash());
 
@@ -2614,6 +2608,10 @@ void PruneAndFlush() {
 void static UpdateTip(CBlockIndex *pindexNew, const CChainParams& chainParams) {
     chainActive.SetTip(pindexNew);
 
+    // Update global DIP0001 activation status, the miner may build on the new tip
+    // before UpdatedBlockTip listeners hear about it
+    fDIP0001ActiveAtTip = pindexNew->nHeight >= chainParams.GetConsensus().DIP0001Height;
+
     // New best block
     mempool.AddTransactionsUpdated(1);
 
@@ -2813,26 +2811,30 @@ bool DisconnectBlocks(int blocks)
 
 void ReprocessBlocks(int nBlocks)
 {
-    LOCK(cs_main);
+    {
+        LOCK(cs_main);
 
-    std::map<uint256, int64_t>::iterator it = mapRejectedBlocks.begin();
-    while(it != mapRejectedBlocks.end()){
-        //use a window twice as large as is usual for the nBlocks we want to reset
-        if((*it).second  > GetTime() - (nBlocks*60*5)) {
-            BlockMap::iterator mi = mapBlockIndex.find((*it).first);
-            if (mi != mapBlockIndex.end() && (*mi).second) {
+        std::map<uint256, int64_t>::iterator it = mapRejectedBlocks.begin();
+        while(it != mapRejectedBlocks.end()){
+            //use a window twice as large as is usual for the nBlocks we want to reset
+            if((*it).second  > GetTime() - (nBlocks*60*5)) {
+                BlockMap::iterator mi = mapBlockIndex.find((*it).first);
+                if (mi != mapBlockIndex.end() && (*mi).second) {
 
-                CBlockIndex* pindex = (*mi).second;
-                LogPrintf("ReprocessBlocks -- %s\n", (*it).first.ToString());
+                    CBlockIndex* pindex = (*mi).second;
+                    LogPrintf("ReprocessBlocks -- %s\n", (*it).first.ToString());
 
-                ResetBlockFailureFlags(pindex);
+                    ResetBlockFailureFlags(pindex);
+                }
             }
+            ++it;
         }
-        ++it;
-    }
 
-    DisconnectBlocks(nBlocks);
+        DisconnectBlocks(nBlocks);
+    }
 
+    // ActivateBestChain takes cs_activatebestchain, which must not be
+    // acquired while holding cs_main.
     CValidationState state;
     ActivateBestChain(state, Params());
 }
@@ -3007,6 +3009,9 @@ static void NotifyHeaderTip() {
     }
 }
 
+/** Serializes ActivateBestChain callers; acquired before cs_main. */
+static CCriticalSection cs_activatebestchain;
+
 /**
  * Make the best chain active, in multiple steps. The result is either failure
  * or an activated best chain. pblock is either NULL or a pointer to a block
@@ -3018,6 +3023,11 @@ bool ActivateBestChain(CValidationState &state, const CChainParams& chainparams,
     // us in the middle of ProcessNewBlock - do not assume pblock is set
     // sanely for performance or correctness!
 
+    // Message handler threads may call us concurrently. Each step releases
+    // cs_main and signals the new tip, so without this lock the steps of
+    // two callers could interleave and deliver UpdatedBlockTip out of order.
+    LOCK(cs_activatebestchain);
+
     CBlockIndex *pindexMostWork = NULL;
     CBlockIndex *pindexNewTip = NULL;
     do {
@@ -3509,11 +3519,13 @@ bool CheckBlock(const CBlock& block, CValidationState& state, const Consensus::P
             }
         }
         
-        if(!CheckProofOfStake(block, hashProofOfStake)) {
+        // A stake whose txPrev is not connected yet is checked by ConnectBlock
+        bool fDeferred = false;
+        if(!CheckProofOfStake(block, hashProofOfStake, fDeferred)) {
             return state.DoS(100, error("CheckBlock(): check proof-of-stake failed for block %s\n", hash.ToString().c_str()));
         }
         
-        if(!mapProofOfStake.count(hash)) // add to mapProofOfStake
+        if(!fDeferred && !mapProofOfStake.count(hash)) // add to mapProofOfStake
             mapProofOfStake.insert(std::make_pair(hash, hashProofOfStake));
     }
 
@@ -3641,11 +3653,10 @@ bool ContextualCheckBlock(const CBlock& block, CValidationState& state, const Co
     return true;
 }
 
-static bool AcceptBlockHeader(const CBlockHeader& block, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex)
+static bool AcceptBlockHeader(const CBlockHeader& block, const uint256& hash, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex)
 {
     AssertLockHeld(cs_main);
     // Check for duplicate
-    uint256 hash = block.GetHash();
     BlockMap::iterator miSelf = mapBlockIndex.find(hash);
     CBlockIndex *pindex = NULL;
 
@@ -3706,13 +3717,20 @@ static bool AcceptBlockHeader(const CBlockHeader& block, CValidationState& state
 }
 
 // Exposed wrapper for AcceptBlockHeader
-bool ProcessNewBlockHeaders(const std::vector<CBlockHeader>& headers, CValidationState& state, const CChainParams& chainparams, const CBlockIndex** ppindex)
+bool ProcessNewBlockHeaders(const std::vector<CBlockHeader>& headers, CValidationState& state, const CChainParams& chainparams, const CBlockIndex** ppindex, const std::vector<uint256>* pvHashes)
 {
+    // Hash all headers up front and outside cs_main, spread over the header hash threads
+    std::vector<uint256> vHashes;
+    if (pvHashes == NULL || pvHashes->size() != headers.size()) {
+        GetBlockHeaderHashes(headers, vHashes);
+        pvHashes = &vHashes;
+    }
+
     {
         LOCK(cs_main);
-        for (const CBlockHeader& header : headers) {
+        for (size_t i = 0; i < headers.size(); i++) {
             CBlockIndex *pindex = NULL; // Use a temp pindex instead of ppindex to avoid a const_cast
-            if (!AcceptBlockHeader(header, state, chainparams, &pindex)) {
+            if (!AcceptBlockHeader(headers[i], (*pvHashes)[i], state, chainparams, &pindex)) {
                 return false;
             }
             if (ppindex) {
@@ -3735,7 +3753,7 @@ static bool AcceptBlock(const std::shared_ptr<const CBlock>& pblock, CValidation
     CBlockIndex *pindexDummy = NULL;
     CBlockIndex *&pindex = ppindex ? *ppindex : pindexDummy;
 
-    if (!AcceptBlockHeader(block, state, chainparams, &pindex))
+    if (!AcceptBlockHeader(block, block.GetHash(), state, chainparams, &pindex))
         return false;
 
     // Try to process all requested blocks that we don't have, but only
@@ -4160,18 +4178,6 @@ bool static LoadBlockIndexDB(const CChainParams& chainparams)
     pblocktree->ReadFlag("txindex", fTxIndex);
     LogPrintf("%s: transaction index %s\n", __func__, fTxIndex ? "enabled" : "disabled");
 
-    // Check whether we have an address index
-    pblocktree->ReadFlag("addressindex", fAddressIndex);
-    LogPrintf("%s: address index %s\n", __func__, fAddressIndex ? "enabled" : "disabled");
-
-    // Check whether we have a timestamp index
-    pblocktree->ReadFlag("timestampindex", fTimestampIndex);
-    LogPrintf("%s: timestamp index %s\n", __func__, fTimestampIndex ? "enabled" : "disabled");
-
-    // Check whether we have a spent index
-    pblocktree->ReadFlag("spentindex", fSpentIndex);
-    LogPrintf("%s: spent index %s\n", __func__, fSpentIndex ? "enabled" : "disabled");
-
     // Load pointer to end of best chain
     BlockMap::iterator it = mapBlockIndex.find(pcoinsTip->GetBestBlock());
     if (it == mapBlockIndex.end())
@@ -4315,6 +4321,7 @@ void UnloadBlockIndex()
         warningcache[b].clear();
     }
 
+    ClearKernelStakeModifierCache();
     BOOST_FOREACH(BlockMap::value_type& entry, mapBlockIndex) {
         delete entry.second;
     }
@@ -4348,58 +4355,57 @@ static bool AddGenesisBlock(const CChainParams& chainparams, const CBlock& block
 
 bool InitBlockIndex(const CChainParams& chainparams)
 {
-    LOCK(cs_main);
-
-    // Check whether we're already initialized
-    if (chainActive.Genesis() != NULL)
-        return true;
-
-    // Use the provided setting for -txindex in the new database
-    fTxIndex = GetBoolArg("-txindex", DEFAULT_TXINDEX);
-    pblocktree->WriteFlag("txindex", fTxIndex);
+    {
+        LOCK(cs_main);
 
-    // Use the provided setting for -addressindex in the new database
-    fAddressIndex = GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX);
-    pblocktree->WriteFlag("addressindex", fAddressIndex);
+        // Check whether we're already initialized
+        if (chainActive.Genesis() != NULL)
+            return true;
 
-    // Use the provided setting for -timestampindex in the new database
-    fTimestampIndex = GetBoolArg("-timestampindex", DEFAULT_TIMESTAMPINDEX);
-    pblocktree->WriteFlag("timestampindex", fTimestampIndex);
+        // Use the provided setting for -txindex in the new database
+        fTxIndex = GetBoolArg("-txindex", DEFAULT_TXINDEX);
+        pblocktree->WriteFlag("txindex", fTxIndex);
 
-    fSpentIndex = GetBoolArg("-spentindex", DEFAULT_SPENTINDEX);
-    pblocktree->WriteFlag("spentindex", fSpentIndex);
+        LogPrintf("Initializing databases...\n");
 
-    LogPrintf("Initializing databases...\n");
+        // Only add the genesis block if not reindexing (in which case we reuse the one already on disk)
+        if (fReindex)
+            return true;
 
-    // Only add the genesis block if not reindexing (in which case we reuse the one already on disk)
-    if (!fReindex) {
         try {
             CValidationState state;
-
             if (!AddGenesisBlock(chainparams, chainparams.GenesisBlock(), state))
                 return false;
-
-            if (chainparams.NetworkIDString() == CBaseChainParams::DEVNET) {
-                // We can't continue if devnet genesis block is invalid
-                std::shared_ptr<const CBlock> shared_pblock = std::make_shared<const CBlock>(chainparams.DevNetGenesisBlock());
-                bool fProcessDevnetGenesisBlock = ProcessNewBlock(chainparams, shared_pblock, true, NULL);
-                assert(fProcessDevnetGenesisBlock);
-            }
-
-            // Force a chainstate write so that when we VerifyDB in a moment, it doesn't check stale data
-            return FlushStateToDisk(state, FLUSH_STATE_ALWAYS);
         } catch (const std::runtime_error& e) {
             return error("%s: failed to initialize block database: %s", __func__, e.what());
         }
     }
 
-    return true;
+    // ProcessNewBlock and FlushStateToDisk take their own locks; the former
+    // acquires cs_activatebestchain, which must not be taken under cs_main.
+    try {
+        CValidationState state;
+
+        if (chainparams.NetworkIDString() == CBaseChainParams::DEVNET) {
+            // We can't continue if devnet genesis block is invalid
+            std::shared_ptr<const CBlock> shared_pblock = std::make_shared<const CBlock>(chainparams.DevNetGenesisBlock());
+            bool fProcessDevnetGenesisBlock = ProcessNewBlock(chainparams, shared_pblock, true, NULL);
+            assert(fProcessDevnetGenesisBlock);
+        }
+
+        // Force a chainstate write so that when we VerifyDB in a moment, it doesn't check stale data
+        return FlushStateToDisk(state, FLUSH_STATE_ALWAYS);
+    } catch (const std::runtime_error& e) {
+        return error("%s: failed to initialize block database: %s", __func__, e.what());
+    }
 }
 
 bool LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, CDiskBlockPos *dbp)
 {
     // Map of disk positions for blocks with unknown parent (only used for reindex)
     static std::multimap<uint256, CDiskBlockPos> mapBlocksUnknownParent;
+    // Number of blocks read ahead so that their headers can be hashed in parallel
+    static const size_t nHashBatchSize = 16;
     int64_t nStart = GetTimeMillis();
 
     int nLoaded = 0;
@@ -4408,107 +4414,131 @@ bool LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, CDiskB
         // This takes over fileIn and calls fclose() on it in the CBufferedFile destructor
         CBufferedFile blkdat(fileIn, 2*nMaxBlockSize, nMaxBlockSize+8, SER_DISK, CLIENT_VERSION);
         uint64_t nRewind = blkdat.GetPos();
-        while (!blkdat.eof()) {
-            boost::this_thread::interruption_point();
-
-            blkdat.SetPos(nRewind);
-            nRewind++; // start one byte further next time, in case of failure
-            blkdat.SetLimit(); // remove former limit
-            unsigned int nSize = 0;
-            try {
-                // locate a header
-                unsigned char buf[CMessageHeader::MESSAGE_START_SIZE];
-                blkdat.FindByte(chainparams.MessageStart()[0]);
-                nRewind = blkdat.GetPos()+1;
-                blkdat >> FLATDATA(buf);
-                if (memcmp(buf, chainparams.MessageStart(), CMessageHeader::MESSAGE_START_SIZE))
-                    continue;
-                // read size
-                blkdat >> nSize;
-                if (nSize < 80 || nSize > nMaxBlockSize)
-                    continue;
-            } catch (const std::exception&) {
-                // no valid block header found; don't complain
-                break;
-            }
-            try {
-                // read block
-                uint64_t nBlockPos = blkdat.GetPos();
-                if (dbp)
-                    dbp->nPos = nBlockPos;
-                blkdat.SetLimit(nBlockPos + nSize);
-                blkdat.SetPos(nBlockPos);
-                std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
-                CBlock& block = *pblock;
-                blkdat >> block;
-                nRewind = blkdat.GetPos();
-
-                uint256 hash = block.GetHash();
-                {
-                    LOCK(cs_main);
-                    // detect out of order blocks, and store them for later
-                    if (hash != chainparams.GetConsensus().hashGenesisBlock && !LookupBlockIndex(block.hashPrevBlock)) {
-                        LogPrintf("%s: Out of order block %s, parent %s not known\n", __func__, hash.ToString(),
-                                 block.hashPrevBlock.ToString());
-                        if (dbp)
-                            mapBlocksUnknownParent.insert(std::make_pair(block.hashPrevBlock, *dbp));
+        bool fEndOfBlocks = false;
+        bool fAbort = false;
+        while (!fEndOfBlocks && !fAbort && !blkdat.eof()) {
+            std::vector<std::shared_ptr<CBlock> > vBlocks;
+            std::vector<unsigned int> vBlockPos;
+            while (vBlocks.size() < nHashBatchSize && !blkdat.eof()) {
+                boost::this_thread::interruption_point();
+
+                blkdat.SetPos(nRewind);
+                nRewind++; // start one byte further next time, in case of failure
+                blkdat.SetLimit(); // remove former limit
+                unsigned int nSize = 0;
+                try {
+                    // locate a header
+                    unsigned char buf[CMessageHeader::MESSAGE_START_SIZE];
+                    blkdat.FindByte(chainparams.MessageStart()[0]);
+                    nRewind = blkdat.GetPos()+1;
+                    blkdat >> FLATDATA(buf);
+                    if (memcmp(buf, chainparams.MessageStart(), CMessageHeader::MESSAGE_START_SIZE))
                         continue;
-                    }
+                    // read size
+                    blkdat >> nSize;
+                    if (nSize < 80 || nSize > nMaxBlockSize)
+                        continue;
+                } catch (const std::exception&) {
+                    // no valid block header found; don't complain
+                    fEndOfBlocks = true;
+                    break;
+                }
+                try {
+                    // read block
+                    uint64_t nBlockPos = blkdat.GetPos();
+                    blkdat.SetLimit(nBlockPos + nSize);
+                    blkdat.SetPos(nBlockPos);
+                    std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
+                    blkdat >> *pblock;
+                    nRewind = blkdat.GetPos();
+                    vBlocks.push_back(pblock);
+                    vBlockPos.push_back(nBlockPos);
+                } catch (const std::exception& e) {
+                    LogPrintf("%s: Deserialize or I/O error - %s\n", __func__, e.what());
+                }
+            }
 
-                    // process in case the block isn't known yet
-                    CBlockIndex* pindex = LookupBlockIndex(hash);
-                    if (!pindex || (pindex->nStatus & BLOCK_HAVE_DATA) == 0) {
-                        CValidationState state;
-                        if (AcceptBlock(pblock, state, chainparams, nullptr, true, dbp, nullptr)) {
-                            nLoaded++;
+            std::vector<const CBlockHeader*> vpheaders;
+            for (const std::shared_ptr<CBlock>& pblock : vBlocks)
+                vpheaders.push_back(pblock.get());
+            std::vector<uint256> vHashes;
+            GetBlockHeaderHashes(vpheaders, vHashes);
+
+            for (size_t i = 0; i < vBlocks.size() && !fAbort; i++) {
+                try {
+                    std::shared_ptr<CBlock> pblock = vBlocks[i];
+                    CBlock& block = *pblock;
+                    const uint256& hash = vHashes[i];
+                    if (dbp)
+                        dbp->nPos = vBlockPos[i];
+                    {
+                        LOCK(cs_main);
+                        // detect out of order blocks, and store them for later
+                        if (hash != chainparams.GetConsensus().hashGenesisBlock && !LookupBlockIndex(block.hashPrevBlock)) {
+                            LogPrintf("%s: Out of order block %s, parent %s not known\n", __func__, hash.ToString(),
+                                     block.hashPrevBlock.ToString());
+                            if (dbp)
+                                mapBlocksUnknownParent.insert(std::make_pair(block.hashPrevBlock, *dbp));
+                            continue;
                         }
-                        if (state.IsError()) {
-                            break;
+
+                        // process in case the block isn't known yet
+                        CBlockIndex* pindex = LookupBlockIndex(hash);
+                        if (!pindex || (pindex->nStatus & BLOCK_HAVE_DATA) == 0) {
+                            CValidationState state;
+                            if (AcceptBlock(pblock, state, chainparams, nullptr, true, dbp, nullptr)) {
+                                nLoaded++;
+                            }
+                            if (state.IsError()) {
+                                fAbort = true;
+                                break;
+                            }
+                        } else if (hash != chainparams.GetConsensus().hashGenesisBlock && pindex->nHeight % 1000 == 0) {
+                            LogPrintf("Block Import: already had block %s at height %d\n", hash.ToString(), pindex->nHeight);
                         }
-                    } else if (hash != chainparams.GetConsensus().hashGenesisBlock && pindex->nHeight % 1000 == 0) {
-                        LogPrintf("Block Import: already had block %s at height %d\n", hash.ToString(), pindex->nHeight);
-                    }
 
-                }
+                    }
 
-                {
-                    CValidationState state;
-                    if (!ActivateBestChain(state, chainparams)) {
-                        break;
+                    {
+                        CValidationState state;
+                        if (!ActivateBestChain(state, chainparams)) {
+                            fAbort = true;
+                            break;
+                        }
                     }
-                }
 
-                NotifyHeaderTip();
-
-                // Recursively process earlier encountered successors of this block
-                std::deque<uint256> queue;
-                queue.push_back(hash);
-                while (!queue.empty()) {
-                    uint256 head = queue.front();
-                    queue.pop_front();
-                    std::pair<std::multimap<uint256, CDiskBlockPos>::iterator, std::multimap<uint256, CDiskBlockPos>::iterator> range = mapBlocksUnknownParent.equal_range(head);
-                    while (range.first != range.second) {
-                        std::multimap<uint256, CDiskBlockPos>::iterator it = range.first;
-                        std::shared_ptr<CBlock> pblockrecursive = std::make_shared<CBlock>();
-                        if (ReadBlockFromDisk(*pblockrecursive, it->second, chainparams.GetConsensus()))
-                        {
-                            LogPrintf("%s: Processing out of order child %s of %s\n", __func__, pblockrecursive->GetHash().ToString(),
-                                     head.ToString());
-                            LOCK(cs_main);
-                            CValidationState dummy;
-                            if (AcceptBlock(pblockrecursive, dummy, chainparams, nullptr, true, &it->second, nullptr))
+                    NotifyHeaderTip();
+
+                    // Recursively process earlier encountered successors of this block
+                    std::deque<uint256> queue;
+                    queue.push_back(hash);
+                    while (!queue.empty()) {
+                        uint256 head = queue.front();
+                        queue.pop_front();
+                        std::pair<std::multimap<uint256, CDiskBlockPos>::iterator, std::multimap<uint256, CDiskBlockPos>::iterator> range = mapBlocksUnknownParent.equal_range(head);
+                        while (range.first != range.second) {
+                            std::multimap<uint256, CDiskBlockPos>::iterator it = range.first;
+                            std::shared_ptr<CBlock> pblockrecursive = std::make_shared<CBlock>();
+                            if (ReadBlockFromDisk(*pblockrecursive, it->second, chainparams.GetConsensus()))
                             {
-                                nLoaded++;
-                                queue.push_back(pblockrecursive->GetHash());
+                                LogPrintf("%s: Processing out of order child %s of %s\n", __func__, pblockrecursive->GetHash().ToString(),
+                                         head.ToString());
+                                LOCK(cs_main);
+                                CValidationState dummy;
+                                if (AcceptBlock(pblockrecursive, dummy, chainparams, nullptr, true, &it->second, nullptr))
+                                {
+                                    nLoaded++;
+                                    queue.push_back(pblockrecursive->GetHash());
+                                }
                             }
+                            range.first++;
+                            mapBlocksUnknownParent.erase(it);
+                            NotifyHeaderTip();
                         }
-                        range.first++;
-                        mapBlocksUnknownParent.erase(it);
-                        NotifyHeaderTip();
                     }
+                } catch (const std::exception& e) {
+                    LogPrintf("%s: Deserialize or I/O error - %s\n", __func__, e.what());
                 }
-            } catch (const std::exception& e) {
-                LogPrintf("%s: Deserialize or I/O error - %s\n", __func__, e.what());
             }
         }
     } catch (const std::runtime_error& e) {
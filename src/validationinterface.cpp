@@ -5,30 +5,97 @@
 
 #include "validationinterface.h"
 
+#include "primitives/block.h"
+#include "scheduler.h"
+#include "sync.h"
+
+#include <map>
+#include <vector>
+
 static CMainSignals g_signals;
 
+/** Runs the notifications of background listeners in order, if a scheduler is registered */
+static std::unique_ptr<SingleThreadedSchedulerClient> pBackgroundQueue;
+
+/** Connections of the listeners registered with fBackground */
+static CCriticalSection cs_mapBackgroundConnections;
+static std::map<CValidationInterface*, std::vector<boost::signals2::connection> > mapBackgroundConnections;
+
+static void AddToBackgroundQueue(const CScheduler::Function& func)
+{
+    if (pBackgroundQueue)
+        pBackgroundQueue->AddToProcessQueue(func);
+    else
+        func();
+}
+
 CMainSignals& GetMainSignals()
 {
     return g_signals;
 }
 
-void RegisterValidationInterface(CValidationInterface* pwalletIn) {
+void RegisterBackgroundSignalScheduler(CScheduler& scheduler) {
+    assert(!pBackgroundQueue);
+    pBackgroundQueue.reset(new SingleThreadedSchedulerClient(&scheduler));
+}
+
+void UnregisterBackgroundSignalScheduler() {
+    pBackgroundQueue.reset();
+}
+
+void FlushBackgroundCallbacks() {
+    if (pBackgroundQueue)
+        pBackgroundQueue->EmptyQueue();
+}
+
+void RegisterValidationInterface(CValidationInterface* pwalletIn, bool fBackground) {
     g_signals.AcceptedBlockHeader.connect(boost::bind(&CValidationInterface::AcceptedBlockHeader, pwalletIn, _1));
     g_signals.NotifyHeaderTip.connect(boost::bind(&CValidationInterface::NotifyHeaderTip, pwalletIn, _1, _2));
-    g_signals.UpdatedBlockTip.connect(boost::bind(&CValidationInterface::UpdatedBlockTip, pwalletIn, _1, _2, _3));
-    g_signals.SyncTransaction.connect(boost::bind(&CValidationInterface::SyncTransaction, pwalletIn, _1, _2, _3));
-    g_signals.NotifyTransactionLock.connect(boost::bind(&CValidationInterface::NotifyTransactionLock, pwalletIn, _1));
+    if (fBackground) {
+        // The arguments are copied where needed, the caller's may not outlive the call
+        boost::function<void (const CBlockIndex *, const CBlockIndex *, bool)> updatedBlockTip = boost::bind(&CValidationInterface::UpdatedBlockTip, pwalletIn, _1, _2, _3);
+        boost::function<void (const CTransaction &, const CBlockIndex *, int)> syncTransaction = boost::bind(&CValidationInterface::SyncTransaction, pwalletIn, _1, _2, _3);
+        boost::function<void (const CTransaction &)> notifyTransactionLock = boost::bind(&CValidationInterface::NotifyTransactionLock, pwalletIn, _1);
+
+        LOCK(cs_mapBackgroundConnections);
+        std::vector<boost::signals2::connection>& vConnections = mapBackgroundConnections[pwalletIn];
+        vConnections.push_back(g_signals.UpdatedBlockTip.connect([updatedBlockTip](const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload) {
+            AddToBackgroundQueue(boost::bind(updatedBlockTip, pindexNew, pindexFork, fInitialDownload));
+        }));
+        vConnections.push_back(g_signals.SyncTransaction.connect([syncTransaction](const CTransaction &tx, const CBlockIndex *pindex, int posInBlock) {
+            CTransactionRef ptx = MakeTransactionRef(tx);
+            AddToBackgroundQueue([syncTransaction, ptx, pindex, posInBlock] { syncTransaction(*ptx, pindex, posInBlock); });
+        }));
+        vConnections.push_back(g_signals.NotifyTransactionLock.connect([notifyTransactionLock](const CTransaction &tx) {
+            CTransactionRef ptx = MakeTransactionRef(tx);
+            AddToBackgroundQueue([notifyTransactionLock, ptx] { notifyTransactionLock(*ptx); });
+        }));
+    } else {
+        g_signals.UpdatedBlockTip.connect(boost::bind(&CValidationInterface::UpdatedBlockTip, pwalletIn, _1, _2, _3));
+        g_signals.SyncTransaction.connect(boost::bind(&CValidationInterface::SyncTransaction, pwalletIn, _1, _2, _3));
+        g_signals.NotifyTransactionLock.connect(boost::bind(&CValidationInterface::NotifyTransactionLock, pwalletIn, _1));
+    }
+    // Always synchronous: block sources are punished and forgotten while the block is processed
+    g_signals.BlockChecked.connect(boost::bind(&CValidationInterface::BlockChecked, pwalletIn, _1, _2));
     g_signals.UpdatedTransaction.connect(boost::bind(&CValidationInterface::UpdatedTransaction, pwalletIn, _1));
     g_signals.SetBestChain.connect(boost::bind(&CValidationInterface::SetBestChain, pwalletIn, _1));
     g_signals.Inventory.connect(boost::bind(&CValidationInterface::Inventory, pwalletIn, _1));
     g_signals.Broadcast.connect(boost::bind(&CValidationInterface::ResendWalletTransactions, pwalletIn, _1, _2));
-    g_signals.BlockChecked.connect(boost::bind(&CValidationInterface::BlockChecked, pwalletIn, _1, _2));
     g_signals.ScriptForMining.connect(boost::bind(&CValidationInterface::GetScriptForMining, pwalletIn, _1));
     g_signals.BlockFound.connect(boost::bind(&CValidationInterface::ResetRequestCount, pwalletIn, _1));
     g_signals.NewPoWValidBlock.connect(boost::bind(&CValidationInterface::NewPoWValidBlock, pwalletIn, _1, _2));
 }
 
 void UnregisterValidationInterface(CValidationInterface* pwalletIn) {
+    {
+        LOCK(cs_mapBackgroundConnections);
+        std::map<CValidationInterface*, std::vector<boost::signals2::connection> >::iterator it = mapBackgroundConnections.find(pwalletIn);
+        if (it != mapBackgroundConnections.end()) {
+            for (boost::signals2::connection& conn : it->second)
+                conn.disconnect();
+            mapBackgroundConnections.erase(it);
+        }
+    }
     g_signals.BlockFound.disconnect(boost::bind(&CValidationInterface::ResetRequestCount, pwalletIn, _1));
     g_signals.ScriptForMining.disconnect(boost::bind(&CValidationInterface::GetScriptForMining, pwalletIn, _1));
     g_signals.BlockChecked.disconnect(boost::bind(&CValidationInterface::BlockChecked, pwalletIn, _1, _2));
@@ -45,6 +112,10 @@ void UnregisterValidationInterface(CValidationInterface* pwalletIn) {
 }
 
 void UnregisterAllValidationInterfaces() {
+    {
+        LOCK(cs_mapBackgroundConnections);
+        mapBackgroundConnections.clear();
+    }
     g_signals.BlockFound.disconnect_all_slots();
     g_signals.ScriptForMining.disconnect_all_slots();
     g_signals.BlockChecked.disconnect_all_slots();
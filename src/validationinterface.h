@@ -15,6 +15,7 @@ class CBlockIndex;
 struct CBlockLocator;
 class CConnman;
 class CReserveScript;
+class CScheduler;
 class CTransaction;
 class CValidationInterface;
 class CValidationState;
@@ -22,12 +23,25 @@ class uint256;
 
 // These functions dispatch to one or all registered wallets
 
-/** Register a wallet to receive updates from core */
-void RegisterValidationInterface(CValidationInterface* pwalletIn);
+/**
+ * Register a wallet to receive updates from core. With fBackground, the
+ * UpdatedBlockTip, SyncTransaction and NotifyTransactionLock
+ * notifications are delivered in order on the background scheduler instead of
+ * by the thread that validated the data, which usually still holds cs_main, so
+ * they may arrive after the chain has moved on again. Such a wallet must only be
+ * deleted after unregistering it and calling FlushBackgroundCallbacks().
+ */
+void RegisterValidationInterface(CValidationInterface* pwalletIn, bool fBackground = false);
 /** Unregister a wallet from core */
 void UnregisterValidationInterface(CValidationInterface* pwalletIn);
 /** Unregister all wallets from core */
 void UnregisterAllValidationInterfaces();
+/** Deliver the notifications of background listeners on this scheduler */
+void RegisterBackgroundSignalScheduler(CScheduler& scheduler);
+/** Stop delivering notifications in the background, call FlushBackgroundCallbacks() first */
+void UnregisterBackgroundSignalScheduler();
+/** Deliver all queued background notifications on the calling thread */
+void FlushBackgroundCallbacks();
 
 class CValidationInterface {
 protected:
@@ -44,7 +58,7 @@ protected:
     virtual void GetScriptForMining(boost::shared_ptr<CReserveScript>&) {}
     virtual void ResetRequestCount(const uint256 &hash) {}
     virtual void NewPoWValidBlock(const CBlockIndex *pindex, const std::shared_ptr<const CBlock>& block) {}
-    friend void ::RegisterValidationInterface(CValidationInterface*);
+    friend void ::RegisterValidationInterface(CValidationInterface*, bool);
     friend void ::UnregisterValidationInterface(CValidationInterface*);
     friend void ::UnregisterAllValidationInterfaces();
 };
@@ -0,0 +1,108 @@
+// Copyright (c) 2018 The SecureTag Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "kernel.h"
+#include "validation.h"
+
+#include "test/test_securetag.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(kernel_tests, BasicTestingSetup)
+
+// Append nBlocks index entries, one per minute, on top of pindexPrev (or a new
+// chain starting with hashFirst) and make the result the active chain.
+static void ExtendChain(std::vector<CBlockIndex*>& vIndex, CBlockIndex* pindexPrev, const uint256& hashFirst,
+                        unsigned int nTimeFirst, int nBlocks, uint64_t nModifierBase)
+{
+    for (int i = 0; i < nBlocks; i++) {
+        int nHeight = pindexPrev ? pindexPrev->nHeight + 1 : 0;
+        uint256 hash = pindexPrev ? ArithToUint256(arith_uint256(nModifierBase + nHeight)) : hashFirst;
+        CBlockIndex* pindex = new CBlockIndex();
+        pindex->phashBlock = &mapBlockIndex.insert(std::make_pair(hash, pindex)).first->first;
+        pindex->pprev = pindexPrev;
+        pindex->nHeight = nHeight;
+        pindex->nTime = nTimeFirst + 60 * nHeight;
+        pindex->SetStakeModifier(nModifierBase + nHeight, true);
+        vIndex.push_back(pindex);
+        pindexPrev = pindex;
+    }
+    chainActive.SetTip(pindexPrev);
+}
+
+BOOST_AUTO_TEST_CASE(kernel_stake_modifier_cache)
+{
+    LOCK(cs_main);
+
+    CBlock blockFrom;
+    blockFrom.nVersion = 4;
+    blockFrom.nTime = 1561000000;
+    blockFrom.nBits = 0x1e0ffff0;
+    const unsigned int nTimeTx = blockFrom.nTime + 2 * 24 * 60 * 60;
+
+    CMutableTransaction txPrev;
+    txPrev.vout.resize(1);
+    txPrev.vout[0].nValue = 1000 * COIN;
+    CTransactionRef ptxPrev = MakeTransactionRef(txPrev);
+    COutPoint prevout(ptxPrev->GetHash(), 0);
+
+    std::vector<CBlockIndex*> vIndex;
+    ExtendChain(vIndex, NULL, blockFrom.GetHash(), blockFrom.nTime, 200, 0);
+
+    // Repeated lookups are served from the cache and give the same kernel
+    uint256 hash1, hash2, hash3;
+    CheckStakeKernelHash(blockFrom.nBits, blockFrom, 81, ptxPrev, prevout, nTimeTx, hash1);
+    CheckStakeKernelHash(blockFrom.nBits, blockFrom, 81, ptxPrev, prevout, nTimeTx, hash2);
+    BOOST_CHECK(hash1 == hash2);
+    BOOST_CHECK(CheckStakeKernelHash(blockFrom.nBits, vIndex[0], 81, ptxPrev->vout[0], prevout, nTimeTx, hash3) ==
+                CheckStakeKernelHash(blockFrom.nBits, blockFrom, 81, ptxPrev, prevout, nTimeTx, hash2));
+    BOOST_CHECK(hash2 == hash3);
+
+    // Reorganize onto a branch with other stake modifiers: the cached lookup
+    // must not survive, and must match an uncached one
+    ExtendChain(vIndex, vIndex[10], uint256(), blockFrom.nTime, 200, 1000);
+    CheckStakeKernelHash(blockFrom.nBits, blockFrom, 81, ptxPrev, prevout, nTimeTx, hash2);
+    BOOST_CHECK(hash2 != hash1);
+    ClearKernelStakeModifierCache();
+    CheckStakeKernelHash(blockFrom.nBits, blockFrom, 81, ptxPrev, prevout, nTimeTx, hash3);
+    BOOST_CHECK(hash2 == hash3);
+
+    chainActive.SetTip(NULL);
+    ClearKernelStakeModifierCache();
+    for (CBlockIndex* pindex : vIndex) {
+        mapBlockIndex.erase(pindex->GetBlockHash());
+        delete pindex;
+    }
+}
+
+BOOST_AUTO_TEST_CASE(kernel_hash_pinned)
+{
+    // The kernel hash is consensus, the offset must not follow the size of CBlock
+    BOOST_CHECK_EQUAL(STAKE_KERNEL_TX_PREV_OFFSET, 256U);
+
+    LOCK(cs_main);
+
+    const unsigned int nTimeFrom = 1561000000;
+    const unsigned int nTimeTx = nTimeFrom + 2 * 24 * 60 * 60;
+    std::vector<CBlockIndex*> vIndex;
+    ExtendChain(vIndex, NULL, uint256S("0x01"), nTimeFrom, 200, 0);
+
+    // The modifier of block 35 applies, the first one a selection interval
+    // after the kernel's block. The expected hash was computed independently
+    // as SHA256d(modifier, block time, 256, block time, n, tx time).
+    CTxOut txout(1000 * COIN, CScript());
+    COutPoint prevout(uint256S("0xabcdef"), 1);
+    uint256 hashProofOfStake;
+    CheckStakeKernelHash(0x1e0ffff0, vIndex[0], STAKE_KERNEL_TX_PREV_OFFSET, txout, prevout, nTimeTx, hashProofOfStake);
+    BOOST_CHECK_EQUAL(hashProofOfStake.GetHex(), "2d383930312974a85b25f1763a83395b04a40a74e60ea40b4a15e8409c1572d8");
+
+    chainActive.SetTip(NULL);
+    ClearKernelStakeModifierCache();
+    for (CBlockIndex* pindex : vIndex) {
+        mapBlockIndex.erase(pindex->GetBlockHash());
+        delete pindex;
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
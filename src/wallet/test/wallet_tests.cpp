@@ -489,4 +489,73 @@ BOOST_FIXTURE_TEST_CASE(importwallet_rescan, TestChain100Setup)
     ::pwalletMain = pwalletMainBackup;
 }
 
+static size_t CountStakeCoins(const CWallet& wallet, const uint256& hash)
+{
+    CWallet::StakeCoinsSet setCoins;
+    wallet.SelectStakeCoins(setCoins, MAX_MONEY);
+    size_t nCount = 0;
+    for (const auto& coin : setCoins) {
+        if (coin.first->GetHash() == hash)
+            nCount++;
+    }
+    return nCount;
+}
+
+// Outputs already in the wallet that pay to a key added later become
+// stakeable once the new scripts are indexed
+BOOST_FIXTURE_TEST_CASE(stake_coins_new_keys, TestChain100Setup)
+{
+    CKey keyOurs, keyLater, keyOther;
+    keyOurs.MakeNewKey(true);
+    keyLater.MakeNewKey(true);
+    keyOther.MakeNewKey(true);
+
+    // Pay one of our keys and one we add later
+    CScript scriptPubKey = GetScriptForRawPubKey(coinbaseKey.GetPubKey());
+    CMutableTransaction spend;
+    spend.nVersion = 1;
+    spend.vin.resize(1);
+    spend.vin[0].prevout = COutPoint(coinbaseTxns[0].GetHash(), 0);
+    spend.vout.resize(2);
+    spend.vout[0].nValue = 11*CENT;
+    spend.vout[0].scriptPubKey = GetScriptForDestination(keyOurs.GetPubKey().GetID());
+    spend.vout[1].nValue = 11*CENT;
+    spend.vout[1].scriptPubKey = GetScriptForDestination(keyLater.GetPubKey().GetID());
+    std::vector<unsigned char> vchSig;
+    uint256 hash = SignatureHash(scriptPubKey, spend, 0, SIGHASH_ALL);
+    BOOST_CHECK(coinbaseKey.Sign(hash, vchSig));
+    vchSig.push_back((unsigned char)SIGHASH_ALL);
+    spend.vin[0].scriptSig << vchSig;
+
+    CBlockIndex* pindexStart = chainActive.Tip();
+    CreateAndProcessBlock(std::vector<CMutableTransaction>(1, spend), scriptPubKey);
+    // Stake coins need some confirmations
+    for (int i = 0; i < 10; i++)
+        CreateAndProcessBlock({}, scriptPubKey);
+
+    LOCK(cs_main);
+    CWallet wallet;
+    LOCK(wallet.cs_wallet);
+    wallet.AddKeyPubKey(keyOurs, keyOurs.GetPubKey());
+    wallet.ScanForWalletTransactions(pindexStart);
+    BOOST_CHECK(wallet.GetWalletTx(spend.GetHash()));
+
+    // ... and old enough
+    SetMockTime(GetTime() + 2 * 60 * 60);
+    BOOST_CHECK_EQUAL(CountStakeCoins(wallet, spend.GetHash()), 1U);
+
+    // An unrelated key does not change anything
+    wallet.AddKeyPubKey(keyOther, keyOther.GetPubKey());
+    wallet.IndexNewScripts();
+    BOOST_CHECK_EQUAL(CountStakeCoins(wallet, spend.GetHash()), 1U);
+
+    // The output paying to the new key is picked up once indexed
+    wallet.AddKeyPubKey(keyLater, keyLater.GetPubKey());
+    BOOST_CHECK_EQUAL(CountStakeCoins(wallet, spend.GetHash()), 1U);
+    wallet.IndexNewScripts();
+    BOOST_CHECK_EQUAL(CountStakeCoins(wallet, spend.GetHash()), 2U);
+
+    SetMockTime(0);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -9,6 +9,7 @@
 #include "base58.h"
 #include "checkpoints.h"
 #include "chain.h"
+#include "checkqueue.h"
 #include "wallet/coincontrol.h"
 #include "consensus/consensus.h"
 #include "consensus/validation.h"
@@ -208,22 +209,21 @@ CAmount GetStakeReward(CAmount blockReward, unsigned int percentage)
 {
     return (blockReward / 100) * percentage;
 }
-bool CWallet::CreateCoinStakeKernel(CScript &kernelScript, const CScript &stakeScript,
-                                    unsigned int nBits, const CBlock &blockFrom,
-                                    unsigned int nTxPrevOffset, const CTransactionRef &txPrev,
-                                    const COutPoint &prevout, unsigned int &nTimeTx, bool fPrintProofOfStake) const
+bool CWallet::CreateCoinStakeKernel(CScript &kernelScript, unsigned int nBits,
+                                    const CStakeKernelInput& input, unsigned int nTxPrevOffset,
+                                    unsigned int &nTimeTx, bool fPrintProofOfStake) const
 {
     unsigned int nTryTime = 0;
     uint256 hashProofOfStake;
 
-    auto nStakeMinAge = blockFrom.GetBlockTime() > Params().GetConsensus().nStakeMinAgeSwitchTime ? Params().GetConsensus().nStakeMinAge_2 : Params().GetConsensus().nStakeMinAge;
+    auto nStakeMinAge = input.pindexFrom->GetBlockTime() > Params().GetConsensus().nStakeMinAgeSwitchTime ? Params().GetConsensus().nStakeMinAge_2 : Params().GetConsensus().nStakeMinAge;
 
-    if (blockFrom.GetBlockTime() + nStakeMinAge + nHashDrift > nTimeTx) // Min age requirement
+    if (input.pindexFrom->GetBlockTime() + nStakeMinAge + nHashDrift > nTimeTx) // Min age requirement
         return false;
     for(unsigned int i = 0; i < nHashDrift; ++i)
     {
         nTryTime = nTimeTx + nHashDrift - i;
-        if (CheckStakeKernelHash(nBits, blockFrom, nTxPrevOffset, txPrev, prevout, nTryTime, hashProofOfStake))
+        if (CheckStakeKernelHash(nBits, input.pindexFrom, nTxPrevOffset, input.txout, input.prevout, nTryTime, hashProofOfStake))
         {
             //Double check that this will pass time requirements
             if (nTryTime <= chainActive.Tip()->GetMedianTimePast()) {
@@ -234,13 +234,82 @@ bool CWallet::CreateCoinStakeKernel(CScript &kernelScript, const CScript &stakeS
             if (fDebug && GetBoolArg("-printcoinstake", false))
                 LogPrintf("CreateCoinStakeKernel : kernel found\n");
             kernelScript.clear();
-            kernelScript = stakeScript;
+            kernelScript = input.txout.scriptPubKey;
             nTimeTx = nTryTime;
             return true;
         }
     }
     return false;
 }
+
+/** Shared state of one pass of the stake kernel search */
+struct CStakeKernelSearch
+{
+    std::atomic<bool> fFound;
+    std::mutex cs;
+    std::atomic<size_t> nIndex;
+    unsigned int nTimeTx;
+    CScript kernelScript;
+
+    CStakeKernelSearch() : fFound(false), nIndex(0), nTimeTx(0) {}
+};
+
+/**
+ * Closure representing the kernel search for one stakeable coin. Once a coin
+ * found a kernel, the checks of the coins after it in the stake set return
+ * right away, so the first coin in stake set order wins like a serial search.
+ */
+class CStakeKernelCheck
+{
+private:
+    const CWallet* pwallet;
+    const CStakeKernelInput* pinput;
+    unsigned int nBits;
+    unsigned int nTimeTx;
+    size_t nIndex;
+    CStakeKernelSearch* psearch;
+
+public:
+    CStakeKernelCheck(): pwallet(NULL), pinput(NULL), nBits(0), nTimeTx(0), nIndex(0), psearch(NULL) {}
+    CStakeKernelCheck(const CWallet* pwalletIn, const CStakeKernelInput* pinputIn, unsigned int nBitsIn, unsigned int nTimeTxIn, size_t nIndexIn, CStakeKernelSearch* psearchIn) :
+        pwallet(pwalletIn), pinput(pinputIn), nBits(nBitsIn), nTimeTx(nTimeTxIn), nIndex(nIndexIn), psearch(psearchIn) {}
+
+    bool operator()() {
+        if (psearch->fFound && psearch->nIndex < nIndex)
+            return true;
+        CScript kernelScript;
+        unsigned int nTryTime = nTimeTx;
+        if (pwallet->CreateCoinStakeKernel(kernelScript, nBits, *pinput, STAKE_KERNEL_TX_PREV_OFFSET, nTryTime, false)) {
+            std::lock_guard<std::mutex> lock(psearch->cs);
+            // Several coins may find a kernel, prefer the first one like a serial search
+            if (!psearch->fFound || nIndex < psearch->nIndex) {
+                psearch->nIndex = nIndex;
+                psearch->nTimeTx = nTryTime;
+                psearch->kernelScript = kernelScript;
+            }
+            psearch->fFound = true;
+        }
+        return true;
+    }
+
+    void swap(CStakeKernelCheck& check) {
+        std::swap(pwallet, check.pwallet);
+        std::swap(pinput, check.pinput);
+        std::swap(nBits, check.nBits);
+        std::swap(nTimeTx, check.nTimeTx);
+        std::swap(nIndex, check.nIndex);
+        std::swap(psearch, check.psearch);
+    }
+};
+
+static CCheckQueue<CStakeKernelCheck> stakekernelqueue(64);
+static CCriticalSection cs_stakekernelqueue;
+
+void ThreadStakeKernelCheck() {
+    RenameThread("securetag-stakekernel");
+    stakekernelqueue.Thread();
+}
+
 void CWallet::FillCoinStakePayments(CMutableTransaction &transaction,
                                     const CScript &scriptPubKeyOut,
                                     const COutPoint &stakePrevout,
@@ -341,9 +410,11 @@ bool CWallet::AddHDPubKey(const CExtPubKey &extPubKey, bool fInternal)
     // check if we need to remove from watch-only
     CScript script;
     script = GetScriptForDestination(extPubKey.pubkey.GetID());
+    setUnindexedScripts.insert(script);
     if (HaveWatchOnly(script))
         RemoveWatchOnly(script);
     script = GetScriptForRawPubKey(extPubKey.pubkey);
+    setUnindexedScripts.insert(script);
     if (HaveWatchOnly(script))
         RemoveWatchOnly(script);
 
@@ -362,9 +433,11 @@ bool CWallet::AddKeyPubKey(const CKey& secret, const CPubKey &pubkey)
     // check if we need to remove from watch-only
     CScript script;
     script = GetScriptForDestination(pubkey.GetID());
+    setUnindexedScripts.insert(script);
     if (HaveWatchOnly(script))
         RemoveWatchOnly(script);
     script = GetScriptForRawPubKey(pubkey);
+    setUnindexedScripts.insert(script);
     if (HaveWatchOnly(script))
         RemoveWatchOnly(script);
 
@@ -428,6 +501,10 @@ bool CWallet::AddCScript(const CScript& redeemScript)
 {
     if (!CCryptoKeyStore::AddCScript(redeemScript))
         return false;
+    {
+        LOCK(cs_wallet);
+        setUnindexedScripts.insert(GetScriptForDestination(CScriptID(redeemScript)));
+    }
     if (!fFileBacked)
         return true;
     return CWalletDB(strWalletFile).WriteCScript(Hash160(redeemScript), redeemScript);
@@ -453,6 +530,10 @@ bool CWallet::AddWatchOnly(const CScript& dest)
 {
     if (!CCryptoKeyStore::AddWatchOnly(dest))
         return false;
+    {
+        LOCK(cs_wallet);
+        setUnindexedScripts.insert(dest);
+    }
     const CKeyMetadata& meta = mapKeyMetadata[CScriptID(dest)];
     UpdateTimeFirstKey(meta.nCreateTime);
     NotifyWatchonlyChanged(true);
@@ -735,6 +816,13 @@ bool CWallet::Verify()
     return true;
 }
 
+/** Time at which the outputs of a wallet transaction reach the stake min age */
+static int64_t GetStakeableTime(const CWalletTx& wtx)
+{
+    auto nStakeMinAge = wtx.GetTxTime() > Params().GetConsensus().nStakeMinAgeSwitchTime ? Params().GetConsensus().nStakeMinAge_2 : Params().GetConsensus().nStakeMinAge;
+    return wtx.GetTxTime() + nStakeMinAge;
+}
+
 void CWallet::SyncMetaData(std::pair<TxSpends::iterator, TxSpends::iterator> range)
 {
     // We want all the wallet transactions in range to have the same metadata as
@@ -760,6 +848,7 @@ void CWallet::SyncMetaData(std::pair<TxSpends::iterator, TxSpends::iterator> ran
         CWalletTx* copyTo = &mapWallet[hash];
         if (copyFrom == copyTo) continue;
         if (!copyFrom->IsEquivalentTo(*copyTo)) continue;
+        int64_t nStakeableTimeOld = GetStakeableTime(*copyTo);
         copyTo->mapValue = copyFrom->mapValue;
         copyTo->vOrderForm = copyFrom->vOrderForm;
         // fTimeReceivedIsTxTime not copied on purpose
@@ -769,6 +858,7 @@ void CWallet::SyncMetaData(std::pair<TxSpends::iterator, TxSpends::iterator> ran
         copyTo->strFromAccount = copyFrom->strFromAccount;
         // nOrderPos not copied on purpose
         // cached members not copied on purpose
+        UpdateStakeableCoins(*copyTo, nStakeableTimeOld);
     }
 }
 
@@ -795,10 +885,88 @@ bool CWallet::IsSpent(const uint256& hash, unsigned int n) const
     return false;
 }
 
+void CWallet::AddWalletUTXO(const COutPoint& outpoint)
+{
+    AssertLockHeld(cs_wallet);
+    setWalletUTXO.insert(outpoint);
+
+    const CWalletTx& wtx = mapWallet[outpoint.hash];
+    const CTxOut& txout = wtx.tx->vout[outpoint.n];
+    if (txout.nValue > 0 && !txout.scriptPubKey.IsPayToScriptHash())
+        setStakeableCoins.insert(std::make_pair(GetStakeableTime(wtx), outpoint));
+}
+
+void CWallet::UpdateStakeableCoins(const CWalletTx& wtx, int64_t nStakeableTimeOld)
+{
+    AssertLockHeld(cs_wallet);
+    int64_t nStakeableTime = GetStakeableTime(wtx);
+    if (nStakeableTime == nStakeableTimeOld)
+        return;
+    const uint256& hash = wtx.GetHash();
+    for (unsigned int i = 0; i < wtx.tx->vout.size(); i++) {
+        if (setStakeableCoins.erase(std::make_pair(nStakeableTimeOld, COutPoint(hash, i))))
+            setStakeableCoins.insert(std::make_pair(nStakeableTime, COutPoint(hash, i)));
+    }
+}
+
+void CWallet::IndexWalletTx(const CWalletTx& wtx)
+{
+    AssertLockHeld(cs_wallet);
+    const uint256& hash = wtx.GetHash();
+    for (unsigned int i = 0; i < wtx.tx->vout.size(); ++i) {
+        const CTxOut& txout = wtx.tx->vout[i];
+        if (IsMine(txout) == ISMINE_NO) {
+            mapForeignOutputs.insert(std::make_pair(txout.scriptPubKey, COutPoint(hash, i)));
+        } else if (!IsSpent(hash, i)) {
+            AddWalletUTXO(COutPoint(hash, i));
+        }
+    }
+}
+
+void CWallet::RebuildWalletUTXO()
+{
+    AssertLockHeld(cs_wallet);
+    setWalletUTXO.clear();
+    setStakeableCoins.clear();
+    mapForeignOutputs.clear();
+    for (const auto& pair : mapWallet) {
+        IndexWalletTx(pair.second);
+    }
+    setUnindexedScripts.clear();
+}
+
+void CWallet::IndexNewScripts()
+{
+    AssertLockHeld(cs_wallet);
+
+    // Only outputs that were not ours can have become ours, so look the new
+    // scripts up among them instead of going through mapWallet after every
+    // keypool top-up
+    for (const CScript& script : setUnindexedScripts) {
+        auto range = mapForeignOutputs.equal_range(script);
+        for (auto it = range.first; it != range.second; ) {
+            const COutPoint outpoint = it->second;
+            std::map<uint256, CWalletTx>::const_iterator mit = mapWallet.find(outpoint.hash);
+            if (mit != mapWallet.end() && IsMine(mit->second.tx->vout[outpoint.n]) == ISMINE_NO) {
+                ++it;
+                continue;
+            }
+            it = mapForeignOutputs.erase(it);
+            if (mit != mapWallet.end() && !IsSpent(outpoint.hash, outpoint.n))
+                AddWalletUTXO(outpoint);
+        }
+    }
+    setUnindexedScripts.clear();
+}
+
 void CWallet::AddToSpends(const COutPoint& outpoint, const uint256& wtxid)
 {
     mapTxSpends.insert(std::make_pair(outpoint, wtxid));
-    setWalletUTXO.erase(outpoint);
+    if (setWalletUTXO.erase(outpoint)) {
+        std::map<uint256, CWalletTx>::const_iterator mit = mapWallet.find(outpoint.hash);
+        if (mit != mapWallet.end())
+            setStakeableCoins.erase(std::make_pair(GetStakeableTime(mit->second), outpoint));
+    }
 
     std::pair<TxSpends::iterator, TxSpends::iterator> range;
     range = mapTxSpends.equal_range(outpoint);
@@ -1185,11 +1353,7 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFlushOnClose)
                          wtxIn.hashBlock.ToString());
         }
         AddToSpends(hash);
-        for(unsigned int i = 0; i < wtx.tx->vout.size(); ++i) {
-            if (IsMine(wtx.tx->vout[i]) && !IsSpent(hash, i)) {
-                setWalletUTXO.insert(COutPoint(hash, i));
-            }
-        }
+        IndexWalletTx(wtx);
     }
 
     bool fUpdated = false;
@@ -2956,39 +3120,50 @@ bool CWallet::MintableCoins()
 }
 bool CWallet::SelectStakeCoins(StakeCoinsSet &setCoins, CAmount nTargetAmount, const CScript &scriptFilterPubKey) const
 {
-    std::vector<COutput> vCoins;
-    AvailableCoins(vCoins, scriptFilterPubKey.empty());
+    // Only look at the wallet's unspent outputs that are old enough, instead
+    // of going through every wallet transaction with AvailableCoins()
+    LOCK2(cs_main, cs_wallet);
+    bool fOnlyConfirmed = scriptFilterPubKey.empty();
     CAmount nAmountSelected = 0;
     std::set<CScript> rejectCache;
-    for (const COutput& out : vCoins) {
-        //make sure not to outrun target amount
-        CScript scriptPubKeyKernel;
-        scriptPubKeyKernel = out.tx->tx->vout[out.i].scriptPubKey;
-        if(scriptPubKeyKernel.IsPayToScriptHash())
+    auto itEnd = setStakeableCoins.lower_bound(std::make_pair(GetTime() + 1, COutPoint(uint256(), 0)));
+    for (auto it = setStakeableCoins.begin(); it != itEnd; ++it) {
+        const COutPoint& outpoint = it->second;
+        std::map<uint256, CWalletTx>::const_iterator mit = mapWallet.find(outpoint.hash);
+        if (mit == mapWallet.end())
+            continue;
+        const CWalletTx* pcoin = &mit->second;
+
+        // Same checks as AvailableCoins()
+        if (!CheckFinalTx(*pcoin))
+            continue;
+        if (fOnlyConfirmed && !pcoin->IsTrusted())
+            continue;
+        if (pcoin->IsCoinBase() && pcoin->GetBlocksToMaturity() > 0)
             continue;
-        //     LogPrintf("scriptPubKeyKernel is good\n");
+        int nDepth = pcoin->GetDepthInMainChain(false);
+        if (nDepth == 0 && !pcoin->InMempool())
+            continue;
+        if (IsSpent(outpoint.hash, outpoint.n) || IsMine(pcoin->tx->vout[outpoint.n]) == ISMINE_NO || IsLockedCoin(outpoint.hash, outpoint.n))
+            continue;
+
+        //make sure not to outrun target amount
         //for now we will comment this out
-        //        if (nAmountSelected + out.tx->vout[out.i].nValue > nTargetAmount)
+        //        if (nAmountSelected + pcoin->tx->vout[outpoint.n].nValue > nTargetAmount)
         //            continue;
-        //        LogPrintf("amount is good\n");
         //check for min age
-        auto nStakeMinAge = out.tx->GetTxTime() > Params().GetConsensus().nStakeMinAgeSwitchTime ? Params().GetConsensus().nStakeMinAge_2 : Params().GetConsensus().nStakeMinAge;
-        if (GetTime() - out.tx->GetTxTime() < nStakeMinAge)
+        if (GetTime() < GetStakeableTime(*pcoin))
             continue;
-        //  LogPrintf("min age is good\n");
         //check that it is matured
-        if (out.nDepth < (out.tx->tx->IsCoinStake() ? COINBASE_MATURITY : 10))
+        if (nDepth < (pcoin->tx->IsCoinStake() ? COINBASE_MATURITY : 10))
             continue;
-        //  LogPrintf("maturity is good\n");
-        auto scriptPubKeyCoin = out.tx->tx->vout[out.i].scriptPubKey;
+        auto scriptPubKeyCoin = pcoin->tx->vout[outpoint.n].scriptPubKey;
         if(!scriptFilterPubKey.empty() && scriptPubKeyCoin != scriptFilterPubKey)
             continue;
-        //   LogPrintf("filtering is good\n");
         if(rejectCache.count(scriptPubKeyCoin))
             continue;
-        //    LogPrintf("reject is good\n");
-        nAmountSelected += out.tx->tx->vout[out.i].nValue; //maybe change here for tpos
-        setCoins.insert(std::make_pair(out.tx, out.i));
+        nAmountSelected += pcoin->tx->vout[outpoint.n].nValue; //maybe change here for tpos
+        setCoins.insert(std::make_pair(pcoin, outpoint.n));
     }
     return true;
 }
@@ -4130,50 +4305,71 @@ bool CWallet::CreateCoinStake(unsigned int nBits,
     //        return false;
     //  presstab HyperStake - Initialize as static and don't update the set on every run of CreateCoinStake() in order to lighten resource use
     static StakeCoinsSet setStakeCoins;
+    static std::vector<CStakeKernelInput> vStakeInputs;
     static int nLastStakeSetUpdate = 0;
-    if (GetTime() - nLastStakeSetUpdate > nStakeSetUpdateTime) {
+    // Tip the kernel inputs were looked up at; a reorg that disconnects it may
+    // also have disconnected the blocks of the inputs
+    static const CBlockIndex* pindexStakeSetTip = NULL;
+    if (GetTime() - nLastStakeSetUpdate > nStakeSetUpdateTime ||
+        (pindexStakeSetTip != NULL && !chainActive.Contains(pindexStakeSetTip))) {
+        {
+            // Keys or scripts were added since the unspent outputs were indexed,
+            // outputs already in the wallet may have become ours
+            LOCK(cs_wallet);
+            IndexNewScripts();
+        }
         setStakeCoins.clear();
+        vStakeInputs.clear();
         CScript scriptPubKey;
         if (!SelectStakeCoins(setStakeCoins, nBalance /*- nReserveBalance*/, scriptPubKey)) {
             return error("Failed to select coins for staking");
         }
         LogPrintf("Selected %d coins for staking\n", setStakeCoins.size());
         nLastStakeSetUpdate = GetTime();
+        pindexStakeSetTip = chainActive.Tip();
+        // Look up the kernel inputs of every coin once per stake set refresh
+        vStakeInputs.reserve(setStakeCoins.size());
+        for(const std::pair<const CWalletTx*, unsigned int> &pcoin : setStakeCoins)
+        {
+            BlockMap::iterator it = mapBlockIndex.find(pcoin.first->hashBlock);
+            if (it == mapBlockIndex.end() || !chainActive.Contains(it->second)) {
+                LogPrintf("failed to find block index ");
+                continue;
+            }
+            CStakeKernelInput input;
+            input.pindexFrom = it->second;
+            input.prevout = COutPoint(pcoin.first->GetHash(), pcoin.second);
+            input.txout = pcoin.first->tx->vout[pcoin.second];
+            vStakeInputs.push_back(input);
+        }
     }
     if (setStakeCoins.empty())
         return error("CreateCoinStake() : No Coins to stake");
-    //prevent staking a time that won't be accepted
+    //prevent staking a time that won't be accepted, but don't wait for it here,
+    //while cs_main is held; the stake minter retries shortly
     if (GetAdjustedTime() <= chainActive.Tip()->nTime)
-        MilliSleep(10000);
+        return false;
     bool fKernelFound = false;
     CAmount nCredit = 0;
 
-    for(const std::pair<const CWalletTx*, unsigned int> &pcoin : setStakeCoins)
+    // Search all coins for a kernel at once, spread over the stake kernel threads
+    CStakeKernelSearch search;
+    nTxNewTime = GetAdjustedTime();
     {
-        //make sure that enough time has elapsed between
-        CBlockIndex* pindex = NULL;
-        BlockMap::iterator it = mapBlockIndex.find(pcoin.first->hashBlock);
-        if (it != mapBlockIndex.end())
-            pindex = it->second;
-        else {
-            LogPrintf("failed to find block index ");
-            continue;
-        }
-        // Read block header
-        CBlockHeader block = pindex->GetBlockHeader();
-        COutPoint prevoutStake = COutPoint(pcoin.first->GetHash(), pcoin.second);
-        nTxNewTime = GetAdjustedTime();
-        //iterates each utxo inside of CheckStakeKernelHash()
-        CScript kernelScript;
-        auto stakeScript = pcoin.first->tx->vout[pcoin.second].scriptPubKey;
-        fKernelFound = CreateCoinStakeKernel(kernelScript, stakeScript, nBits,
-                                             block, sizeof(CBlock), pcoin.first->tx,
-                                             prevoutStake, nTxNewTime, false);
-        if(fKernelFound)
-        {
-            FillCoinStakePayments(txNew, kernelScript, prevoutStake, blockReward);
-            break;
-        }
+        LOCK(cs_stakekernelqueue);
+        CCheckQueueControl<CStakeKernelCheck> control(&stakekernelqueue);
+        std::vector<CStakeKernelCheck> vChecks;
+        vChecks.reserve(vStakeInputs.size());
+        for (size_t i = 0; i < vStakeInputs.size(); i++)
+            vChecks.push_back(CStakeKernelCheck(this, &vStakeInputs[i], nBits, nTxNewTime, i, &search));
+        control.Add(vChecks);
+        control.Wait();
+    }
+    if (search.fFound)
+    {
+        nTxNewTime = search.nTimeTx;
+        FillCoinStakePayments(txNew, search.kernelScript, vStakeInputs[search.nIndex].prevout, blockReward);
+        fKernelFound = true;
     }
     if(!fKernelFound)
     {
@@ -4270,13 +4466,7 @@ DBErrors CWallet::LoadWallet(bool& fFirstRunRet)
 
     {
         LOCK2(cs_main, cs_wallet);
-        for (auto& pair : mapWallet) {
-            for(unsigned int i = 0; i < pair.second.tx->vout.size(); ++i) {
-                if (IsMine(pair.second.tx->vout[i]) && !IsSpent(pair.first, i)) {
-                    setWalletUTXO.insert(COutPoint(pair.first, i));
-                }
-            }
-        }
+        RebuildWalletUTXO();
     }
 
     if (nLoadWalletRet != DB_LOAD_OK)
@@ -5238,6 +5428,9 @@ CWallet* CWallet::CreateWalletFromFile(const std::string walletFile)
 
     LogPrintf(" wallet      %15dms\n", GetTimeMillis() - nStart);
 
+    // Not in the background: RPCs expect a sent or mined transaction in the wallet
+    // as soon as they return, and staking reads the wallet's coins together with
+    // the tip they were updated for
     RegisterValidationInterface(walletInstance);
 
     CBlockIndex *pindexRescan = chainActive.Tip();
@@ -5290,6 +5483,7 @@ CWallet* CWallet::CreateWalletFromFile(const std::string walletFile)
                 {
                     const CWalletTx* copyFrom = &wtxOld;
                     CWalletTx* copyTo = &mi->second;
+                    int64_t nStakeableTimeOld = GetStakeableTime(*copyTo);
                     copyTo->mapValue = copyFrom->mapValue;
                     copyTo->vOrderForm = copyFrom->vOrderForm;
                     copyTo->nTimeReceived = copyFrom->nTimeReceived;
@@ -5298,6 +5492,8 @@ CWallet* CWallet::CreateWalletFromFile(const std::string walletFile)
                     copyTo->strFromAccount = copyFrom->strFromAccount;
                     copyTo->nOrderPos = copyFrom->nOrderPos;
                     walletdb.WriteTx(*copyTo);
+                    LOCK(walletInstance->cs_wallet);
+                    walletInstance->UpdateStakeableCoins(*copyTo, nStakeableTimeOld);
                 }
             }
         }
@@ -120,6 +120,17 @@ struct CompactTallyItem
     }
 };
 
+/** The inputs of a stake kernel for one stakeable coin, looked up once per stake set refresh */
+struct CStakeKernelInput
+{
+    const CBlockIndex* pindexFrom;
+    COutPoint prevout;
+    CTxOut txout;
+};
+
+/** Run an instance of the stake kernel search thread */
+void ThreadStakeKernelCheck();
+
 /** A key pool entry */
 class CKeyPool
 {
@@ -672,6 +683,19 @@ private:
     void AddToSpends(const uint256& wtxid);
 
     std::set<COutPoint> setWalletUTXO;
+    /** Outputs in setWalletUTXO that may be staked, ordered by the time they reach the stake min age */
+    std::set<std::pair<int64_t, COutPoint> > setStakeableCoins;
+    /** Scripts of keys or scripts added since, outputs already in the wallet paying to them may have become ours */
+    std::set<CScript> setUnindexedScripts;
+    /** Outputs of wallet transactions that were not ours when indexed, by script; the only ones new keys can make ours */
+    std::multimap<CScript, COutPoint> mapForeignOutputs;
+    void AddWalletUTXO(const COutPoint& outpoint);
+    /** Add the unspent outputs of a new wallet transaction to setWalletUTXO, or to mapForeignOutputs if not ours */
+    void IndexWalletTx(const CWalletTx& wtx);
+    /** Move the outputs of a transaction in setStakeableCoins after its time changed */
+    void UpdateStakeableCoins(const CWalletTx& wtx, int64_t nStakeableTimeOld);
+    /** Recompute setWalletUTXO, setStakeableCoins and mapForeignOutputs from mapWallet */
+    void RebuildWalletUTXO();
 
     /* Mark a transaction (and its in-wallet descendants) as conflicting with a particular block. */
     void MarkConflicted(const uint256& hashBlock, const uint256& hashTx);
@@ -681,10 +705,10 @@ private:
     /* HD derive new child key (on internal or external chain) */
     void DeriveNewChildKey(const CKeyMetadata& metadata, CKey& secretRet, uint32_t nAccountIndex, bool fInternal /*= false*/);
 
-    bool CreateCoinStakeKernel(CScript &kernelScript, const CScript &stakeScript,
-                               unsigned int nBits, const CBlock& blockFrom,
-                               unsigned int nTxPrevOffset, const CTransactionRef &txPrev,
-                               const COutPoint& prevout, unsigned int &nTimeTx, bool fPrintProofOfStake) const;
+    friend class CStakeKernelCheck;
+    bool CreateCoinStakeKernel(CScript &kernelScript, unsigned int nBits,
+                               const CStakeKernelInput& input, unsigned int nTxPrevOffset,
+                               unsigned int &nTimeTx, bool fPrintProofOfStake) const;
     void FillCoinStakePayments(CMutableTransaction &transaction,
                                const CScript &kernelScript,
                                const COutPoint &stakePrevout, CAmount blockReward) const;
@@ -826,6 +850,8 @@ public:
     using StakeCoinsSet = std::set<std::pair<const CWalletTx*, unsigned int> >;
     bool MintableCoins();
     bool SelectStakeCoins(StakeCoinsSet& setCoins, CAmount nTargetAmount, const CScript &scriptFilterPubKey = CScript()) const;
+    /** Add the unspent outputs paying to keys or scripts added since the last call to the stakeable coins */
+    void IndexNewScripts();
     // Coin selection
     bool SelectCoinsByDenominations(int nDenom, CAmount nValueMin, CAmount nValueMax, std::vector<CTxDSIn>& vecTxDSInRet, std::vector<COutput>& vCoinsRet, CAmount& nValueRet, int nPrivateSendRoundsMin, int nPrivateSendRoundsMax);
     bool GetCollateralTxDSIn(CTxDSIn& txdsinRet, CAmount& nValueRet) const;